@@ -0,0 +1,269 @@
+#include <stdlib.h>
+#include "io_thread.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <process.h>
+#else
+#include <pthread.h>
+#endif
+
+/**
+ * State of job.
+ */
+enum io_thread_state {
+    IO_THREAD_IDLE, // No job.
+    IO_THREAD_POSTED, // Job is posted and not finished yet.
+    IO_THREAD_DONE, // Job is finished. Result is not taken yet.
+    IO_THREAD_QUIT, // Thread should exit.
+};
+
+struct io_thread {
+#if defined(_WIN32)
+    HANDLE handle; // Thread handle.
+    SRWLOCK lock; // Lock for fields below.
+    CONDITION_VARIABLE cond; // Signaled when state changes.
+#else
+    pthread_t handle; // Thread handle.
+    pthread_mutex_t lock; // Lock for fields below.
+    pthread_cond_t cond; // Signaled when state changes.
+#endif
+    enum io_thread_state state; // State of job.
+    io_thread_func_t func; // Job function.
+    void* context; // Context of job.
+    void* buffer; // Buffer of job.
+    size_t length; // Length of buffer.
+    size_t result; // Result of job.
+};
+
+static void lock(io_thread_t* thread);
+static void unlock(io_thread_t* thread);
+static void wait_state_change(io_thread_t* thread);
+static void notify_state_change(io_thread_t* thread);
+static void run(io_thread_t* thread);
+
+#if defined(_WIN32)
+static unsigned __stdcall thread_proc(void* arg);
+#else
+static void* thread_proc(void* arg);
+#endif
+
+/**
+ * Start I/O thread.
+ *
+ * @retval I/O thread object.
+ * @retval NULL Failed. (Caller should do I/O by itself)
+ */
+io_thread_t* io_thread_start(void)
+{
+    io_thread_t* thread = (io_thread_t*)(malloc(sizeof(io_thread_t)));
+    if (thread == NULL) {
+        return NULL;
+    }
+    thread->state = IO_THREAD_IDLE;
+    thread->func = NULL;
+    thread->context = NULL;
+    thread->buffer = NULL;
+    thread->length = 0u;
+    thread->result = 0u;
+#if defined(_WIN32)
+    InitializeSRWLock(&(thread->lock));
+    InitializeConditionVariable(&(thread->cond));
+    // _beginthreadex() rather than CreateThread() because the job calls CRT stdio.
+    thread->handle = (HANDLE)(_beginthreadex(NULL, 0, thread_proc, thread, 0, NULL));
+    if (thread->handle == NULL) {
+        free(thread);
+        return NULL;
+    }
+#else
+    pthread_mutex_init(&(thread->lock), NULL);
+    pthread_cond_init(&(thread->cond), NULL);
+    if (pthread_create(&(thread->handle), NULL, thread_proc, thread) != 0) {
+        pthread_cond_destroy(&(thread->cond));
+        pthread_mutex_destroy(&(thread->lock));
+        free(thread);
+        return NULL;
+    }
+#endif
+    return thread;
+}
+
+/**
+ * Stop I/O thread.
+ * Waits for posted job, then joins the thread and frees the object.
+ *
+ * @param thread I/O thread object.
+ */
+void io_thread_stop(io_thread_t* thread)
+{
+    if (thread == NULL) {
+        return;
+    }
+    (void)(io_thread_wait(thread));
+
+    lock(thread);
+    thread->state = IO_THREAD_QUIT;
+    notify_state_change(thread);
+    unlock(thread);
+
+#if defined(_WIN32)
+    WaitForSingleObject(thread->handle, INFINITE);
+    CloseHandle(thread->handle);
+#else
+    pthread_join(thread->handle, NULL);
+    pthread_cond_destroy(&(thread->cond));
+    pthread_mutex_destroy(&(thread->lock));
+#endif
+    free(thread);
+}
+
+/**
+ * Post job to I/O thread.
+ * Only one job can be posted at a time. Call io_thread_wait() before posting next one.
+ * buffer and anything context refers must not be touched until io_thread_wait() returns.
+ *
+ * @param thread I/O thread object.
+ * @param func Job function.
+ * @param context Context passed to func.
+ * @param buffer Buffer passed to func.
+ * @param length Length passed to func.
+ */
+void io_thread_post(io_thread_t* thread, io_thread_func_t func, void* context, void* buffer, size_t length)
+{
+    lock(thread);
+    thread->func = func;
+    thread->context = context;
+    thread->buffer = buffer;
+    thread->length = length;
+    thread->result = 0u;
+    thread->state = IO_THREAD_POSTED;
+    notify_state_change(thread);
+    unlock(thread);
+}
+
+/**
+ * Wait for posted job.
+ *
+ * @param thread I/O thread object.
+ * @retval Result of job.
+ * @retval 0 No job was posted.
+ */
+size_t io_thread_wait(io_thread_t* thread)
+{
+    size_t result = 0u;
+    lock(thread);
+    while (thread->state == IO_THREAD_POSTED) {
+        wait_state_change(thread);
+    }
+    if (thread->state == IO_THREAD_DONE) {
+        result = thread->result;
+        thread->state = IO_THREAD_IDLE;
+    }
+    unlock(thread);
+    return result;
+}
+
+/**
+ * Thread body. Runs posted jobs until quit.
+ *
+ * @param thread I/O thread object.
+ */
+static void run(io_thread_t* thread)
+{
+    lock(thread);
+    for (;;) {
+        while ((thread->state != IO_THREAD_POSTED) && (thread->state != IO_THREAD_QUIT)) {
+            wait_state_change(thread);
+        }
+        if (thread->state == IO_THREAD_QUIT) {
+            break;
+        }
+        unlock(thread); // Do not hold lock while doing I/O.
+        size_t result = thread->func(thread->context, thread->buffer, thread->length);
+        lock(thread);
+        thread->result = result;
+        thread->state = IO_THREAD_DONE;
+        notify_state_change(thread);
+    }
+    unlock(thread);
+}
+
+#if defined(_WIN32)
+/**
+ * Thread entry.
+ *
+ * @param arg I/O thread object.
+ * @retval 0
+ */
+static unsigned __stdcall thread_proc(void* arg)
+{
+    run((io_thread_t*)(arg));
+    return 0;
+}
+#else
+/**
+ * Thread entry.
+ *
+ * @param arg I/O thread object.
+ * @retval NULL
+ */
+static void* thread_proc(void* arg)
+{
+    run((io_thread_t*)(arg));
+    return NULL;
+}
+#endif
+
+/**
+ * Lock thread object.
+ *
+ * @param thread I/O thread object.
+ */
+static void lock(io_thread_t* thread)
+{
+#if defined(_WIN32)
+    AcquireSRWLockExclusive(&(thread->lock));
+#else
+    pthread_mutex_lock(&(thread->lock));
+#endif
+}
+/**
+ * Unlock thread object.
+ *
+ * @param thread I/O thread object.
+ */
+static void unlock(io_thread_t* thread)
+{
+#if defined(_WIN32)
+    ReleaseSRWLockExclusive(&(thread->lock));
+#else
+    pthread_mutex_unlock(&(thread->lock));
+#endif
+}
+/**
+ * Wait until state is changed. Must be called with lock held.
+ *
+ * @param thread I/O thread object.
+ */
+static void wait_state_change(io_thread_t* thread)
+{
+#if defined(_WIN32)
+    SleepConditionVariableSRW(&(thread->cond), &(thread->lock), INFINITE, 0);
+#else
+    pthread_cond_wait(&(thread->cond), &(thread->lock));
+#endif
+}
+/**
+ * Notify state change to waiting side. Must be called with lock held.
+ *
+ * @param thread I/O thread object.
+ */
+static void notify_state_change(io_thread_t* thread)
+{
+    // Both the owner and the thread wait on the same variable, so wake all.
+#if defined(_WIN32)
+    WakeAllConditionVariable(&(thread->cond));
+#else
+    pthread_cond_broadcast(&(thread->cond));
+#endif
+}
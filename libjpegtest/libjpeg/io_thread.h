@@ -0,0 +1,25 @@
+#ifndef IO_THREAD_H
+#define IO_THREAD_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * Job run on the I/O thread. Returns the number of bytes transferred.
+ */
+typedef size_t (*io_thread_func_t)(void *context, void *buffer, size_t length);
+
+/**
+ * Helper thread which runs one I/O job at a time in the background.
+ * (Contents are OS dependent, so windows.h is not included here)
+ */
+typedef struct io_thread io_thread_t;
+
+io_thread_t *io_thread_start(void);
+void io_thread_stop(io_thread_t *thread);
+
+void io_thread_post(io_thread_t *thread, io_thread_func_t func, void *context, void *buffer, size_t length);
+size_t io_thread_wait(io_thread_t *thread);
+
+#endif // IO_THREAD_H
@@ -11,6 +11,7 @@
 #define JPEG_INTERNALS
 #include "jinclude.h"
 #include "jpeglib.h"
+#include "jsimd.h"
 
 
  /* Private subobject */
@@ -20,6 +21,14 @@ typedef struct {
 
     /* Private state for RGB->YCC conversion */
     INT32* rgb_ycc_tab;		/* => table for RGB to YCbCr conversion */
+
+    /* Input pixel layout for the RGB colorspaces (see jutils.c);
+     * rgb_pixelsize is 0 for other input colorspaces.
+     */
+    int rgb_red, rgb_green, rgb_blue, rgb_pixelsize;
+#ifdef JSIMD_X86
+    J_COLOR_SPACE simd_space;	/* JCS_EXT_ space with the same layout */
+#endif
 } my_color_converter;
 
 typedef my_color_converter* my_cconvert_ptr;
@@ -172,6 +181,97 @@ rgb_ycc_convert(j_compress_ptr cinfo,
 }
 
 
+/*
+ * The same for the JCS_EXT_ colorspaces, whose layout is known only at
+ * run time.  The extra sample of a 4-sample pixel is ignored.
+ */
+
+METHODDEF(void)
+extrgb_ycc_convert(j_compress_ptr cinfo,
+    JSAMPARRAY input_buf, JSAMPIMAGE output_buf,
+    JDIMENSION output_row, int num_rows)
+{
+    my_cconvert_ptr cconvert = (my_cconvert_ptr)cinfo->cconvert;
+    register int r, g, b;
+    register INT32* ctab = cconvert->rgb_ycc_tab;
+    register JSAMPROW inptr;
+    register JSAMPROW outptr0, outptr1, outptr2;
+    register JDIMENSION col;
+    JDIMENSION num_cols = cinfo->image_width;
+    int red = cconvert->rgb_red;
+    int green = cconvert->rgb_green;
+    int blue = cconvert->rgb_blue;
+    int pixelsize = cconvert->rgb_pixelsize;
+
+    while (--num_rows >= 0) {
+        inptr = *input_buf++;
+        outptr0 = output_buf[0][output_row];
+        outptr1 = output_buf[1][output_row];
+        outptr2 = output_buf[2][output_row];
+        output_row++;
+        for (col = 0; col < num_cols; col++) {
+            r = GETJSAMPLE(inptr[red]);
+            g = GETJSAMPLE(inptr[green]);
+            b = GETJSAMPLE(inptr[blue]);
+            inptr += pixelsize;
+            /* Y */
+            outptr0[col] = (JSAMPLE)
+                ((ctab[r + R_Y_OFF] + ctab[g + G_Y_OFF] + ctab[b + B_Y_OFF])
+                    >> SCALEBITS);
+            /* Cb */
+            outptr1[col] = (JSAMPLE)
+                ((ctab[r + R_CB_OFF] + ctab[g + G_CB_OFF] + ctab[b + B_CB_OFF])
+                    >> SCALEBITS);
+            /* Cr */
+            outptr2[col] = (JSAMPLE)
+                ((ctab[r + R_CR_OFF] + ctab[g + G_CR_OFF] + ctab[b + B_CR_OFF])
+                    >> SCALEBITS);
+        }
+    }
+}
+
+
+#ifdef JSIMD_X86
+
+/*
+ * RGB->YCbCr conversion by the SIMD routine, for any layout it handles.
+ */
+
+METHODDEF(void)
+rgb_ycc_convert_simd(j_compress_ptr cinfo,
+    JSAMPARRAY input_buf, JSAMPIMAGE output_buf,
+    JDIMENSION output_row, int num_rows)
+{
+    my_cconvert_ptr cconvert = (my_cconvert_ptr)cinfo->cconvert;
+
+    jpeg_rgb_ycc_convert_sse2(input_buf, output_buf, output_row, num_rows,
+        cinfo->image_width, cconvert->simd_space);
+}
+
+
+/*
+ * Find the JCS_EXT_ space with the pixel layout of the given RGB space,
+ * or JCS_UNKNOWN if there is none (a custom JCS_RGB layout, say).
+ */
+
+LOCAL(J_COLOR_SPACE)
+ext_rgb_space(J_COLOR_SPACE cs)
+{
+    int i;
+
+    for (i = (int)JCS_EXT_RGB; i <= (int)JCS_EXT_ARGB; i++) {
+        if (jpeg_rgb_red[i] == jpeg_rgb_red[cs] &&
+            jpeg_rgb_green[i] == jpeg_rgb_green[cs] &&
+            jpeg_rgb_blue[i] == jpeg_rgb_blue[cs] &&
+            jpeg_rgb_pixelsize[i] == jpeg_rgb_pixelsize[cs])
+            return (J_COLOR_SPACE)i;
+    }
+    return JCS_UNKNOWN;
+}
+
+#endif /* JSIMD_X86 */
+
+
 /**************** Cases other than RGB -> YCbCr **************/
 
 
@@ -213,6 +313,82 @@ rgb_gray_convert(j_compress_ptr cinfo,
 }
 
 
+/*
+ * RGB->grayscale from one of the JCS_EXT_ layouts.
+ */
+
+METHODDEF(void)
+extrgb_gray_convert(j_compress_ptr cinfo,
+    JSAMPARRAY input_buf, JSAMPIMAGE output_buf,
+    JDIMENSION output_row, int num_rows)
+{
+    my_cconvert_ptr cconvert = (my_cconvert_ptr)cinfo->cconvert;
+    register int r, g, b;
+    register INT32* ctab = cconvert->rgb_ycc_tab;
+    register JSAMPROW inptr;
+    register JSAMPROW outptr;
+    register JDIMENSION col;
+    JDIMENSION num_cols = cinfo->image_width;
+    int red = cconvert->rgb_red;
+    int green = cconvert->rgb_green;
+    int blue = cconvert->rgb_blue;
+    int pixelsize = cconvert->rgb_pixelsize;
+
+    while (--num_rows >= 0) {
+        inptr = *input_buf++;
+        outptr = output_buf[0][output_row];
+        output_row++;
+        for (col = 0; col < num_cols; col++) {
+            r = GETJSAMPLE(inptr[red]);
+            g = GETJSAMPLE(inptr[green]);
+            b = GETJSAMPLE(inptr[blue]);
+            inptr += pixelsize;
+            /* Y */
+            outptr[col] = (JSAMPLE)
+                ((ctab[r + R_Y_OFF] + ctab[g + G_Y_OFF] + ctab[b + B_Y_OFF])
+                    >> SCALEBITS);
+        }
+    }
+}
+
+
+/*
+ * Convert some rows of samples to the JPEG colorspace.
+ * This version handles RGB output from an RGB layout other than plain
+ * R/G/B: the samples are just reordered.
+ */
+
+METHODDEF(void)
+extrgb_rgb_convert(j_compress_ptr cinfo,
+    JSAMPARRAY input_buf, JSAMPIMAGE output_buf,
+    JDIMENSION output_row, int num_rows)
+{
+    my_cconvert_ptr cconvert = (my_cconvert_ptr)cinfo->cconvert;
+    register JSAMPROW inptr;
+    register JSAMPROW outptr0, outptr1, outptr2;
+    register JDIMENSION col;
+    JDIMENSION num_cols = cinfo->image_width;
+    int red = cconvert->rgb_red;
+    int green = cconvert->rgb_green;
+    int blue = cconvert->rgb_blue;
+    int pixelsize = cconvert->rgb_pixelsize;
+
+    while (--num_rows >= 0) {
+        inptr = *input_buf++;
+        outptr0 = output_buf[0][output_row];
+        outptr1 = output_buf[1][output_row];
+        outptr2 = output_buf[2][output_row];
+        output_row++;
+        for (col = 0; col < num_cols; col++) {
+            outptr0[col] = inptr[red];	/* don't need GETJSAMPLE() here */
+            outptr1[col] = inptr[green];
+            outptr2[col] = inptr[blue];
+            inptr += pixelsize;
+        }
+    }
+}
+
+
 /*
  * Convert some rows of samples to the JPEG colorspace.
  * This version handles Adobe-style CMYK->YCCK conversion,
@@ -360,7 +536,10 @@ jinit_color_converter(j_compress_ptr cinfo)
     /* set start_pass to null method until we find out differently */
     cconvert->pub.start_pass = null_method;
 
-    /* Make sure input_components agrees with in_color_space */
+    /* Make sure input_components agrees with in_color_space,
+     * and note the pixel layout of RGB input.
+     */
+    cconvert->rgb_pixelsize = 0;
     switch (cinfo->in_color_space) {
     case JCS_GRAYSCALE:
         if (cinfo->input_components != 1)
@@ -368,11 +547,19 @@ jinit_color_converter(j_compress_ptr cinfo)
         break;
 
     case JCS_RGB:
-#if RGB_PIXELSIZE != 3
-        if (cinfo->input_components != RGB_PIXELSIZE)
+    case JCS_EXT_RGB:
+    case JCS_EXT_BGR:
+    case JCS_EXT_RGBX:
+    case JCS_EXT_RGBA:
+    case JCS_EXT_BGRA:
+    case JCS_EXT_ARGB:
+        if (cinfo->input_components != jpeg_rgb_pixelsize[cinfo->in_color_space])
             ERREXIT(cinfo, JERR_BAD_IN_COLORSPACE);
+        cconvert->rgb_red = jpeg_rgb_red[cinfo->in_color_space];
+        cconvert->rgb_green = jpeg_rgb_green[cinfo->in_color_space];
+        cconvert->rgb_blue = jpeg_rgb_blue[cinfo->in_color_space];
+        cconvert->rgb_pixelsize = cinfo->input_components;
         break;
-#endif /* else share code with YCbCr */
 
     case JCS_YCbCr:
         if (cinfo->input_components != 3)
@@ -402,6 +589,10 @@ jinit_color_converter(j_compress_ptr cinfo)
             cconvert->pub.start_pass = rgb_ycc_start;
             cconvert->pub.color_convert = rgb_gray_convert;
         }
+        else if (cconvert->rgb_pixelsize != 0) {
+            cconvert->pub.start_pass = rgb_ycc_start;
+            cconvert->pub.color_convert = extrgb_gray_convert;
+        }
         else if (cinfo->in_color_space == JCS_YCbCr)
             cconvert->pub.color_convert = grayscale_convert;
         else
@@ -411,18 +602,31 @@ jinit_color_converter(j_compress_ptr cinfo)
     case JCS_RGB:
         if (cinfo->num_components != 3)
             ERREXIT(cinfo, JERR_BAD_J_COLORSPACE);
-        if (cinfo->in_color_space == JCS_RGB && RGB_PIXELSIZE == 3)
+        if (cconvert->rgb_pixelsize == 0)
+            ERREXIT(cinfo, JERR_CONVERSION_NOTIMPL);
+        if (cconvert->rgb_red == 0 && cconvert->rgb_green == 1 &&
+            cconvert->rgb_blue == 2 && cconvert->rgb_pixelsize == 3)
             cconvert->pub.color_convert = null_convert;
         else
-            ERREXIT(cinfo, JERR_CONVERSION_NOTIMPL);
+            cconvert->pub.color_convert = extrgb_rgb_convert;
         break;
 
     case JCS_YCbCr:
         if (cinfo->num_components != 3)
             ERREXIT(cinfo, JERR_BAD_J_COLORSPACE);
-        if (cinfo->in_color_space == JCS_RGB) {
+        if (cconvert->rgb_pixelsize != 0) {
             cconvert->pub.start_pass = rgb_ycc_start;
-            cconvert->pub.color_convert = rgb_ycc_convert;
+            if (cinfo->in_color_space == JCS_RGB)
+                cconvert->pub.color_convert = rgb_ycc_convert;
+            else
+                cconvert->pub.color_convert = extrgb_ycc_convert;
+#ifdef JSIMD_X86
+            if (jpeg_simd_support() & JSIMD_SSE2) {
+                cconvert->simd_space = ext_rgb_space(cinfo->in_color_space);
+                if (cconvert->simd_space != JCS_UNKNOWN)
+                    cconvert->pub.color_convert = rgb_ycc_convert_simd;
+            }
+#endif
         }
         else if (cinfo->in_color_space == JCS_YCbCr)
             cconvert->pub.color_convert = null_convert;
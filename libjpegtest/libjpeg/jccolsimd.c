@@ -0,0 +1,278 @@
+/*
+ * jccolsimd.c
+ *
+ * Based on jccolor.c.
+ *
+ * This file contains an SSE2 version of the RGB->YCbCr conversion in
+ * jccolor.c, reading any of the JCS_EXT_ pixel layouts.  The results are
+ * exactly those of the table-driven C code.
+ *
+ * jccolor.c sums the scaled products of R, G and B with the rounding terms
+ * and shifts right by 16, so the same sums formed with pmaddwd give the
+ * same results.  pmaddwd takes signed 16-bit constants, which rules out the
+ * two that are too big: 0.58700 * 2^16 (38470) is applied as two halves of
+ * 19235, once paired with R and once with B, and 0.5 * 2^16 becomes a left
+ * shift by 15.
+ */
+
+#define JPEG_INTERNALS
+#include "jinclude.h"
+#include "jpeglib.h"
+#include "jsimd.h"
+
+#ifdef JSIMD_X86
+
+#include <emmintrin.h>
+
+
+/*
+ * This module is specialized to the case of 8-bit samples.
+ */
+
+#if BITS_IN_JSAMPLE != 8
+Sorry, this code only copes with 8-bit samples. /* deliberate syntax err */
+#endif
+
+
+#define SCALEBITS	16
+#define CBCR_OFFSET	((INT32) CENTERJSAMPLE << SCALEBITS)
+#define ONE_HALF	((INT32) 1 << (SCALEBITS-1))
+
+/* FIX() of jccolor.c's constants */
+#define FIX_0_29900	19595
+#define FIX_0_58700	38470
+#define FIX_0_11400	7471
+#define FIX_0_16874	11059
+#define FIX_0_33126	21709
+#define FIX_0_41869	27439
+#define FIX_0_08131	5329
+
+#define PIXELS_PER_ITER	16
+
+
+/*
+ * Convert four pixels, given as (R, G) and (G, B) pairs of 16-bit values
+ * and as R and B in 32-bit lanes, to Y, Cb and Cr in 32-bit lanes.
+ */
+
+JSIMD_INLINE JSIMD_TARGET_SSE2
+LOCAL(void)
+rgb_ycc_4_sse2(__m128i rg, __m128i gb, __m128i r, __m128i b,
+    __m128i* y, __m128i* cb, __m128i* cr)
+{
+    __m128i temp;
+
+    /* Y */
+    temp = _mm_add_epi32(
+        _mm_madd_epi16(rg, _mm_set1_epi32(PAIR(FIX_0_29900, FIX_0_58700 / 2))),
+        _mm_madd_epi16(gb, _mm_set1_epi32(PAIR(FIX_0_58700 / 2, FIX_0_11400))));
+    *y = _mm_srli_epi32(_mm_add_epi32(temp, _mm_set1_epi32(ONE_HALF)),
+        SCALEBITS);
+
+    /* Cb.  As in jccolor.c, rounding by 0.5-epsilon keeps the outputs
+     * within range, and the sums are never negative.
+     */
+    temp = _mm_add_epi32(
+        _mm_madd_epi16(rg, _mm_set1_epi32(PAIR(-FIX_0_16874, -FIX_0_33126))),
+        _mm_slli_epi32(b, SCALEBITS - 1));
+    *cb = _mm_srli_epi32(_mm_add_epi32(temp,
+        _mm_set1_epi32(CBCR_OFFSET + ONE_HALF - 1)), SCALEBITS);
+
+    /* Cr */
+    temp = _mm_add_epi32(
+        _mm_madd_epi16(gb, _mm_set1_epi32(PAIR(-FIX_0_41869, -FIX_0_08131))),
+        _mm_slli_epi32(r, SCALEBITS - 1));
+    *cr = _mm_srli_epi32(_mm_add_epi32(temp,
+        _mm_set1_epi32(CBCR_OFFSET + ONE_HALF - 1)), SCALEBITS);
+}
+
+
+/*
+ * Convert eight pixels held as 16-bit R, G and B values; the results come
+ * back as 16-bit values.
+ */
+
+JSIMD_INLINE JSIMD_TARGET_SSE2
+LOCAL(void)
+rgb_ycc_8_sse2(__m128i r, __m128i g, __m128i b,
+    __m128i* y, __m128i* cb, __m128i* cr)
+{
+    __m128i zero = _mm_setzero_si128();
+    __m128i ylo, yhi, cblo, cbhi, crlo, crhi;
+
+    rgb_ycc_4_sse2(_mm_unpacklo_epi16(r, g), _mm_unpacklo_epi16(g, b),
+        _mm_unpacklo_epi16(r, zero), _mm_unpacklo_epi16(b, zero),
+        &ylo, &cblo, &crlo);
+    rgb_ycc_4_sse2(_mm_unpackhi_epi16(r, g), _mm_unpackhi_epi16(g, b),
+        _mm_unpackhi_epi16(r, zero), _mm_unpackhi_epi16(b, zero),
+        &yhi, &cbhi, &crhi);
+    *y = _mm_packs_epi32(ylo, yhi);
+    *cb = _mm_packs_epi32(cblo, cbhi);
+    *cr = _mm_packs_epi32(crlo, crhi);
+}
+
+
+/*
+ * Spread four 3-byte pixels, in the low 12 bytes of v, out to one per
+ * 32-bit lane.  The fourth byte of each lane is left as garbage.
+ */
+
+JSIMD_INLINE JSIMD_TARGET_SSE2
+LOCAL(__m128i)
+unpack_pixels_3_sse2(__m128i v)
+{
+    __m128i even = _mm_set_epi32(0, -1, 0, -1);
+
+    /* Pixels 0-1 to the lower 64 bits, pixels 2-3 to the upper */
+    v = _mm_unpacklo_epi64(v, _mm_srli_si128(v, 6));
+    /* Then move the second pixel of each half up by one byte */
+    return _mm_or_si128(_mm_and_si128(v, even),
+        _mm_andnot_si128(even, _mm_slli_epi64(v, 8)));
+}
+
+
+/*
+ * Extract the sample at byte offset "offset" of every 4-byte pixel in
+ * v0 (pixels 0-3) and v1 (pixels 4-7) as 16-bit values.
+ */
+
+JSIMD_INLINE JSIMD_TARGET_SSE2
+LOCAL(__m128i)
+extract_sample_sse2(__m128i v0, __m128i v1, int offset)
+{
+    __m128i mask = _mm_set1_epi32(0xFF);
+
+    if (offset == 3)
+        return _mm_packs_epi32(_mm_srli_epi32(v0, 24), _mm_srli_epi32(v1, 24));
+    if (offset != 0) {
+        v0 = _mm_srli_epi32(v0, 8 * offset);
+        v1 = _mm_srli_epi32(v1, 8 * offset);
+    }
+    return _mm_packs_epi32(_mm_and_si128(v0, mask), _mm_and_si128(v1, mask));
+}
+
+
+/*
+ * Convert PIXELS_PER_ITER pixels in the given layout.  The layout
+ * arguments are constants in every caller, so only the shuffling for
+ * that layout is compiled.
+ */
+
+JSIMD_INLINE JSIMD_TARGET_SSE2
+LOCAL(void)
+rgb_ycc_16_sse2(JSAMPROW inptr, JSAMPROW outptr0, JSAMPROW outptr1,
+    JSAMPROW outptr2, int red, int green, int blue, int pixelsize)
+{
+    __m128i v[4], y[2], cb[2], cr[2];
+    int i;
+
+    if (pixelsize == 3) {
+        v[0] = unpack_pixels_3_sse2(_mm_loadu_si128((const __m128i*) inptr));
+        v[1] = unpack_pixels_3_sse2(
+            _mm_loadu_si128((const __m128i*) (inptr + 12)));
+        v[2] = unpack_pixels_3_sse2(
+            _mm_loadu_si128((const __m128i*) (inptr + 24)));
+        /* Don't read past the 48 bytes of input */
+        v[3] = unpack_pixels_3_sse2(_mm_srli_si128(
+            _mm_loadu_si128((const __m128i*) (inptr + 32)), 4));
+    }
+    else {
+        for (i = 0; i < 4; i++)
+            v[i] = _mm_loadu_si128((const __m128i*) (inptr + 16 * i));
+    }
+
+    for (i = 0; i < 2; i++) {
+        rgb_ycc_8_sse2(extract_sample_sse2(v[2 * i], v[2 * i + 1], red),
+            extract_sample_sse2(v[2 * i], v[2 * i + 1], green),
+            extract_sample_sse2(v[2 * i], v[2 * i + 1], blue),
+            &y[i], &cb[i], &cr[i]);
+    }
+
+    _mm_storeu_si128((__m128i*) outptr0, _mm_packus_epi16(y[0], y[1]));
+    _mm_storeu_si128((__m128i*) outptr1, _mm_packus_epi16(cb[0], cb[1]));
+    _mm_storeu_si128((__m128i*) outptr2, _mm_packus_epi16(cr[0], cr[1]));
+}
+
+
+/*
+ * Convert some rows in one layout.  The last few pixels of a row go
+ * through scratch buffers, so that nothing is read or written past the
+ * row ends.
+ */
+
+JSIMD_INLINE JSIMD_TARGET_SSE2
+LOCAL(void)
+rgb_ycc_rows_sse2(JSAMPARRAY input_buf, JSAMPIMAGE output_buf,
+    JDIMENSION output_row, int num_rows, JDIMENSION num_cols,
+    int red, int green, int blue, int pixelsize)
+{
+    JSAMPLE intemp[PIXELS_PER_ITER * 4];
+    JSAMPLE outtemp[3][PIXELS_PER_ITER];
+    JSAMPROW inptr, outptr0, outptr1, outptr2;
+    JDIMENSION col;
+
+    while (--num_rows >= 0) {
+        inptr = *input_buf++;
+        outptr0 = output_buf[0][output_row];
+        outptr1 = output_buf[1][output_row];
+        outptr2 = output_buf[2][output_row];
+        output_row++;
+        for (col = num_cols; col >= PIXELS_PER_ITER; col -= PIXELS_PER_ITER) {
+            rgb_ycc_16_sse2(inptr, outptr0, outptr1, outptr2,
+                red, green, blue, pixelsize);
+            inptr += PIXELS_PER_ITER * pixelsize;
+            outptr0 += PIXELS_PER_ITER;
+            outptr1 += PIXELS_PER_ITER;
+            outptr2 += PIXELS_PER_ITER;
+        }
+        if (col > 0) {
+            MEMCOPY(intemp, inptr, col * pixelsize * SIZEOF(JSAMPLE));
+            rgb_ycc_16_sse2(intemp, outtemp[0], outtemp[1], outtemp[2],
+                red, green, blue, pixelsize);
+            MEMCOPY(outptr0, outtemp[0], col * SIZEOF(JSAMPLE));
+            MEMCOPY(outptr1, outtemp[1], col * SIZEOF(JSAMPLE));
+            MEMCOPY(outptr2, outtemp[2], col * SIZEOF(JSAMPLE));
+        }
+    }
+}
+
+
+/*
+ * RGB->YCbCr conversion of num_rows rows, as rgb_ycc_convert in jccolor.c,
+ * from the pixel layout of in_color_space, which must be a JCS_EXT_ space.
+ */
+
+JSIMD_TARGET_SSE2
+GLOBAL(void)
+jpeg_rgb_ycc_convert_sse2(JSAMPARRAY input_buf, JSAMPIMAGE output_buf,
+    JDIMENSION output_row, int num_rows, JDIMENSION num_cols,
+    J_COLOR_SPACE in_color_space)
+{
+    switch (in_color_space) {
+    case JCS_EXT_RGB:
+        rgb_ycc_rows_sse2(input_buf, output_buf, output_row, num_rows,
+            num_cols, 0, 1, 2, 3);
+        break;
+    case JCS_EXT_BGR:
+        rgb_ycc_rows_sse2(input_buf, output_buf, output_row, num_rows,
+            num_cols, 2, 1, 0, 3);
+        break;
+    case JCS_EXT_RGBX:
+    case JCS_EXT_RGBA:
+        rgb_ycc_rows_sse2(input_buf, output_buf, output_row, num_rows,
+            num_cols, 0, 1, 2, 4);
+        break;
+    case JCS_EXT_BGRA:
+        rgb_ycc_rows_sse2(input_buf, output_buf, output_row, num_rows,
+            num_cols, 2, 1, 0, 4);
+        break;
+    case JCS_EXT_ARGB:
+        rgb_ycc_rows_sse2(input_buf, output_buf, output_row, num_rows,
+            num_cols, 1, 2, 3, 4);
+        break;
+    default:
+        break;
+    }
+}
+
+#endif /* JSIMD_X86 */
@@ -15,6 +15,7 @@
 #include "jinclude.h"
 #include "jpeglib.h"
 #include "jdct.h"		/* Private declarations for DCT subsystem */
+#include "jsimd.h"
 
 
  /* Private subobject for this module */
@@ -31,6 +32,21 @@ typedef struct {
      */
     DCTELEM* divisors[NUM_QUANT_TBLS];
 
+#if BITS_IN_JSAMPLE == 8
+    /* Reciprocal tables for the divisors (see compute_reciprocal); a table
+     * is used only if recip_ok says that every divisor has a reciprocal.
+     */
+    UINT16* reciprocals[NUM_QUANT_TBLS];
+    bool recip_ok[NUM_QUANT_TBLS];
+#ifdef JSIMD_X86
+    /* SIMD routine doing the whole of forward_DCT, or NULL.  It can use a
+     * table only if simd_ok says that every divisor is at least 3.
+     */
+    quantize_DCT_method_ptr do_simd_dct;
+    bool simd_ok[NUM_QUANT_TBLS];
+#endif
+#endif
+
 #ifdef DCT_FLOAT_SUPPORTED
     /* Same as above for the floating-point case. */
     float_DCT_method_ptr do_float_dct;
@@ -41,6 +57,95 @@ typedef struct {
 typedef my_fdct_controller* my_fdct_ptr;
 
 
+#if BITS_IN_JSAMPLE == 8
+
+/*
+ * Compute the reciprocal of one divisor into rtbl[RECIP_MULTIPLIER] etc.
+ *
+ * For 8-bit samples the DCT outputs are below 32K in magnitude (see
+ * jdct.h), so the rounded quotient (a + divisor/2) / divisor of a
+ * magnitude a is wanted only for a < 32768.  With b = floor(log2(divisor))
+ * and shift = 16 + b, take multiplier = 2^shift / divisor rounded up if
+ * the fraction dropped is above one half, else rounded down with one
+ * added to the dividend (that goes into the correction).  Either way
+ *   (a + divisor/2) / divisor == ((a + correction) * multiplier) >> shift
+ * for every a < 32768.  A power of two is divided exactly with one bit
+ * less.  All entries fit in 16 bits if divisor <= 65535.
+ *
+ * Returns 0 if the divisor is too large, 2 if the SIMD quantizer can use
+ * the entries too (shift >= 17, so its scale fits in 16 bits), else 1.
+ */
+
+LOCAL(int)
+compute_reciprocal(DCTELEM divisor, UINT16* rtbl)
+{
+    unsigned long fq, fr;
+    unsigned int c;
+    int b, r;
+
+    if (divisor <= 0 || divisor > 65535)
+        return 0;
+
+    for (b = 0; (divisor >> (b + 1)) != 0; b++)
+        ;
+    r = 16 + b;
+    fq = (1UL << r) / (unsigned long)divisor;
+    fr = (1UL << r) % (unsigned long)divisor;
+    c = (unsigned int)divisor >> 1;	/* for rounding */
+
+    if (fr == 0) {			/* divisor is a power of two */
+        fq >>= 1;
+        r--;
+    }
+    else if (fr <= ((unsigned long)divisor >> 1)) {
+        c++;			/* round down, and add one to the dividend */
+    }
+    else {
+        fq++;			/* round up */
+    }
+
+    rtbl[RECIP_MULTIPLIER] = (UINT16)fq;
+    rtbl[RECIP_CORRECTION] = (UINT16)c;
+    rtbl[RECIP_SCALE] = (UINT16)(r >= 17 ? 1UL << (32 - r) : 0);
+    rtbl[RECIP_SHIFT] = (UINT16)r;
+    return (r >= 17) ? 2 : 1;
+}
+
+
+/*
+ * Set up the reciprocal table of quantization table qtblno from its
+ * divisor table.
+ */
+
+LOCAL(void)
+compute_reciprocals(j_compress_ptr cinfo, int qtblno)
+{
+    my_fdct_ptr fdct = (my_fdct_ptr)cinfo->fdct;
+    DCTELEM* dtbl = fdct->divisors[qtblno];
+    UINT16* rtbl;
+    int i, kind, min_kind;
+
+    if (fdct->reciprocals[qtblno] == NULL) {
+        fdct->reciprocals[qtblno] = (UINT16*)
+            (*cinfo->mem->alloc_small) ((j_common_ptr)cinfo, JPOOL_IMAGE,
+                4 * DCTSIZE2 * SIZEOF(UINT16));
+    }
+    rtbl = fdct->reciprocals[qtblno];
+    min_kind = 2;
+    for (i = 0; i < DCTSIZE2; i++) {
+        kind = compute_reciprocal(dtbl[i], rtbl + i);
+        if (kind < min_kind)
+            min_kind = kind;
+    }
+    fdct->recip_ok[qtblno] = (min_kind >= 1);
+#ifdef JSIMD_X86
+    fdct->simd_ok[qtblno] = (min_kind >= 2);
+#endif
+}
+
+#endif /* BITS_IN_JSAMPLE == 8 */
+
+
 /*
  * Initialize for a processing pass.
  * Verify that all referenced Q-tables are present, and set up
@@ -84,6 +189,9 @@ start_pass_fdctmgr(j_compress_ptr cinfo)
             for (i = 0; i < DCTSIZE2; i++) {
                 dtbl[i] = ((DCTELEM)qtbl->quantval[i]) << 3;
             }
+#if BITS_IN_JSAMPLE == 8
+            compute_reciprocals(cinfo, qtblno);
+#endif
             break;
 #endif
 #ifdef DCT_IFAST_SUPPORTED
@@ -121,6 +229,9 @@ start_pass_fdctmgr(j_compress_ptr cinfo)
                         (INT32)aanscales[i]),
                         CONST_BITS - 3);
             }
+#if BITS_IN_JSAMPLE == 8
+            compute_reciprocals(cinfo, qtblno);
+#endif
         }
         break;
 #endif
@@ -187,6 +298,10 @@ forward_DCT(j_compress_ptr cinfo, jpeg_component_info* compptr,
     my_fdct_ptr fdct = (my_fdct_ptr)cinfo->fdct;
     forward_DCT_method_ptr do_dct = fdct->do_dct;
     DCTELEM* divisors = fdct->divisors[compptr->quant_tbl_no];
+#if BITS_IN_JSAMPLE == 8
+    UINT16* reciprocals = fdct->recip_ok[compptr->quant_tbl_no] ?
+        fdct->reciprocals[compptr->quant_tbl_no] : NULL;
+#endif
     DCTELEM workspace[DCTSIZE2];	/* work area for FDCT subroutine */
     JDIMENSION bi;
 
@@ -224,6 +339,35 @@ forward_DCT(j_compress_ptr cinfo, jpeg_component_info* compptr,
         (*do_dct) (workspace);
 
         /* Quantize/descale the coefficients, and store into coef_blocks[] */
+#if BITS_IN_JSAMPLE == 8
+        if (reciprocals != NULL) {
+            register DCTELEM temp;
+            register int i;
+            register JCOEFPTR output_ptr = coef_blocks[bi];
+
+            for (i = 0; i < DCTSIZE2; i++) {
+                temp = workspace[i];
+                /* Divide the magnitude by multiplying by the reciprocal of
+                 * the divisor (see compute_reciprocal); the quotient is the
+                 * same as from the division below.
+                 */
+                if (temp < 0) {
+                    temp = -(DCTELEM)
+                        (((unsigned long)(reciprocals[RECIP_CORRECTION + i] - temp) *
+                            reciprocals[RECIP_MULTIPLIER + i]) >>
+                            reciprocals[RECIP_SHIFT + i]);
+                }
+                else {
+                    temp = (DCTELEM)
+                        (((unsigned long)(reciprocals[RECIP_CORRECTION + i] + temp) *
+                            reciprocals[RECIP_MULTIPLIER + i]) >>
+                            reciprocals[RECIP_SHIFT + i]);
+                }
+                output_ptr[i] = (JCOEF)temp;
+            }
+        }
+        else
+#endif
         { register DCTELEM temp, qval;
         register int i;
         register JCOEFPTR output_ptr = coef_blocks[bi];
@@ -265,6 +409,29 @@ forward_DCT(j_compress_ptr cinfo, jpeg_component_info* compptr,
 }
 
 
+#ifdef JSIMD_X86
+
+METHODDEF(void)
+forward_DCT_simd(j_compress_ptr cinfo, jpeg_component_info* compptr,
+    JSAMPARRAY sample_data, JBLOCKROW coef_blocks,
+    JDIMENSION start_row, JDIMENSION start_col,
+    JDIMENSION num_blocks)
+    /* This version is used when a SIMD routine does the whole job. */
+{
+    my_fdct_ptr fdct = (my_fdct_ptr)cinfo->fdct;
+    int qtblno = compptr->quant_tbl_no;
+
+    if (fdct->simd_ok[qtblno])
+        (*fdct->do_simd_dct) (sample_data + start_row, start_col,
+            coef_blocks, num_blocks, fdct->reciprocals[qtblno]);
+    else
+        forward_DCT(cinfo, compptr, sample_data, coef_blocks,
+            start_row, start_col, num_blocks);
+}
+
+#endif /* JSIMD_X86 */
+
+
 #ifdef DCT_FLOAT_SUPPORTED
 
 METHODDEF(void)
@@ -378,9 +545,29 @@ jinit_forward_dct(j_compress_ptr cinfo)
         break;
     }
 
+#ifdef JSIMD_X86
+    /* The SIMD routines replace forward_DCT, DCT and quantizer both */
+    fdct->do_simd_dct = NULL;
+    if (jpeg_simd_support() & JSIMD_SSE2) {
+#ifdef DCT_ISLOW_SUPPORTED
+        if (cinfo->dct_method == JDCT_ISLOW)
+            fdct->do_simd_dct = jpeg_fdct_islow_quantize_sse2;
+#endif
+#ifdef DCT_IFAST_SUPPORTED
+        if (cinfo->dct_method == JDCT_IFAST)
+            fdct->do_simd_dct = jpeg_fdct_ifast_quantize_sse2;
+#endif
+    }
+    if (fdct->do_simd_dct != NULL)
+        fdct->pub.forward_DCT = forward_DCT_simd;
+#endif
+
     /* Mark divisor tables unallocated */
     for (i = 0; i < NUM_QUANT_TBLS; i++) {
         fdct->divisors[i] = NULL;
+#if BITS_IN_JSAMPLE == 8
+        fdct->reciprocals[i] = NULL;
+#endif
 #ifdef DCT_FLOAT_SUPPORTED
         fdct->float_divisors[i] = NULL;
 #endif
@@ -16,6 +16,13 @@
 #undef NEED_SHORT_EXTERNAL_NAMES
 #define NO_GETENV /* No supported getenv() */
 
+/* Define JMEM_SHARE_MEMORY as 1 (here, or in the project's preprocessor
+ * definitions) to have all JPEG objects allocate from one shared region,
+ * which is safe to use from several threads; each object then keeps a
+ * cache of small blocks in front of it.  See jmem_impliments.c.
+ */
+/* #define JMEM_SHARE_MEMORY 1 */
+
 /* Define this if you get warnings about undefined structures. */
 #undef INCOMPLETE_TYPES_BROKEN
 
@@ -31,6 +38,9 @@
 /* These are for configuring the JPEG memory manager. */
 #undef DEFAULT_MAX_MEM
 #undef NO_MKTEMP
+#define USE_IMAGE_ARENA	/* Bump-allocate JPOOL_IMAGE from a reusable slab */
+/* #define IMAGE_ARENA_TRIM_COUNT 8 */	/* Small images in a row before the slab is trimmed */
+/* #define IMAGE_ARENA_MAX_SIZE 4194304L */	/* Upper limit of the slab size (none by default) */
 
 #endif /* JPEG_INTERNALS */
 
@@ -78,6 +78,12 @@ jpeg_CreateDecompress(j_decompress_ptr cinfo, int version, size_t structsize)
     /* And initialize the overall input controller. */
     jinit_input_controller(cinfo);
 
+    /* Tables kept across images are built when first needed. */
+    cinfo->tables = (struct jpeg_decomp_tables*)
+        (*cinfo->mem->alloc_small) ((j_common_ptr)cinfo, JPOOL_PERMANENT,
+            SIZEOF(struct jpeg_decomp_tables));
+    MEMZERO(cinfo->tables, SIZEOF(struct jpeg_decomp_tables));
+
     /* OK, I'm ready */
     cinfo->global_state = DSTATE_START;
 }
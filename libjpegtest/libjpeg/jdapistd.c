@@ -84,6 +84,79 @@ jpeg_start_decompress(j_decompress_ptr cinfo)
 }
 
 
+/*
+ * Compute the peak memory requirement of decompressing the current image.
+ * Call this after jpeg_read_header and after setting the output parameters
+ * (scaling, color quantization, buffered_image, max_memory_to_use, ...),
+ * in place of or before jpeg_start_decompress.
+ *
+ * The result is the largest total number of bytes this JPEG object will
+ * have obtained from jpeg_get_small/jpeg_get_large at once while
+ * decompressing with these parameters, including the permanent pool and
+ * the memory manager itself.  It is found by running the module selection
+ * done by jpeg_start_decompress and rolling the IMAGE pool back afterwards,
+ * so it costs about as much as that setup; no compressed data is read.
+ * The derived Huffman tables are set up for every table slot defined by
+ * the header, which covers the later scans of the usual multi-scan file.
+ * They live in the permanent pool and are kept for jpeg_start_decompress;
+ * the first call for a new set of tables therefore runs the setup twice,
+ * the second time to check that nothing else was left behind.
+ * Not included are slots first defined by a later scan (under 10 KB each,
+ * plus 8 KB if its ACs are skipped) and markers saved while reading later
+ * scans.
+ *
+ * If an error exits from here, abort or destroy the object as usual.
+ */
+
+GLOBAL(long)
+jpeg_calc_mem_peak(j_decompress_ptr cinfo)
+{
+    struct jpeg_decompress_struct saved_cinfo;
+    jpeg_component_info saved_comp_info[MAX_COMPONENTS];
+    JMETHOD(int, saved_consume_input, (j_decompress_ptr cinfo));
+    bool permanent_changed;
+    int pass;
+    long peak;
+
+    if (cinfo->global_state != DSTATE_READY)
+        ERREXIT1(cinfo, JERR_BAD_STATE, cinfo->global_state);
+
+    /* Module setup writes into cinfo, the component info and the input
+     * controller; keep copies so that jpeg_start_decompress starts afresh.
+     */
+    saved_cinfo = *cinfo;
+    MEMCOPY(saved_comp_info, cinfo->comp_info,
+        cinfo->num_components * SIZEOF(jpeg_component_info));
+    saved_consume_input = cinfo->inputctl->consume_input;
+
+    /* Only the IMAGE pool is rolled back.  A module may legitimately add
+     * workspaces to a cache kept in the permanent pool (the derived Huffman
+     * tables), but a second setup must then find them and allocate nothing
+     * more there; otherwise some module keeps state across the dry run
+     * that the restore below doesn't cover, and the estimate can't be
+     * trusted.
+     */
+    for (pass = 0; ; pass++) {
+        (*cinfo->mem->mark_image_pool) ((j_common_ptr)cinfo);
+        jinit_master_decompress(cinfo);
+        peak = (*cinfo->mem->release_to_mark) ((j_common_ptr)cinfo,
+            &permanent_changed);
+
+        *cinfo = saved_cinfo;
+        MEMCOPY(cinfo->comp_info, saved_comp_info,
+            cinfo->num_components * SIZEOF(jpeg_component_info));
+        cinfo->inputctl->consume_input = saved_consume_input;
+
+        if (!permanent_changed)
+            break;
+        if (pass > 0)
+            ERREXIT(cinfo, JERR_DRY_RUN_PERMANENT);
+    }
+
+    return peak;
+}
+
+
 /*
  * Set up for an output pass, and perform any dummy pass(es) needed.
  * Common subroutine for jpeg_start_decompress and jpeg_start_output.
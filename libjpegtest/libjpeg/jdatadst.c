@@ -9,6 +9,8 @@
  * emitting JPEG data to a file (or any stdio stream).  While these routines
  * are sufficient for most applications, some will want to use a different
  * destination manager.
+ * The buffer size can be chosen per JPEG object, and the previous block can
+ * optionally be written by a helper thread (see jpeg_stdio_dest_buffered).
  * IMPORTANT: we assume that fwrite() will correctly transcribe an array of
  * JOCTETs into 8-bit-wide elements on external storage.  If char is wider
  * than 8 bits on your machine, you may need to do some tweaking.
@@ -18,6 +20,7 @@
 #include "jinclude.h"
 #include "jpeglib.h"
 #include "jerror.h"
+#include "io_thread.h"
 
 
 /* Expanded data destination object for stdio output */
@@ -27,11 +30,51 @@ typedef struct {
 
     FILE* outfile;		/* target stream */
     JOCTET* buffer;		/* start of buffer */
+
+    size_t buffer_size;	/* size of each buffer */
+    size_t buffer_capacity;	/* allocated size of each buffer */
+    bool double_buffered;	/* write the previous block behind? */
+    JOCTET* buffers[2];	/* buffer pair; only [0] unless double-buffered */
+    int cur_index;		/* buffer being filled by the compressor */
+    io_thread_t* io_thread;	/* helper thread, or NULL if not running */
+    bool write_pending;	/* helper thread is writing the other buffer */
+    size_t pending_bytes;	/* # of bytes being written */
 } my_destination_mgr;
 
 typedef my_destination_mgr* my_dest_ptr;
 
-#define OUTPUT_BUF_SIZE  4096	/* choose an efficiently fwrite'able size */
+#define OUTPUT_BUF_SIZE  4096	/* default size; choose an efficiently fwrite'able size */
+
+
+/*
+ * Wait for any block being written behind and stop the helper thread.
+ * A write error found here is not reported; check ferror on the stream.
+ */
+
+LOCAL(void)
+stop_write(my_dest_ptr dest)
+{
+    if (dest->write_pending) {
+        dest->write_pending = false;
+        (void)io_thread_wait(dest->io_thread);
+    }
+    if (dest->io_thread != NULL) {
+        io_thread_stop(dest->io_thread);
+        dest->io_thread = NULL;
+    }
+}
+
+/*
+ * Cleanup routine run when the IMAGE pool is freed, including by jpeg_abort
+ * and jpeg_destroy after an error exit: the helper thread must be stopped
+ * before the buffer it writes from is released or the stream is closed.
+ */
+
+METHODDEF(void)
+cleanup_destination(j_common_ptr cinfo, void* arg)
+{
+    stop_write((my_dest_ptr)arg);
+}
 
 
 /*
@@ -44,13 +87,69 @@ init_destination(j_compress_ptr cinfo)
 {
     my_dest_ptr dest = (my_dest_ptr)cinfo->dest;
 
-    /* Allocate the output buffer --- it will be released when done with image */
-    dest->buffer = (JOCTET*)
-        (*cinfo->mem->alloc_small) ((j_common_ptr)cinfo, JPOOL_IMAGE,
-            OUTPUT_BUF_SIZE * SIZEOF(JOCTET));
-
+    /* The output buffers were allocated by jpeg_stdio_dest_buffered, in the
+     * permanent pool, so that they outlive the image; the helper thread is
+     * started only after this and stopped by cleanup_destination at the
+     * latest when the image is released.
+     */
+    dest->buffer = dest->buffers[dest->cur_index];
     dest->pub.next_output_byte = dest->buffer;
-    dest->pub.free_in_buffer = OUTPUT_BUF_SIZE;
+    dest->pub.free_in_buffer = dest->buffer_size;
+    if (dest->double_buffered)
+        (*cinfo->mem->register_cleanup) ((j_common_ptr)cinfo, JPOOL_IMAGE,
+            cleanup_destination, (void*)dest);
+}
+
+
+METHODDEF(size_t)
+write_file_block(void* context, void* buffer, size_t length)
+{
+    /* Runs on the helper thread.  The main thread does not touch the file
+     * or the buffer until io_thread_wait returns.
+     */
+    return JFWRITE((FILE*)context, buffer, length);
+}
+
+/*
+ * Wait for the block being written behind, if any.
+ */
+
+LOCAL(void)
+finish_write(j_compress_ptr cinfo)
+{
+    my_dest_ptr dest = (my_dest_ptr)cinfo->dest;
+
+    if (dest->write_pending) {
+        dest->write_pending = false;
+        if (io_thread_wait(dest->io_thread) != dest->pending_bytes)
+            ERREXIT(cinfo, JERR_FILE_WRITE);
+    }
+}
+
+/*
+ * Start writing the current buffer and switch to the other one.
+ * If no helper thread can be started, the block is written synchronously.
+ */
+
+LOCAL(void)
+start_write(j_compress_ptr cinfo, size_t datacount)
+{
+    my_dest_ptr dest = (my_dest_ptr)cinfo->dest;
+
+    if (dest->io_thread == NULL)
+        dest->io_thread = io_thread_start();
+    if (dest->io_thread == NULL) {
+        if (JFWRITE(dest->outfile, dest->buffer, datacount) != datacount)
+            ERREXIT(cinfo, JERR_FILE_WRITE);
+        return;
+    }
+
+    io_thread_post(dest->io_thread, write_file_block, (void*)dest->outfile,
+        (void*)dest->buffer, datacount);
+    dest->write_pending = true;
+    dest->pending_bytes = datacount;
+    dest->cur_index ^= 1;
+    dest->buffer = dest->buffers[dest->cur_index];
 }
 
 
@@ -82,12 +181,19 @@ empty_output_buffer(j_compress_ptr cinfo)
 {
     my_dest_ptr dest = (my_dest_ptr)cinfo->dest;
 
-    if (JFWRITE(dest->outfile, dest->buffer, OUTPUT_BUF_SIZE) !=
-        (size_t)OUTPUT_BUF_SIZE)
-        ERREXIT(cinfo, JERR_FILE_WRITE);
+    if (!dest->double_buffered) {
+        if (JFWRITE(dest->outfile, dest->buffer, dest->buffer_size) !=
+            dest->buffer_size)
+            ERREXIT(cinfo, JERR_FILE_WRITE);
+    }
+    else {
+        /* The other buffer becomes free once its write has finished */
+        finish_write(cinfo);
+        start_write(cinfo, dest->buffer_size);
+    }
 
     dest->pub.next_output_byte = dest->buffer;
-    dest->pub.free_in_buffer = OUTPUT_BUF_SIZE;
+    dest->pub.free_in_buffer = dest->buffer_size;
 
     return true;
 }
@@ -99,14 +205,18 @@ empty_output_buffer(j_compress_ptr cinfo)
  *
  * NB: *not* called by jpeg_abort or jpeg_destroy; surrounding
  * application must deal with any cleanup that should happen even
- * for error exit.
+ * for error exit.  (The helper thread is stopped by cleanup_destination then.)
  */
 
 METHODDEF(void)
 term_destination(j_compress_ptr cinfo)
 {
     my_dest_ptr dest = (my_dest_ptr)cinfo->dest;
-    size_t datacount = OUTPUT_BUF_SIZE - dest->pub.free_in_buffer;
+    size_t datacount = dest->buffer_size - dest->pub.free_in_buffer;
+
+    /* Blocks must reach the file in order */
+    finish_write(cinfo);
+    jpeg_stdio_dest_sync(cinfo);
 
     /* Write any data remaining in the buffer */
     if (datacount > 0) {
@@ -128,24 +238,87 @@ term_destination(j_compress_ptr cinfo)
 
 GLOBAL(void)
 jpeg_stdio_dest(j_compress_ptr cinfo, FILE* outfile)
+{
+    jpeg_stdio_dest_buffered(cinfo, outfile, (size_t)OUTPUT_BUF_SIZE, false);
+}
+
+
+/*
+ * Prepare for output to a stdio stream, writing buffer_size bytes
+ * per fwrite call (0 selects the default size).  If double_buffered is
+ * true, a helper thread writes the previous block while the compressor
+ * fills the current one, overlapping disk I/O with entropy encoding.
+ */
+
+GLOBAL(void)
+jpeg_stdio_dest_buffered(j_compress_ptr cinfo, FILE* outfile,
+    size_t buffer_size, bool double_buffered)
 {
     my_dest_ptr dest;
+    int nbuffers = double_buffered ? 2 : 1;
+    int i;
+
+    if (buffer_size == 0)
+        buffer_size = OUTPUT_BUF_SIZE;
 
     /* The destination object is made permanent so that multiple JPEG images
      * can be written to the same file without re-executing jpeg_stdio_dest.
-     * This makes it dangerous to use this manager and a different destination
-     * manager serially with the same JPEG object, because their private object
-     * sizes may be different.  Caveat programmer.
+     * A destination object left by a different destination manager may be
+     * too small, so it is not reused.
      */
-    if (cinfo->dest == NULL) {	/* first time for this JPEG object? */
+    if (cinfo->dest == NULL ||
+        cinfo->dest->init_destination != init_destination) {
         cinfo->dest = (struct jpeg_destination_mgr*)
             (*cinfo->mem->alloc_small) ((j_common_ptr)cinfo, JPOOL_PERMANENT,
                 SIZEOF(my_destination_mgr));
+        dest = (my_dest_ptr)cinfo->dest;
+        dest->buffer_capacity = 0;
+        dest->buffers[0] = NULL;
+        dest->buffers[1] = NULL;
+        dest->io_thread = NULL;
+        dest->write_pending = false;
+    }
+    else {
+        jpeg_stdio_dest_sync(cinfo);	/* finish writing to the old stream */
     }
 
     dest = (my_dest_ptr)cinfo->dest;
+    if (buffer_size > dest->buffer_capacity) {
+        /* Buffers cannot be freed from the permanent pool, so only grow */
+        dest->buffers[0] = NULL;
+        dest->buffers[1] = NULL;
+        dest->buffer_capacity = buffer_size;
+    }
+    for (i = 0; i < nbuffers; i++) {
+        if (dest->buffers[i] == NULL)
+            dest->buffers[i] = (JOCTET*)
+                (*cinfo->mem->alloc_large) ((j_common_ptr)cinfo, JPOOL_PERMANENT,
+                    dest->buffer_capacity * SIZEOF(JOCTET));
+    }
+
     dest->pub.init_destination = init_destination;
     dest->pub.empty_output_buffer = empty_output_buffer;
     dest->pub.term_destination = term_destination;
     dest->outfile = outfile;
+    dest->buffer_size = buffer_size;
+    dest->double_buffered = double_buffered;
+    dest->cur_index = 0;
+}
+
+
+/*
+ * Wait for any block being written behind and stop the helper thread.
+ * jpeg_finish_compress, jpeg_abort and jpeg_destroy do this automatically;
+ * call it to close the stream while the object is still in mid-image.
+ * A write error found here is not reported; check ferror on the stream.
+ */
+
+GLOBAL(void)
+jpeg_stdio_dest_sync(j_compress_ptr cinfo)
+{
+    my_dest_ptr dest = (my_dest_ptr)cinfo->dest;
+
+    if (dest == NULL || dest->pub.init_destination != init_destination)
+        return;
+    stop_write(dest);
 }
@@ -0,0 +1,166 @@
+/*
+ * jdatadst_chunk.c
+ *
+ * Based on jdatadst.c.
+ *
+ * This file contains compression data destination routines for the case of
+ * emitting JPEG data into a chain of fixed-size buffers supplied by the
+ * application.  Each buffer is handed back as soon as it is full, so the
+ * application can send it (e.g. with writev) while compression continues,
+ * and the output never has to be gathered into one contiguous block.
+ */
+
+ /* this is not a core library module, so it doesn't define JPEG_INTERNALS */
+#include "jinclude.h"
+#include "jpeglib.h"
+#include "jerror.h"
+
+
+/* Expanded data destination object for chunked output */
+
+typedef struct {
+    struct jpeg_destination_mgr pub; /* public fields */
+
+    size_t chunk_size;		/* size of every chunk */
+    jpeg_chunk_get_method get_chunk;	/* supplies an empty chunk */
+    jpeg_chunk_put_method put_chunk;	/* takes a filled chunk */
+    void* chunk_data;		/* passed through to the callbacks */
+    JOCTET* chunk;		/* chunk being filled, or NULL */
+} my_chunk_destination_mgr;
+
+typedef my_chunk_destination_mgr* my_chunk_dest_ptr;
+
+
+/*
+ * Ask the application for the next chunk to fill.
+ */
+
+LOCAL(void)
+next_chunk(j_compress_ptr cinfo)
+{
+    my_chunk_dest_ptr dest = (my_chunk_dest_ptr)cinfo->dest;
+
+    dest->chunk = (*dest->get_chunk) (cinfo, dest->chunk_data);
+    if (dest->chunk == NULL)
+        ERREXIT(cinfo, JERR_FILE_WRITE);
+
+    dest->pub.next_output_byte = dest->chunk;
+    dest->pub.free_in_buffer = dest->chunk_size;
+}
+
+
+/*
+ * Initialize destination --- called by jpeg_start_compress
+ * before any data is actually written.
+ */
+
+METHODDEF(void)
+init_chunk_destination(j_compress_ptr cinfo)
+{
+    my_chunk_dest_ptr dest = (my_chunk_dest_ptr)cinfo->dest;
+
+    /* A chunk left partly filled by an aborted image is reused from the start */
+    if (dest->chunk == NULL)
+        next_chunk(cinfo);
+    else {
+        dest->pub.next_output_byte = dest->chunk;
+        dest->pub.free_in_buffer = dest->chunk_size;
+    }
+}
+
+
+/*
+ * Empty the output buffer --- called whenever a chunk fills up.
+ * The full chunk goes to the application and a fresh one is requested.
+ * Suspension is not supported; a callback that cannot proceed must ERREXIT.
+ */
+
+METHODDEF(bool)
+empty_chunk_output_buffer(j_compress_ptr cinfo)
+{
+    my_chunk_dest_ptr dest = (my_chunk_dest_ptr)cinfo->dest;
+    JOCTET* chunk = dest->chunk;
+
+    dest->chunk = NULL;		/* ownership passes to the application */
+    (*dest->put_chunk) (cinfo, dest->chunk_data, chunk, dest->chunk_size);
+    next_chunk(cinfo);
+
+    return true;
+}
+
+
+/*
+ * Terminate destination --- called by jpeg_finish_compress
+ * after all data has been written.  Hands over the last, partly filled
+ * chunk.  The application knows the image is complete when
+ * jpeg_finish_compress returns.
+ *
+ * NB: *not* called by jpeg_abort or jpeg_destroy; a chunk being filled
+ * when compression is abandoned stays with the destination object.  It is
+ * reused by the next image, or returned by the next jpeg_chunk_dest call.
+ */
+
+METHODDEF(void)
+term_chunk_destination(j_compress_ptr cinfo)
+{
+    my_chunk_dest_ptr dest = (my_chunk_dest_ptr)cinfo->dest;
+    JOCTET* chunk = dest->chunk;
+    size_t datacount = dest->chunk_size - dest->pub.free_in_buffer;
+
+    dest->chunk = NULL;
+    /* datacount may be 0, in which case the chunk just goes back unused */
+    (*dest->put_chunk) (cinfo, dest->chunk_data, chunk, datacount);
+
+    dest->pub.next_output_byte = NULL;
+    dest->pub.free_in_buffer = 0;
+}
+
+
+/*
+ * Prepare for output to a chain of application buffers.
+ * get_chunk must return a writable buffer of chunk_size bytes each time
+ * it is called.  put_chunk receives every chunk in output order together
+ * with the number of bytes stored in it; only the last chunk of an image
+ * can be partly filled (or empty).  Once passed to put_chunk, a chunk
+ * belongs to the application again.
+ */
+
+GLOBAL(void)
+jpeg_chunk_dest(j_compress_ptr cinfo, size_t chunk_size,
+    jpeg_chunk_get_method get_chunk, jpeg_chunk_put_method put_chunk,
+    void* chunk_data)
+{
+    my_chunk_dest_ptr dest;
+
+    if (chunk_size == 0 || get_chunk == NULL || put_chunk == NULL)
+        ERREXIT(cinfo, JERR_BUFFER_SIZE);
+
+    /* The destination object is made permanent so that multiple JPEG images
+     * can be written without re-executing jpeg_chunk_dest.  A destination
+     * object left by a different destination manager may be too small,
+     * so it is not reused.
+     */
+    if (cinfo->dest == NULL ||
+        cinfo->dest->init_destination != init_chunk_destination) {
+        cinfo->dest = (struct jpeg_destination_mgr*)
+            (*cinfo->mem->alloc_small) ((j_common_ptr)cinfo, JPOOL_PERMANENT,
+                SIZEOF(my_chunk_destination_mgr));
+        ((my_chunk_dest_ptr)cinfo->dest)->chunk = NULL;
+    }
+
+    dest = (my_chunk_dest_ptr)cinfo->dest;
+    if (dest->chunk != NULL) {
+        /* Return a chunk left over from an aborted image to its owner */
+        (*dest->put_chunk) (cinfo, dest->chunk_data, dest->chunk, 0);
+        dest->chunk = NULL;
+    }
+    dest->pub.init_destination = init_chunk_destination;
+    dest->pub.empty_output_buffer = empty_chunk_output_buffer;
+    dest->pub.term_destination = term_chunk_destination;
+    dest->chunk_size = chunk_size;
+    dest->get_chunk = get_chunk;
+    dest->put_chunk = put_chunk;
+    dest->chunk_data = chunk_data;
+    dest->pub.next_output_byte = NULL;
+    dest->pub.free_in_buffer = 0;
+}
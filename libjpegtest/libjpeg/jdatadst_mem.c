@@ -23,6 +23,11 @@
 
 #define OUTPUT_BUF_SIZE  (4096)	/* choose an efficiently fwrite'able size */
 
+/* Output size estimate (see estimate_output_size) */
+#define ESTIMATE_BLOCK_BITS  (372.0)	/* bits per 8x8 block at a mean quantizer of 1 */
+#define ESTIMATE_MAX_BLOCK_BITS  (512.0)	/* 8 bits per sample */
+#define ESTIMATE_HEADER_SIZE  (1024)	/* markers and tables */
+
 /* Expanded data destination object for memory output */
 
 typedef struct {
@@ -35,14 +40,140 @@ typedef struct {
     JOCTET* buffer;		/* start of buffer */
     size_t bufsize; /* size of buffer. */
     bool allow_allocate_memory; /* allow alocate memory. */
+    bool shrink_to_fit; /* trim newbuffer to the data size at term. */
 } my_mem_destination_mgr;
 
 typedef my_mem_destination_mgr* my_mem_dest_ptr;
 
+METHODDEF(bool) empty_mem_output_buffer JPP((j_compress_ptr cinfo));
+
+/*
+ * Integer square root, rounded down.  Only the estimate below needs one,
+ * and it isn't worth pulling in the math library for.
+ */
+
+LOCAL(long)
+isqrt(long x)
+{
+    long root = 0, bit = 1L << 30;
+
+    while (bit > x)
+        bit >>= 2;
+    while (bit != 0) {
+        if (x >= root + bit) {
+            x -= root + bit;
+            root = (root >> 1) + bit;
+        }
+        else
+            root >>= 1;
+        bit >>= 2;
+    }
+    return root;
+}
+
+/*
+ * Estimate the compressed size of the image about to be written.
+ * The bits spent on an 8x8 block are taken as inversely proportional to
+ * the square root of the mean quantizer of its table.  ESTIMATE_BLOCK_BITS
+ * puts a 4:2:0 photo at quality 75 at 1.5 bits per pixel; real photos
+ * at quality 50-95 land within about a factor of 1.5 of the estimate.
+ * This is called before master selection, so the sampling maxima are
+ * computed here rather than taken from cinfo.
+ */
+
+LOCAL(size_t)
+estimate_output_size(j_compress_ptr cinfo)
+{
+    jpeg_component_info* compptr;
+    JQUANT_TBL* qtbl;
+    int ci, i, max_h = 1, max_v = 1;
+    long qsum, qsum_root;
+    double width, height, block_bits, bits = 0.0;
+
+    if (cinfo->comp_info == NULL)
+        return OUTPUT_BUF_SIZE;
+
+    for (ci = 0, compptr = cinfo->comp_info; ci < cinfo->num_components;
+        ci++, compptr++) {
+        if (compptr->h_samp_factor > max_h)
+            max_h = compptr->h_samp_factor;
+        if (compptr->v_samp_factor > max_v)
+            max_v = compptr->v_samp_factor;
+    }
+
+    for (ci = 0, compptr = cinfo->comp_info; ci < cinfo->num_components;
+        ci++, compptr++) {
+        if (compptr->h_samp_factor <= 0 || compptr->v_samp_factor <= 0 ||
+            compptr->quant_tbl_no < 0 || compptr->quant_tbl_no >= NUM_QUANT_TBLS)
+            continue;		/* jpeg_start_compress will reject these */
+        qtbl = cinfo->quant_tbl_ptrs[compptr->quant_tbl_no];
+        block_bits = ESTIMATE_MAX_BLOCK_BITS;
+        if (qtbl != NULL) {
+            qsum = 0;
+            for (i = 0; i < DCTSIZE2; i++)
+                qsum += qtbl->quantval[i];
+            /* sqrt(qsum / DCTSIZE2) == sqrt(qsum) / DCTSIZE; qsum_root keeps
+             * 4 fraction bits (qsum is at most 64 * 65535, so this fits)
+             */
+            qsum_root = isqrt(qsum << 8);
+            if (qsum_root > 0 &&
+                ESTIMATE_BLOCK_BITS * DCTSIZE * 16 / qsum_root < block_bits)
+                block_bits = ESTIMATE_BLOCK_BITS * DCTSIZE * 16 / qsum_root;
+        }
+        width = (double)cinfo->image_width * compptr->h_samp_factor / max_h;
+        height = (double)cinfo->image_height * compptr->v_samp_factor / max_v;
+        bits += (width / DCTSIZE) * (height / DCTSIZE) * block_bits;
+    }
+
+    bits = bits / 8.0 + ESTIMATE_HEADER_SIZE;
+    if (bits >= (double)((size_t)-1 / 2))	/* leave growth to empty_output */
+        return (size_t)-1 / 2;
+    if (bits < (double)OUTPUT_BUF_SIZE)
+        return OUTPUT_BUF_SIZE;
+    return (size_t)bits;
+}
+
 METHODDEF(void)
 init_mem_destination(j_compress_ptr cinfo)
 {
-    /* no work necessary here */
+    my_mem_dest_ptr dest = (my_mem_dest_ptr)cinfo->dest;
+    size_t estimate;
+    JOCTET* nextbuffer;
+
+    /* A buffer trimmed by the previous image is full; the marker writer
+     * stores a byte before checking for space, so make room first.
+     */
+    if (dest->pub.free_in_buffer == 0) {
+        (void)empty_mem_output_buffer(cinfo);
+        return;
+    }
+
+    /* If the buffer is our own and still empty, size it for this image now
+     * that the dimensions and tables are known, so that growing it is rare.
+     * Nothing has been written, so malloc + free avoids a copy.
+     */
+    if (!dest->allow_allocate_memory || dest->newbuffer == NULL ||
+        dest->buffer != dest->newbuffer ||
+        dest->pub.next_output_byte != dest->buffer)
+        return;
+
+    estimate = estimate_output_size(cinfo);
+    if (estimate <= dest->bufsize)
+        return;
+
+    nextbuffer = (JOCTET*)(malloc(estimate));
+    if (nextbuffer == NULL) /* keep the current buffer and grow it on demand */
+        return;
+
+    free(dest->newbuffer);
+    dest->newbuffer = nextbuffer;
+    dest->newbufsize = estimate;
+    dest->buffer = nextbuffer;
+    dest->bufsize = estimate;
+    dest->pub.next_output_byte = nextbuffer;
+    dest->pub.free_in_buffer = estimate;
+    *dest->outbuffer = nextbuffer;
+    *dest->outsize = estimate;
 }
 
 METHODDEF(bool)
@@ -59,18 +190,26 @@ empty_mem_output_buffer(j_compress_ptr cinfo)
 
     /* Try to allocate new buffer with double size */
     nextsize = dest->bufsize * 2;
-    nextbuffer = (JOCTET*)(malloc(nextsize));
-    if (nextbuffer == NULL) {
-        ERREXIT1(cinfo, JERR_OUT_OF_MEMORY, 11);
-        return false;
+    if (dest->buffer == dest->newbuffer) {
+        /* Our own buffer: realloc can often extend it in place, and for large
+         * blocks the C library remaps pages (mremap on Linux) instead of
+         * copying.  On failure the old buffer is still ours to free.
+         */
+        nextbuffer = (JOCTET*)(realloc(dest->newbuffer, nextsize));
+        if (nextbuffer == NULL) {
+            ERREXIT1(cinfo, JERR_OUT_OF_MEMORY, 11);
+            return false;
+        }
     }
+    else {
+        /* The caller's buffer must be left alone, so copy out of it once */
+        nextbuffer = (JOCTET*)(malloc(nextsize));
+        if (nextbuffer == NULL) {
+            ERREXIT1(cinfo, JERR_OUT_OF_MEMORY, 11);
+            return false;
+        }
 
-    memcpy(nextbuffer, dest->buffer, dest->bufsize);
-
-    if (dest->newbuffer != NULL) {
-        free(dest->newbuffer);
-        dest->newbuffer = NULL;
-        dest->newbufsize = 0;
+        memcpy(nextbuffer, dest->buffer, dest->bufsize);
     }
 
     dest->newbuffer = nextbuffer;
@@ -82,6 +221,12 @@ empty_mem_output_buffer(j_compress_ptr cinfo)
     dest->buffer = nextbuffer;
     dest->bufsize = nextsize;
 
+    /* Keep the caller's variables on the live buffer, so that it can still
+     * be freed if compression is abandoned before term_destination.
+     */
+    *dest->outbuffer = nextbuffer;
+    *dest->outsize = nextsize;
+
     return true;
 }
 
@@ -89,9 +234,25 @@ METHODDEF(void)
 term_mem_destination(j_compress_ptr cinfo)
 {
     my_mem_dest_ptr dest = (my_mem_dest_ptr)cinfo->dest;
+    size_t datasize = dest->bufsize - dest->pub.free_in_buffer;
+    JOCTET* fitbuffer;
+
+    /* Give back the unused tail of our own buffer, if requested */
+    if (dest->shrink_to_fit && dest->buffer == dest->newbuffer &&
+        datasize > 0 && datasize < dest->bufsize) {
+        fitbuffer = (JOCTET*)(realloc(dest->newbuffer, datasize));
+        if (fitbuffer != NULL) { /* on failure keep the larger buffer */
+            dest->newbuffer = fitbuffer;
+            dest->newbufsize = datasize;
+            dest->buffer = fitbuffer;
+            dest->bufsize = datasize;
+            dest->pub.next_output_byte = fitbuffer + datasize;
+            dest->pub.free_in_buffer = 0;
+        }
+    }
 
     *dest->outbuffer = dest->buffer; // Overwrite passed variable.
-    *dest->outsize = dest->bufsize - dest->pub.free_in_buffer; // Overwrite passed variable.
+    *dest->outsize = datasize; // Overwrite passed variable.
 
     return;
 }
@@ -108,6 +269,8 @@ term_mem_destination(j_compress_ptr cinfo)
  * Note:  An initial buffer supplied by the caller is expected to be
  * managed by the application.  The library does not free such buffer
  * when allocating a larger buffer.
+ * When the library allocates the buffer, it is sized from an estimate of
+ * the output at jpeg_start_compress, and grown with realloc.
  */
 GLOBAL(bool)
 jpeg_mem_dest(j_compress_ptr cinfo,
@@ -129,9 +292,11 @@ jpeg_mem_dest(j_compress_ptr cinfo,
     /* The destination object is made permanent so that multiple JPEG images
      * can be written to the same buffer without re-executing jpeg_mem_dest.
      */
-    if (cinfo->dest == NULL) {	/* first time for this JPEG object? */
+    if (cinfo->dest == NULL ||	/* first time for this JPEG object? */
+        cinfo->dest->init_destination != init_mem_destination) {
         cinfo->dest = (struct jpeg_destination_mgr*)(*cinfo->mem->alloc_small)
             ((j_common_ptr)cinfo, JPOOL_PERMANENT, SIZEOF(my_mem_destination_mgr));
+        ((my_mem_dest_ptr)cinfo->dest)->shrink_to_fit = false;
     }
 
     dest = (my_mem_dest_ptr)cinfo->dest;
@@ -163,4 +328,19 @@ jpeg_mem_dest(j_compress_ptr cinfo,
     dest->pub.free_in_buffer = dest->bufsize;
 
     return true;
+}
+
+/*
+ * Choose whether a buffer allocated by the library is trimmed to the
+ * size of the data at jpeg_finish_compress.  Off by default; turn it on
+ * when the buffer is kept after compression.  Call after jpeg_mem_dest.
+ */
+GLOBAL(void)
+jpeg_mem_dest_shrink_to_fit(j_compress_ptr cinfo, bool shrink_to_fit)
+{
+    my_mem_dest_ptr dest = (my_mem_dest_ptr)cinfo->dest;
+
+    if (dest == NULL || dest->pub.init_destination != init_mem_destination)
+        ERREXIT(cinfo, JERR_BAD_STATE);
+    dest->shrink_to_fit = shrink_to_fit;
 }
\ No newline at end of file
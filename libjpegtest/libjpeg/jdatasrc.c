@@ -9,6 +9,8 @@
  * reading JPEG data from a file (or any stdio stream).  While these routines
  * are sufficient for most applications, some will want to use a different
  * source manager.
+ * The buffer size can be chosen per JPEG object, and the next block can
+ * optionally be read ahead by a helper thread (see jpeg_stdio_src_buffered).
  * IMPORTANT: we assume that fread() will correctly transcribe an array of
  * JOCTETs from 8-bit-wide elements on external storage.  If char is wider
  * than 8 bits on your machine, you may need to do some tweaking.
@@ -18,8 +20,17 @@
 #include "jinclude.h"
 #include "jpeglib.h"
 #include "jerror.h"
+#include "io_thread.h"
 
 
+/* State of the block read ahead into the other buffer */
+
+typedef enum {
+    PREFETCH_NONE,		/* nothing read ahead */
+    PREFETCH_PENDING,	/* helper thread is reading */
+    PREFETCH_READY		/* read finished; prefetch_bytes is valid */
+} J_PREFETCH_STATE;
+
 /* Expanded data source object for stdio input */
 
 typedef struct {
@@ -28,11 +39,51 @@ typedef struct {
     FILE* infile;		/* source stream */
     JOCTET* buffer;		/* start of buffer */
     bool start_of_file;	/* have we gotten any data yet? */
+
+    size_t buffer_size;	/* size of each buffer */
+    size_t buffer_capacity;	/* allocated size of each buffer */
+    bool double_buffered;	/* read the next block ahead? */
+    JOCTET* buffers[2];	/* buffer pair; only [0] unless double-buffered */
+    int next_index;		/* buffer to be filled next */
+    io_thread_t* io_thread;	/* helper thread, or NULL if not running */
+    J_PREFETCH_STATE prefetch;	/* state of buffers[next_index] */
+    size_t prefetch_bytes;	/* # of bytes read ahead */
 } my_source_mgr;
 
 typedef my_source_mgr* my_src_ptr;
 
-#define INPUT_BUF_SIZE  4096	/* choose an efficiently fread'able size */
+#define INPUT_BUF_SIZE  4096	/* default size; choose an efficiently fread'able size */
+
+
+/*
+ * Wait for any block being read ahead and stop the helper thread.
+ * A block already read is kept for the next image in the same stream.
+ */
+
+LOCAL(void)
+stop_prefetch(my_src_ptr src)
+{
+    if (src->prefetch == PREFETCH_PENDING) {
+        src->prefetch_bytes = io_thread_wait(src->io_thread);
+        src->prefetch = PREFETCH_READY;
+    }
+    if (src->io_thread != NULL) {
+        io_thread_stop(src->io_thread);
+        src->io_thread = NULL;
+    }
+}
+
+/*
+ * Cleanup routine run when the IMAGE pool is freed, including by jpeg_abort
+ * and jpeg_destroy after an error exit: the helper thread must be stopped
+ * before the buffer it reads into is released or the stream is closed.
+ */
+
+METHODDEF(void)
+cleanup_source(j_common_ptr cinfo, void* arg)
+{
+    stop_prefetch((my_src_ptr)arg);
+}
 
 
 /*
@@ -50,6 +101,13 @@ init_source(j_decompress_ptr cinfo)
      * This is correct behavior for reading a series of images from one source.
      */
     src->start_of_file = true;
+
+    /* The helper thread is started only after this, so it is always stopped
+     * before the image is released.
+     */
+    if (src->double_buffered)
+        (*cinfo->mem->register_cleanup) ((j_common_ptr)cinfo, JPOOL_IMAGE,
+            cleanup_source, (void*)src);
 }
 
 
@@ -86,13 +144,63 @@ init_source(j_decompress_ptr cinfo)
  * the front of the buffer rather than discarding it.
  */
 
+METHODDEF(size_t)
+read_file_block(void* context, void* buffer, size_t length)
+{
+    /* Runs on the helper thread.  The main thread does not touch the file
+     * or the buffer until io_thread_wait returns.
+     */
+    return JFREAD((FILE*)context, buffer, length);
+}
+
+/*
+ * Start reading the next block into the buffer that is not in use.
+ * If no helper thread can be started, the block is read synchronously
+ * by the next fill_input_buffer call instead.
+ */
+
+LOCAL(void)
+start_prefetch(my_src_ptr src)
+{
+    if (src->io_thread == NULL)
+        src->io_thread = io_thread_start();
+    if (src->io_thread == NULL)
+        return;
+
+    io_thread_post(src->io_thread, read_file_block, (void*)src->infile,
+        (void*)src->buffers[src->next_index], src->buffer_size);
+    src->prefetch = PREFETCH_PENDING;
+}
+
 METHODDEF(bool)
 fill_input_buffer(j_decompress_ptr cinfo)
 {
     my_src_ptr src = (my_src_ptr)cinfo->src;
     size_t nbytes;
 
-    nbytes = JFREAD(src->infile, src->buffer, INPUT_BUF_SIZE);
+    if (!src->double_buffered) {
+        nbytes = JFREAD(src->infile, src->buffer, src->buffer_size);
+    }
+    else {
+        /* Take the block read ahead into the other buffer (reading it now
+         * if nothing was read ahead), then start reading the following block
+         * into the buffer the decoder has just emptied.
+         */
+        if (src->prefetch == PREFETCH_PENDING) {
+            src->prefetch_bytes = io_thread_wait(src->io_thread);
+            src->prefetch = PREFETCH_READY;
+        }
+        if (src->prefetch == PREFETCH_READY)
+            nbytes = src->prefetch_bytes;
+        else
+            nbytes = JFREAD(src->infile, src->buffers[src->next_index],
+                src->buffer_size);
+        src->prefetch = PREFETCH_NONE;
+        src->buffer = src->buffers[src->next_index];
+        src->next_index ^= 1;
+        if (nbytes > 0)
+            start_prefetch(src);
+    }
 
     if (nbytes <= 0) {
         if (src->start_of_file)	/* Treat empty input file as fatal error */
@@ -129,11 +237,36 @@ skip_input_data(j_decompress_ptr cinfo, long num_bytes)
 {
     my_src_ptr src = (my_src_ptr)cinfo->src;
 
-    /* Just a dumb implementation for now.  Could use fseek() except
-     * it doesn't work on pipes.  Not clear that being smart is worth
-     * any trouble anyway --- large skips are infrequent.
+    if (num_bytes <= 0)
+        return;
+
+    /* Large skips (EXIF thumbnails, ICC profiles, XMP) are common enough
+     * to be worth an fseek() past whatever is not yet buffered.
      */
-    if (num_bytes > 0) {
+    if (num_bytes > (long)src->pub.bytes_in_buffer) {
+        num_bytes -= (long)src->pub.bytes_in_buffer;
+        src->pub.next_input_byte += src->pub.bytes_in_buffer;
+        src->pub.bytes_in_buffer = 0;
+
+        /* A block read ahead lies between the buffer and the file position */
+        if (src->prefetch == PREFETCH_PENDING) {
+            src->prefetch_bytes = io_thread_wait(src->io_thread);
+            src->prefetch = PREFETCH_READY;
+        }
+        if (src->prefetch == PREFETCH_READY) {
+            if ((size_t)num_bytes < src->prefetch_bytes) {
+                (void)fill_input_buffer(cinfo);	/* the skip ends in that block */
+            }
+            else {
+                num_bytes -= (long)src->prefetch_bytes;
+                src->prefetch = PREFETCH_NONE;
+            }
+        }
+
+        /* fseek() doesn't work on pipes; then read through the data */
+        if (src->pub.bytes_in_buffer == 0 &&
+            fseek(src->infile, num_bytes, SEEK_CUR) == 0)
+            return;
         while (num_bytes > (long)src->pub.bytes_in_buffer) {
             num_bytes -= (long)src->pub.bytes_in_buffer;
             (void)fill_input_buffer(cinfo);
@@ -141,9 +274,9 @@ skip_input_data(j_decompress_ptr cinfo, long num_bytes)
              * so suspension need not be handled.
              */
         }
-        src->pub.next_input_byte += (size_t)num_bytes;
-        src->pub.bytes_in_buffer -= (size_t)num_bytes;
     }
+    src->pub.next_input_byte += (size_t)num_bytes;
+    src->pub.bytes_in_buffer -= (size_t)num_bytes;
 }
 
 
@@ -158,17 +291,17 @@ skip_input_data(j_decompress_ptr cinfo, long num_bytes)
 
  /*
   * Terminate source --- called by jpeg_finish_decompress
-  * after all data has been read.  Often a no-op.
+  * after all data has been read.  Stops the helper thread, if any.
   *
   * NB: *not* called by jpeg_abort or jpeg_destroy; surrounding
   * application must deal with any cleanup that should happen even
-  * for error exit.
+  * for error exit.  (The helper thread is stopped by cleanup_source then.)
   */
 
 METHODDEF(void)
 term_source(j_decompress_ptr cinfo)
 {
-    /* no work necessary here */
+    jpeg_stdio_src_sync(cinfo);
 }
 
 
@@ -180,34 +313,94 @@ term_source(j_decompress_ptr cinfo)
 
 GLOBAL(void)
 jpeg_stdio_src(j_decompress_ptr cinfo, FILE* infile)
+{
+    jpeg_stdio_src_buffered(cinfo, infile, (size_t)INPUT_BUF_SIZE, false);
+}
+
+
+/*
+ * Prepare for input from a stdio stream, reading buffer_size bytes
+ * per fread call (0 selects the default size).  If double_buffered is
+ * true, a helper thread reads the next block while the decoder works on
+ * the current one, overlapping disk I/O with entropy decoding.
+ */
+
+GLOBAL(void)
+jpeg_stdio_src_buffered(j_decompress_ptr cinfo, FILE* infile,
+    size_t buffer_size, bool double_buffered)
 {
     my_src_ptr src;
+    int nbuffers = double_buffered ? 2 : 1;
+    int i;
 
-    /* The source object and input buffer are made permanent so that a series
+    if (buffer_size == 0)
+        buffer_size = INPUT_BUF_SIZE;
+
+    /* The source object and input buffers are made permanent so that a series
      * of JPEG images can be read from the same file by calling jpeg_stdio_src
      * only before the first one.  (If we discarded the buffer at the end of
      * one image, we'd likely lose the start of the next one.)
-     * This makes it unsafe to use this manager and a different source
-     * manager serially with the same JPEG object.  Caveat programmer.
+     * A source object left by a different source manager may be too small,
+     * so it is not reused.
      */
-    if (cinfo->src == NULL) {	/* first time for this JPEG object? */
+    if (cinfo->src == NULL || cinfo->src->init_source != init_source) {
         cinfo->src = (struct jpeg_source_mgr*)
             (*cinfo->mem->alloc_small) ((j_common_ptr)cinfo, JPOOL_PERMANENT,
                 SIZEOF(my_source_mgr));
         src = (my_src_ptr)cinfo->src;
-        src->buffer = (JOCTET*)
-            (*cinfo->mem->alloc_small) ((j_common_ptr)cinfo, JPOOL_PERMANENT,
-                INPUT_BUF_SIZE * SIZEOF(JOCTET));
+        src->buffer_capacity = 0;
+        src->buffers[0] = NULL;
+        src->buffers[1] = NULL;
+        src->io_thread = NULL;
+        src->prefetch = PREFETCH_NONE;
+    }
+    else {
+        jpeg_stdio_src_sync(cinfo);	/* stop reading ahead from the old stream */
     }
 
     src = (my_src_ptr)cinfo->src;
+    if (buffer_size > src->buffer_capacity) {
+        /* Buffers cannot be freed from the permanent pool, so only grow */
+        src->buffers[0] = NULL;
+        src->buffers[1] = NULL;
+        src->buffer_capacity = buffer_size;
+    }
+    for (i = 0; i < nbuffers; i++) {
+        if (src->buffers[i] == NULL)
+            src->buffers[i] = (JOCTET*)
+                (*cinfo->mem->alloc_large) ((j_common_ptr)cinfo, JPOOL_PERMANENT,
+                    src->buffer_capacity * SIZEOF(JOCTET));
+    }
+
     src->pub.init_source = init_source;
     src->pub.fill_input_buffer = fill_input_buffer;
     src->pub.skip_input_data = skip_input_data;
     src->pub.resync_to_restart = jpeg_resync_to_restart; /* use default method */
     src->pub.term_source = term_source;
     src->infile = infile;
+    src->buffer = src->buffers[0];
+    src->buffer_size = buffer_size;
+    src->double_buffered = double_buffered;
+    src->next_index = 0;
+    src->prefetch = PREFETCH_NONE; /* anything read ahead belongs to the old stream */
     src->pub.bytes_in_buffer = 0; /* forces fill_input_buffer on first read */
     src->pub.next_input_byte = NULL; /* until buffer loaded */
 }
 
+
+/*
+ * Wait for any block being read ahead and stop the helper thread.
+ * A block already read is kept for the next image in the same stream.
+ * jpeg_finish_decompress, jpeg_abort and jpeg_destroy do this automatically;
+ * call it to close the stream while the object is still in mid-image.
+ */
+
+GLOBAL(void)
+jpeg_stdio_src_sync(j_decompress_ptr cinfo)
+{
+    my_src_ptr src = (my_src_ptr)cinfo->src;
+
+    if (src == NULL || src->pub.init_source != init_source)
+        return;
+    stop_prefetch(src);
+}
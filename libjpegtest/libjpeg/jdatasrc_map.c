@@ -0,0 +1,183 @@
+/*
+ * jdatasrc_map.c
+ *
+ * Based on jdatasrc.c.
+ *
+ * This file contains decompression data source routines for the case of
+ * reading JPEG data from a file that is memory-mapped as a whole.
+ * next_input_byte points straight into the mapping, so the data are never
+ * copied and the file may be of any size the address space can hold.
+ */
+
+ /* this is not a core library module, so it doesn't define JPEG_INTERNALS */
+#include "jinclude.h"
+#include "jpeglib.h"
+#include "jerror.h"
+#include "mem_file_map.h"
+
+
+/* Expanded data source object for mapped file input */
+
+typedef struct {
+    struct jpeg_source_mgr pub;	/* public fields */
+
+    JOCTET* map_address;		/* start of the mapping, or NULL if none */
+    size_t map_size;		/* size of the mapping (= file size) */
+} my_map_source_mgr;
+
+typedef my_map_source_mgr* my_map_src_ptr;
+
+
+METHODDEF(void)
+init_map_source(j_decompress_ptr cinfo)
+{
+    /* no work necessary here */
+}
+
+METHODDEF(bool)
+fill_map_input_buffer(j_decompress_ptr cinfo)
+{
+    static const JOCTET mybuffer[4] = {
+      (JOCTET)0xFF, (JOCTET)JPEG_EOI, 0, 0
+    };
+
+    /* The whole file is mapped, so running out of data means the file is
+     * truncated.  Insert a fake EOI marker, as jdatasrc_mem.c does.
+     */
+    WARNMS(cinfo, JWRN_JPEG_EOF);
+
+    cinfo->src->next_input_byte = mybuffer;
+    cinfo->src->bytes_in_buffer = 2;
+
+    return true;
+}
+
+/*
+ * Skip data --- since all of the file is in the buffer, this is just
+ * pointer arithmetic.  Skipping past the end behaves like reaching EOF.
+ */
+
+METHODDEF(void)
+skip_map_input_data(j_decompress_ptr cinfo, long num_bytes)
+{
+    struct jpeg_source_mgr* src = cinfo->src;
+
+    if (num_bytes > 0) {
+        if ((size_t)num_bytes > src->bytes_in_buffer) {
+            (void)(*src->fill_input_buffer) (cinfo);
+        }
+        else {
+            src->next_input_byte += (size_t)num_bytes;
+            src->bytes_in_buffer -= (size_t)num_bytes;
+        }
+    }
+}
+
+/*
+ * Release the mapping of a source object, if any.
+ */
+
+LOCAL(void)
+release_mapping(my_map_src_ptr src)
+{
+    if (src->map_address != NULL) {
+        mem_file_unmap((mem_addr_t)src->map_address, src->map_size);
+        src->map_address = NULL;
+        src->map_size = 0;
+    }
+    src->pub.next_input_byte = NULL;
+    src->pub.bytes_in_buffer = 0;
+}
+
+/*
+ * Cleanup routine run when the IMAGE pool is freed: by jpeg_finish_decompress
+ * (after term_source), and by jpeg_abort or jpeg_destroy after an error exit,
+ * so an abandoned decompression does not keep the file mapped.
+ */
+
+METHODDEF(void)
+cleanup_map_source(j_common_ptr cinfo, void* arg)
+{
+    release_mapping((my_map_src_ptr)arg);
+}
+
+/*
+ * Terminate source --- called by jpeg_finish_decompress
+ * after all data has been read.  The mapping is released here.
+ */
+
+METHODDEF(void)
+term_map_source(j_decompress_ptr cinfo)
+{
+    release_mapping((my_map_src_ptr)cinfo->src);
+}
+
+
+/*
+ * Prepare for input from a memory-mapped file.
+ * Returns false if the file could not be opened or mapped; the application
+ * may then fall back to another source manager.
+ * The mapping lasts until jpeg_finish_decompress, jpeg_abort or jpeg_destroy,
+ * so one call maps one datastream.
+ */
+
+GLOBAL(bool)
+jpeg_map_src(j_decompress_ptr cinfo, const char* path)
+{
+    my_map_src_ptr src;
+    JOCTET* map_address;
+    size_t map_size;
+
+    /* The source object is made permanent so that a series of files can be
+     * read with one JPEG object.  A source object left by a different
+     * source manager may be too small, so it is not reused.
+     */
+    if (cinfo->src == NULL || cinfo->src->init_source != init_map_source) {
+        cinfo->src = (struct jpeg_source_mgr*)
+            (*cinfo->mem->alloc_small) ((j_common_ptr)cinfo, JPOOL_PERMANENT,
+                SIZEOF(my_map_source_mgr));
+        src = (my_map_src_ptr)cinfo->src;
+        src->map_address = NULL;
+        src->map_size = 0;
+    }
+    else {
+        jpeg_unmap_src(cinfo);	/* release the previous file, if still mapped */
+    }
+
+    map_address = (JOCTET*)mem_file_map(path, &map_size);
+    if (map_address == NULL)
+        return false;
+
+    src = (my_map_src_ptr)cinfo->src;
+    src->map_address = map_address;
+    src->map_size = map_size;
+    src->pub.init_source = init_map_source;
+    src->pub.fill_input_buffer = fill_map_input_buffer;
+    src->pub.skip_input_data = skip_map_input_data;
+    src->pub.resync_to_restart = jpeg_resync_to_restart; /* use default method */
+    src->pub.term_source = term_map_source;
+    src->pub.bytes_in_buffer = map_size;
+    src->pub.next_input_byte = map_address;
+
+    (*cinfo->mem->register_cleanup) ((j_common_ptr)cinfo, JPOOL_IMAGE,
+        cleanup_map_source, (void*)src);
+
+    return true;
+}
+
+
+/*
+ * Release the mapping made by jpeg_map_src, if any.
+ * jpeg_finish_decompress, jpeg_abort and jpeg_destroy do this automatically;
+ * this is for an application that wants the file back earlier.
+ */
+
+GLOBAL(void)
+jpeg_unmap_src(j_decompress_ptr cinfo)
+{
+    my_map_src_ptr src = (my_map_src_ptr)cinfo->src;
+
+    if (src == NULL || src->pub.init_source != init_map_source)
+        return;
+    release_mapping(src);
+}
@@ -51,35 +51,24 @@ fill_mem_input_buffer(j_decompress_ptr cinfo)
  * Skip data --- used to skip over a potentially large amount of
  * uninteresting data (such as an APPn marker).
  *
- * Writers of suspendable-input applications must note that skip_input_data
- * is not granted the right to give a suspension return.  If the skip extends
- * beyond the data currently in the buffer, the buffer can be marked empty so
- * that the next read will cause a fill_input_buffer call that can suspend.
- * Arranging for additional bytes to be discarded before reloading the input
- * buffer is the application writer's problem.
+ * The whole JPEG data is in the buffer, so this is just pointer
+ * arithmetic however large the skip.  Skipping past the end behaves
+ * like reaching the end: a fake EOI marker is inserted.
  */
 
 METHODDEF(void)
 skip_input_data(j_decompress_ptr cinfo, long num_bytes)
 {
     struct jpeg_source_mgr* src = cinfo->src;
-    size_t nbytes;
 
-    /* Just a dumb implementation for now.  Could use fseek() except
-     * it doesn't work on pipes.  Not clear that being smart is worth
-     * any trouble anyway --- large skips are infrequent.
-     */
     if (num_bytes > 0) {
-        nbytes = (size_t)num_bytes;
-        while (nbytes > src->bytes_in_buffer) {
-            nbytes -= src->bytes_in_buffer;
+        if ((size_t)num_bytes > src->bytes_in_buffer) {
             (void)(*src->fill_input_buffer) (cinfo);
-            /* note we assume that fill_input_buffer will never return FALSE,
-             * so suspension need not be handled.
-             */
         }
-        src->next_input_byte += nbytes;
-        src->bytes_in_buffer -= nbytes;
+        else {
+            src->next_input_byte += (size_t)num_bytes;
+            src->bytes_in_buffer -= (size_t)num_bytes;
+        }
     }
 }
 
@@ -0,0 +1,298 @@
+/*
+ * jdatasrc_push.c
+ *
+ * Based on jdatasrc.c.
+ *
+ * This file contains a suspending data source for the case where the
+ * application receives JPEG data piecemeal (e.g. from a socket) and pushes
+ * each piece in with jpeg_push_src_append.  When the data run out before
+ * jpeg_push_src_end has been called, fill_input_buffer returns false and
+ * the decoder suspends, backing up to its last restart point; decoding
+ * resumes once more data are appended.
+ *
+ * jpeg_push_decode drives the usual header/start/scanlines/finish sequence
+ * and returns whenever it needs more data, so rows can be emitted while the
+ * rest of the image is still arriving.  (A progressive image yields no rows
+ * until all of its scans are in, unless the application uses buffered-image
+ * mode itself.)
+ */
+
+ /* this is not a core library module, so it doesn't define JPEG_INTERNALS */
+#include "jinclude.h"
+#include "jpeglib.h"
+#include "jerror.h"
+
+
+/* Where jpeg_push_decode is in the decompression sequence */
+
+typedef enum {
+    PUSH_READ_HEADER,	/* waiting for jpeg_read_header to complete */
+    PUSH_START,		/* header read; jpeg_start_decompress next */
+    PUSH_SCANLINES,		/* reading scanlines */
+    PUSH_FINISH		/* all rows out; jpeg_finish_decompress next */
+} J_PUSH_STAGE;
+
+/* Expanded data source object for pushed input */
+
+typedef struct {
+    struct jpeg_source_mgr pub;	/* public fields */
+
+    JOCTET* buffer;		/* start of buffer */
+    size_t buffer_size;	/* allocated size of buffer */
+    size_t skip_bytes;	/* bytes still to be discarded from future input */
+    bool end_of_input;	/* jpeg_push_src_end has been called */
+    J_PUSH_STAGE stage;	/* state of jpeg_push_decode */
+} my_push_source_mgr;
+
+typedef my_push_source_mgr* my_push_src_ptr;
+
+#define PUSH_BUF_SIZE  4096	/* initial buffer size */
+
+
+METHODDEF(void)
+init_push_source(j_decompress_ptr cinfo)
+{
+    /* no work necessary here */
+}
+
+
+/*
+ * Fill the input buffer --- called whenever buffer is emptied.
+ *
+ * Before the end of input, this returns false so that the decoder
+ * suspends; the unread bytes stay in the buffer and new data are
+ * appended after them.  After the end of input, running out of data
+ * means the stream is truncated, so a fake EOI marker is inserted.
+ */
+
+METHODDEF(bool)
+fill_push_input_buffer(j_decompress_ptr cinfo)
+{
+    static const JOCTET mybuffer[4] = {
+      (JOCTET)0xFF, (JOCTET)JPEG_EOI, 0, 0
+    };
+    my_push_src_ptr src = (my_push_src_ptr)cinfo->src;
+
+    if (!src->end_of_input)
+        return false;		/* suspend until more data are appended */
+
+    WARNMS(cinfo, JWRN_JPEG_EOF);
+
+    /* Insert a fake EOI marker */
+    src->pub.next_input_byte = mybuffer;
+    src->pub.bytes_in_buffer = 2;
+
+    return true;
+}
+
+
+/*
+ * Skip data --- skip_input_data may not suspend, so a skip running past
+ * the buffered data empties the buffer and remembers how much of the
+ * input still to come must be thrown away.
+ */
+
+METHODDEF(void)
+skip_push_input_data(j_decompress_ptr cinfo, long num_bytes)
+{
+    my_push_src_ptr src = (my_push_src_ptr)cinfo->src;
+
+    if (num_bytes > 0) {
+        if ((size_t)num_bytes > src->pub.bytes_in_buffer) {
+            src->skip_bytes += (size_t)num_bytes - src->pub.bytes_in_buffer;
+            src->pub.next_input_byte += src->pub.bytes_in_buffer;
+            src->pub.bytes_in_buffer = 0;
+        }
+        else {
+            src->pub.next_input_byte += (size_t)num_bytes;
+            src->pub.bytes_in_buffer -= (size_t)num_bytes;
+        }
+    }
+}
+
+
+/*
+ * Terminate source --- called by jpeg_finish_decompress
+ * after all data has been read.  Any bytes left belong to the next image.
+ */
+
+METHODDEF(void)
+term_push_source(j_decompress_ptr cinfo)
+{
+    /* no work necessary here */
+}
+
+
+/*
+ * Prepare for input pushed by the application.
+ * Discards any data buffered for a previous stream.
+ */
+
+GLOBAL(void)
+jpeg_push_src(j_decompress_ptr cinfo)
+{
+    my_push_src_ptr src;
+
+    /* The source object and buffer are made permanent so that a series of
+     * JPEG images can be pushed through one object.  A source object left
+     * by a different source manager may be too small, so it is not reused.
+     */
+    if (cinfo->src == NULL || cinfo->src->init_source != init_push_source) {
+        cinfo->src = (struct jpeg_source_mgr*)
+            (*cinfo->mem->alloc_small) ((j_common_ptr)cinfo, JPOOL_PERMANENT,
+                SIZEOF(my_push_source_mgr));
+        src = (my_push_src_ptr)cinfo->src;
+        src->buffer = (JOCTET*)
+            (*cinfo->mem->alloc_large) ((j_common_ptr)cinfo, JPOOL_PERMANENT,
+                PUSH_BUF_SIZE * SIZEOF(JOCTET));
+        src->buffer_size = PUSH_BUF_SIZE;
+    }
+
+    src = (my_push_src_ptr)cinfo->src;
+    src->pub.init_source = init_push_source;
+    src->pub.fill_input_buffer = fill_push_input_buffer;
+    src->pub.skip_input_data = skip_push_input_data;
+    src->pub.resync_to_restart = jpeg_resync_to_restart; /* use default method */
+    src->pub.term_source = term_push_source;
+    src->pub.bytes_in_buffer = 0;
+    src->pub.next_input_byte = src->buffer;
+    src->skip_bytes = 0;
+    src->end_of_input = false;
+    src->stage = PUSH_READ_HEADER;
+}
+
+
+/*
+ * Append the next piece of input.  The data are copied, so the caller's
+ * buffer may be reused as soon as this returns.
+ */
+
+GLOBAL(void)
+jpeg_push_src_append(j_decompress_ptr cinfo, const JOCTET* data, size_t size)
+{
+    my_push_src_ptr src = (my_push_src_ptr)cinfo->src;
+    size_t unread, new_size;
+    JOCTET* new_buffer;
+
+    if (src == NULL || src->pub.init_source != init_push_source)
+        ERREXIT(cinfo, JERR_BAD_STATE);
+    if (src->end_of_input)
+        ERREXIT(cinfo, JERR_BAD_STATE);
+
+    /* Drop input that a skip ran past */
+    if (src->skip_bytes > 0) {
+        if (size <= src->skip_bytes) {
+            src->skip_bytes -= size;
+            return;
+        }
+        data += src->skip_bytes;
+        size -= src->skip_bytes;
+        src->skip_bytes = 0;
+    }
+    if (size == 0)
+        return;
+
+    /* Keep the unread bytes: after a suspension they start at the
+     * decoder's restart point and will be read again.
+     */
+    unread = src->pub.bytes_in_buffer;
+    if (unread + size > src->buffer_size) {
+        /* The permanent pool cannot free, so grow at least twofold to keep
+         * the total allocated within twice the largest need.
+         */
+        new_size = src->buffer_size * 2;
+        if (new_size < unread + size)
+            new_size = unread + size;
+        new_buffer = (JOCTET*)
+            (*cinfo->mem->alloc_large) ((j_common_ptr)cinfo, JPOOL_PERMANENT,
+                new_size * SIZEOF(JOCTET));
+        MEMCOPY(new_buffer, src->pub.next_input_byte, unread);
+        src->buffer = new_buffer;
+        src->buffer_size = new_size;
+    }
+    else if (unread > 0 && src->pub.next_input_byte != src->buffer) {
+        MEMMOVE(src->buffer, src->pub.next_input_byte, unread);
+    }
+    MEMCOPY(src->buffer + unread, data, size);
+
+    src->pub.next_input_byte = src->buffer;
+    src->pub.bytes_in_buffer = unread + size;
+}
+
+
+/*
+ * Signal that no more input will follow.  From now on the decoder does
+ * not suspend; a truncated stream ends with a warning and a fake EOI.
+ */
+
+GLOBAL(void)
+jpeg_push_src_end(j_decompress_ptr cinfo)
+{
+    my_push_src_ptr src = (my_push_src_ptr)cinfo->src;
+
+    if (src == NULL || src->pub.init_source != init_push_source)
+        ERREXIT(cinfo, JERR_BAD_STATE);
+    src->end_of_input = true;
+}
+
+
+/*
+ * Decode as far as the input allows.  Call after each append.
+ *
+ * Returns JPEG_SUSPENDED when more input is needed.  Returns JPEG_HEADER_OK
+ * once, after the header is read; the application can then set output
+ * parameters and allocate scanline storage before calling again.
+ * Returns JPEG_ROW_COMPLETED with *lines_read set (up to max_lines rows
+ * stored into scanlines), and JPEG_REACHED_EOI when the image is complete,
+ * after which the next call starts on the next image in the stream.
+ * A tables-only datastream returns JPEG_HEADER_TABLES_ONLY, which has the
+ * same value as JPEG_REACHED_EOI but comes without a JPEG_HEADER_OK first;
+ * the tables are kept, and the next call starts on the (abbreviated) image
+ * that follows.
+ */
+
+GLOBAL(int)
+jpeg_push_decode(j_decompress_ptr cinfo, JSAMPARRAY scanlines,
+    JDIMENSION max_lines, JDIMENSION* lines_read)
+{
+    my_push_src_ptr src = (my_push_src_ptr)cinfo->src;
+    int retcode;
+    JDIMENSION nlines;
+
+    if (src == NULL || src->pub.init_source != init_push_source)
+        ERREXIT(cinfo, JERR_BAD_STATE);
+    if (lines_read != NULL)
+        *lines_read = 0;
+
+    switch (src->stage) {
+    case PUSH_READ_HEADER:
+        /* Don't require an image, so a tables-only datastream is returned
+         * instead of ending in JERR_NO_IMAGE; jpeg_read_header has then
+         * already reset the object for the next datastream.
+         */
+        retcode = jpeg_read_header(cinfo, false);
+        if (retcode == JPEG_HEADER_OK)
+            src->stage = PUSH_START;
+        return retcode;
+    case PUSH_START:
+        if (!jpeg_start_decompress(cinfo))
+            return JPEG_SUSPENDED;
+        src->stage = PUSH_SCANLINES;
+        /* FALLTHROUGH */
+    case PUSH_SCANLINES:
+        if (cinfo->output_scanline < cinfo->output_height) {
+            nlines = jpeg_read_scanlines(cinfo, scanlines, max_lines);
+            if (lines_read != NULL)
+                *lines_read = nlines;
+            return (nlines > 0) ? JPEG_ROW_COMPLETED : JPEG_SUSPENDED;
+        }
+        src->stage = PUSH_FINISH;
+        /* FALLTHROUGH */
+    case PUSH_FINISH:
+        if (!jpeg_finish_decompress(cinfo))
+            return JPEG_SUSPENDED;
+        src->stage = PUSH_READ_HEADER;
+        return JPEG_REACHED_EOI;
+    }
+    return JPEG_SUSPENDED;		/* can't get here */
+}
@@ -155,7 +155,7 @@ decompress_onepass(j_decompress_ptr cinfo, JSAMPIMAGE output_buf)
     JSAMPARRAY output_ptr;
     JDIMENSION start_col, output_col;
     jpeg_component_info* compptr;
-    inverse_DCT_method_ptr inverse_DCT;
+    inverse_DCT_method_ptr* inverse_DCT;
 
     /* Loop to process as much as one whole iMCU row */
     for (yoffset = coef->MCU_vert_offset; yoffset < coef->MCU_rows_per_iMCU_row;
@@ -184,7 +184,10 @@ decompress_onepass(j_decompress_ptr cinfo, JSAMPIMAGE output_buf)
                     blkn += compptr->MCU_blocks;
                     continue;
                 }
-                inverse_DCT = cinfo->idct->inverse_DCT[compptr->component_index];
+                /* Pick the cheapest routine for each block, by the position
+                 * of its last nonzero coefficient as found by decode_mcu.
+                 */
+                inverse_DCT = cinfo->idct->inverse_DCT_sparse[compptr->component_index];
                 useful_width = (MCU_col_num < last_MCU_col) ? compptr->MCU_width
                     : compptr->last_col_width;
                 output_ptr = output_buf[compptr->component_index] +
@@ -195,7 +198,9 @@ decompress_onepass(j_decompress_ptr cinfo, JSAMPIMAGE output_buf)
                         yoffset + yindex < compptr->last_row_height) {
                         output_col = start_col;
                         for (xindex = 0; xindex < useful_width; xindex++) {
-                            (*inverse_DCT) (cinfo, compptr,
+                            (*inverse_DCT[IDCT_SPARSE_CLASS(
+                                cinfo->entropy->block_last[blkn + xindex])])
+                                (cinfo, compptr,
                                 (JCOEFPTR)coef->MCU_buffer[blkn + xindex],
                                 output_ptr, output_col);
                             output_col += compptr->DCT_scaled_size;
@@ -11,6 +11,7 @@
 #define JPEG_INTERNALS
 #include "jinclude.h"
 #include "jpeglib.h"
+#include "jsimd.h"
 
 
  /* Private subobject */
@@ -23,6 +24,12 @@ typedef struct {
     int* Cb_b_tab;		/* => table for Cb to B conversion */
     INT32* Cr_g_tab;		/* => table for Cr to G conversion */
     INT32* Cb_g_tab;		/* => table for Cb to G conversion */
+
+    /* Output pixel layout for the RGB colorspaces (see jutils.c) */
+    int rgb_red, rgb_green, rgb_blue, rgb_pixelsize;
+#ifdef JSIMD_X86
+    J_COLOR_SPACE simd_space;	/* JCS_EXT_ space with the same layout */
+#endif
 } my_color_deconverter;
 
 typedef my_color_deconverter* my_cconvert_ptr;
@@ -70,38 +77,47 @@ LOCAL(void)
 build_ycc_rgb_table(j_decompress_ptr cinfo)
 {
     my_cconvert_ptr cconvert = (my_cconvert_ptr)cinfo->cconvert;
+    struct jpeg_decomp_tables* tables = cinfo->tables;
     int i;
     INT32 x;
     SHIFT_TEMPS
 
-        cconvert->Cr_r_tab = (int*)
-        (*cinfo->mem->alloc_small) ((j_common_ptr)cinfo, JPOOL_IMAGE,
-            (MAXJSAMPLE + 1) * SIZEOF(int));
-    cconvert->Cb_b_tab = (int*)
-        (*cinfo->mem->alloc_small) ((j_common_ptr)cinfo, JPOOL_IMAGE,
-            (MAXJSAMPLE + 1) * SIZEOF(int));
-    cconvert->Cr_g_tab = (INT32*)
-        (*cinfo->mem->alloc_small) ((j_common_ptr)cinfo, JPOOL_IMAGE,
-            (MAXJSAMPLE + 1) * SIZEOF(INT32));
-    cconvert->Cb_g_tab = (INT32*)
-        (*cinfo->mem->alloc_small) ((j_common_ptr)cinfo, JPOOL_IMAGE,
-            (MAXJSAMPLE + 1) * SIZEOF(INT32));
-
-    for (i = 0, x = -CENTERJSAMPLE; i <= MAXJSAMPLE; i++, x++) {
-        /* i is the actual input pixel value, in the range 0..MAXJSAMPLE */
-        /* The Cb or Cr value we are thinking of is x = i - CENTERJSAMPLE */
-        /* Cr=>R value is nearest int to 1.40200 * x */
-        cconvert->Cr_r_tab[i] = (int)
-            RIGHT_SHIFT(FIX(1.40200) * x + ONE_HALF, SCALEBITS);
-        /* Cb=>B value is nearest int to 1.77200 * x */
-        cconvert->Cb_b_tab[i] = (int)
-            RIGHT_SHIFT(FIX(1.77200) * x + ONE_HALF, SCALEBITS);
-        /* Cr=>G value is scaled-up -0.71414 * x */
-        cconvert->Cr_g_tab[i] = (-FIX(0.71414)) * x;
-        /* Cb=>G value is scaled-up -0.34414 * x */
-        /* We also add in ONE_HALF so that need not do it in inner loop */
-        cconvert->Cb_g_tab[i] = (-FIX(0.34414)) * x + ONE_HALF;
+    /* The tables are constant, so they are built once per object */
+    if (tables->Cr_r_tab == NULL) {
+        tables->Cr_r_tab = (int*)
+            (*cinfo->mem->alloc_small) ((j_common_ptr)cinfo, JPOOL_PERMANENT,
+                (MAXJSAMPLE + 1) * SIZEOF(int));
+        tables->Cb_b_tab = (int*)
+            (*cinfo->mem->alloc_small) ((j_common_ptr)cinfo, JPOOL_PERMANENT,
+                (MAXJSAMPLE + 1) * SIZEOF(int));
+        tables->Cr_g_tab = (INT32*)
+            (*cinfo->mem->alloc_small) ((j_common_ptr)cinfo, JPOOL_PERMANENT,
+                (MAXJSAMPLE + 1) * SIZEOF(INT32));
+        tables->Cb_g_tab = (INT32*)
+            (*cinfo->mem->alloc_small) ((j_common_ptr)cinfo, JPOOL_PERMANENT,
+                (MAXJSAMPLE + 1) * SIZEOF(INT32));
+
+        for (i = 0, x = -CENTERJSAMPLE; i <= MAXJSAMPLE; i++, x++) {
+            /* i is the actual input pixel value, in the range 0..MAXJSAMPLE */
+            /* The Cb or Cr value we are thinking of is x = i - CENTERJSAMPLE */
+            /* Cr=>R value is nearest int to 1.40200 * x */
+            tables->Cr_r_tab[i] = (int)
+                RIGHT_SHIFT(FIX(1.40200) * x + ONE_HALF, SCALEBITS);
+            /* Cb=>B value is nearest int to 1.77200 * x */
+            tables->Cb_b_tab[i] = (int)
+                RIGHT_SHIFT(FIX(1.77200) * x + ONE_HALF, SCALEBITS);
+            /* Cr=>G value is scaled-up -0.71414 * x */
+            tables->Cr_g_tab[i] = (-FIX(0.71414)) * x;
+            /* Cb=>G value is scaled-up -0.34414 * x */
+            /* We also add in ONE_HALF so that need not do it in inner loop */
+            tables->Cb_g_tab[i] = (-FIX(0.34414)) * x + ONE_HALF;
+        }
     }
+
+    cconvert->Cr_r_tab = tables->Cr_r_tab;
+    cconvert->Cb_b_tab = tables->Cb_b_tab;
+    cconvert->Cr_g_tab = tables->Cr_g_tab;
+    cconvert->Cb_g_tab = tables->Cb_g_tab;
 }
 
 
@@ -157,6 +173,99 @@ ycc_rgb_convert(j_decompress_ptr cinfo,
 }
 
 
+/*
+ * The same for the JCS_EXT_ colorspaces, whose layout is known only at
+ * run time.  The extra sample of a 4-sample pixel is set to MAXJSAMPLE.
+ */
+
+METHODDEF(void)
+ycc_extrgb_convert(j_decompress_ptr cinfo,
+    JSAMPIMAGE input_buf, JDIMENSION input_row,
+    JSAMPARRAY output_buf, int num_rows)
+{
+    my_cconvert_ptr cconvert = (my_cconvert_ptr)cinfo->cconvert;
+    register int y, cb, cr;
+    register JSAMPROW outptr;
+    register JSAMPROW inptr0, inptr1, inptr2;
+    register JDIMENSION col;
+    JDIMENSION num_cols = cinfo->output_width;
+    int red = cconvert->rgb_red;
+    int green = cconvert->rgb_green;
+    int blue = cconvert->rgb_blue;
+    int pixelsize = cconvert->rgb_pixelsize;
+    int extra = 6 - red - green - blue;
+    /* copy these pointers into registers if possible */
+    register JSAMPLE* range_limit = cinfo->sample_range_limit;
+    register int* Crrtab = cconvert->Cr_r_tab;
+    register int* Cbbtab = cconvert->Cb_b_tab;
+    register INT32* Crgtab = cconvert->Cr_g_tab;
+    register INT32* Cbgtab = cconvert->Cb_g_tab;
+    SHIFT_TEMPS
+
+        while (--num_rows >= 0) {
+            inptr0 = input_buf[0][input_row];
+            inptr1 = input_buf[1][input_row];
+            inptr2 = input_buf[2][input_row];
+            input_row++;
+            outptr = *output_buf++;
+            for (col = 0; col < num_cols; col++) {
+                y = GETJSAMPLE(inptr0[col]);
+                cb = GETJSAMPLE(inptr1[col]);
+                cr = GETJSAMPLE(inptr2[col]);
+                outptr[red] = range_limit[y + Crrtab[cr]];
+                outptr[green] = range_limit[y +
+                    ((int)RIGHT_SHIFT(Cbgtab[cb] + Crgtab[cr],
+                        SCALEBITS))];
+                outptr[blue] = range_limit[y + Cbbtab[cb]];
+                if (pixelsize == 4)
+                    outptr[extra] = MAXJSAMPLE;
+                outptr += pixelsize;
+            }
+        }
+}
+
+
+#ifdef JSIMD_X86
+
+/*
+ * YCbCr->RGB conversion by the SIMD routine, for any layout it handles.
+ */
+
+METHODDEF(void)
+ycc_rgb_convert_simd(j_decompress_ptr cinfo,
+    JSAMPIMAGE input_buf, JDIMENSION input_row,
+    JSAMPARRAY output_buf, int num_rows)
+{
+    my_cconvert_ptr cconvert = (my_cconvert_ptr)cinfo->cconvert;
+
+    jpeg_ycc_rgb_convert_sse2(input_buf, input_row, output_buf, num_rows,
+        cinfo->output_width, cconvert->simd_space);
+}
+
+
+/*
+ * Find the JCS_EXT_ space with the pixel layout of the given RGB space,
+ * or JCS_UNKNOWN if there is none (a custom JCS_RGB layout, say).
+ */
+
+LOCAL(J_COLOR_SPACE)
+ext_rgb_space(J_COLOR_SPACE cs)
+{
+    int i;
+
+    for (i = (int)JCS_EXT_RGB; i <= (int)JCS_EXT_ARGB; i++) {
+        if (jpeg_rgb_red[i] == jpeg_rgb_red[cs] &&
+            jpeg_rgb_green[i] == jpeg_rgb_green[cs] &&
+            jpeg_rgb_blue[i] == jpeg_rgb_blue[cs] &&
+            jpeg_rgb_pixelsize[i] == jpeg_rgb_pixelsize[cs])
+            return (J_COLOR_SPACE)i;
+    }
+    return JCS_UNKNOWN;
+}
+
+#endif /* JSIMD_X86 */
+
+
 /**************** Cases other than YCbCr -> RGB **************/
 
 
@@ -234,6 +343,77 @@ gray_rgb_convert(j_decompress_ptr cinfo,
 }
 
 
+/*
+ * Grayscale to one of the JCS_EXT_ layouts.
+ */
+
+METHODDEF(void)
+gray_extrgb_convert(j_decompress_ptr cinfo,
+    JSAMPIMAGE input_buf, JDIMENSION input_row,
+    JSAMPARRAY output_buf, int num_rows)
+{
+    my_cconvert_ptr cconvert = (my_cconvert_ptr)cinfo->cconvert;
+    register JSAMPROW inptr, outptr;
+    register JDIMENSION col;
+    JDIMENSION num_cols = cinfo->output_width;
+    int red = cconvert->rgb_red;
+    int green = cconvert->rgb_green;
+    int blue = cconvert->rgb_blue;
+    int pixelsize = cconvert->rgb_pixelsize;
+    int extra = 6 - red - green - blue;
+
+    while (--num_rows >= 0) {
+        inptr = input_buf[0][input_row++];
+        outptr = *output_buf++;
+        for (col = 0; col < num_cols; col++) {
+            /* We can dispense with GETJSAMPLE() here */
+            outptr[red] = outptr[green] = outptr[blue] = inptr[col];
+            if (pixelsize == 4)
+                outptr[extra] = MAXJSAMPLE;
+            outptr += pixelsize;
+        }
+    }
+}
+
+
+/*
+ * RGB file to an RGB output layout other than plain R/G/B:
+ * just reorder the samples.
+ */
+
+METHODDEF(void)
+rgb_extrgb_convert(j_decompress_ptr cinfo,
+    JSAMPIMAGE input_buf, JDIMENSION input_row,
+    JSAMPARRAY output_buf, int num_rows)
+{
+    my_cconvert_ptr cconvert = (my_cconvert_ptr)cinfo->cconvert;
+    register JSAMPROW inptr0, inptr1, inptr2, outptr;
+    register JDIMENSION col;
+    JDIMENSION num_cols = cinfo->output_width;
+    int red = cconvert->rgb_red;
+    int green = cconvert->rgb_green;
+    int blue = cconvert->rgb_blue;
+    int pixelsize = cconvert->rgb_pixelsize;
+    int extra = 6 - red - green - blue;
+
+    while (--num_rows >= 0) {
+        inptr0 = input_buf[0][input_row];
+        inptr1 = input_buf[1][input_row];
+        inptr2 = input_buf[2][input_row];
+        input_row++;
+        outptr = *output_buf++;
+        for (col = 0; col < num_cols; col++) {
+            outptr[red] = inptr0[col];	/* don't need GETJSAMPLE here */
+            outptr[green] = inptr1[col];
+            outptr[blue] = inptr2[col];
+            if (pixelsize == 4)
+                outptr[extra] = MAXJSAMPLE;
+            outptr += pixelsize;
+        }
+    }
+}
+
+
 /*
  * Adobe-style YCCK->CMYK conversion.
  * We convert YCbCr to R=1-C, G=1-M, and B=1-Y using the same
@@ -357,16 +537,47 @@ jinit_color_deconverter(j_decompress_ptr cinfo)
         break;
 
     case JCS_RGB:
-        cinfo->out_color_components = RGB_PIXELSIZE;
+    case JCS_EXT_RGB:
+    case JCS_EXT_BGR:
+    case JCS_EXT_RGBX:
+    case JCS_EXT_RGBA:
+    case JCS_EXT_BGRA:
+    case JCS_EXT_ARGB:
+        /* JCS_RGB keeps the compile-time layout routines of the original
+         * code; the JCS_EXT_ spaces use the same algorithms with the
+         * layout looked up at run time.
+         */
+        cconvert->rgb_red = jpeg_rgb_red[cinfo->out_color_space];
+        cconvert->rgb_green = jpeg_rgb_green[cinfo->out_color_space];
+        cconvert->rgb_blue = jpeg_rgb_blue[cinfo->out_color_space];
+        cconvert->rgb_pixelsize = jpeg_rgb_pixelsize[cinfo->out_color_space];
+        cinfo->out_color_components = cconvert->rgb_pixelsize;
         if (cinfo->jpeg_color_space == JCS_YCbCr) {
-            cconvert->pub.color_convert = ycc_rgb_convert;
+            if (cinfo->out_color_space == JCS_RGB)
+                cconvert->pub.color_convert = ycc_rgb_convert;
+            else
+                cconvert->pub.color_convert = ycc_extrgb_convert;
             build_ycc_rgb_table(cinfo);
+#ifdef JSIMD_X86
+            if (jpeg_simd_support() & JSIMD_SSE2) {
+                cconvert->simd_space = ext_rgb_space(cinfo->out_color_space);
+                if (cconvert->simd_space != JCS_UNKNOWN)
+                    cconvert->pub.color_convert = ycc_rgb_convert_simd;
+            }
+#endif
         }
         else if (cinfo->jpeg_color_space == JCS_GRAYSCALE) {
-            cconvert->pub.color_convert = gray_rgb_convert;
+            if (cinfo->out_color_space == JCS_RGB)
+                cconvert->pub.color_convert = gray_rgb_convert;
+            else
+                cconvert->pub.color_convert = gray_extrgb_convert;
         }
-        else if (cinfo->jpeg_color_space == JCS_RGB && RGB_PIXELSIZE == 3) {
-            cconvert->pub.color_convert = null_convert;
+        else if (cinfo->jpeg_color_space == JCS_RGB) {
+            if (cconvert->rgb_red == 0 && cconvert->rgb_green == 1 &&
+                cconvert->rgb_blue == 2 && cconvert->rgb_pixelsize == 3)
+                cconvert->pub.color_convert = null_convert;
+            else
+                cconvert->pub.color_convert = rgb_extrgb_convert;
         }
         else
             ERREXIT(cinfo, JERR_CONVERSION_NOTIMPL);
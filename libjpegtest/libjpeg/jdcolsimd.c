@@ -0,0 +1,267 @@
+/*
+ * jdcolsimd.c
+ *
+ * Based on jdcolor.c.
+ *
+ * This file contains an SSE2 version of the YCbCr->RGB conversion in
+ * jdcolor.c, writing any of the JCS_EXT_ pixel layouts.  The results are
+ * exactly those of the table-driven C code.
+ *
+ * jdcolor.c's tables hold round(c * x) for x = Cb or Cr less CENTERJSAMPLE,
+ * with c scaled by 2^16.  Each constant c is split into an integral part k
+ * and a remainder c - k*2^16 that fits in 16 bits, so that
+ *	(c * x + ONE_HALF) >> 16  =  k * x + (((c - k*2^16) * x + ONE_HALF) >> 16)
+ * holds exactly; pmaddwd forms the remainder products of Cb and Cr
+ * together, as jdcolor.c sums the two G terms before rounding:
+ *	R = Y + Cr + (( 26345 * Cr                + ONE_HALF) >> 16)
+ *	G = Y - Cr + ((-22554 * Cb + 18734 * Cr   + ONE_HALF) >> 16)
+ *	B = Y + 2*Cb + ((-14942 * Cb              + ONE_HALF) >> 16)
+ * packuswb then clamps to 0..MAXJSAMPLE just as range_limit does.
+ */
+
+#define JPEG_INTERNALS
+#include "jinclude.h"
+#include "jpeglib.h"
+#include "jsimd.h"
+
+#ifdef JSIMD_X86
+
+#include <emmintrin.h>
+
+
+/*
+ * This module is specialized to the case of 8-bit samples.
+ */
+
+#if BITS_IN_JSAMPLE != 8
+Sorry, this code only copes with 8-bit samples. /* deliberate syntax err */
+#endif
+
+
+#define SCALEBITS	16
+#define ONE_HALF	((INT32) 1 << (SCALEBITS-1))
+
+/* The remainders of FIX(1.40200), -FIX(0.34414), -FIX(0.71414) and
+ * FIX(1.77200) (91881, -22554, -46802, 116130) after taking out
+ * 1, 0, -1 and 2 times 2^16 respectively.
+ */
+#define CR_R_REM	26345
+#define CB_G_REM	(-22554)
+#define CR_G_REM	18734
+#define CB_B_REM	(-14942)
+
+#define PIXELS_PER_ITER	16
+
+
+/*
+ * Compute (pmaddwd(pairs, k) + ONE_HALF) >> SCALEBITS for eight pixels,
+ * whose (Cb, Cr) pairs are split over lo and hi, as 16-bit values.
+ */
+
+JSIMD_INLINE JSIMD_TARGET_SSE2
+LOCAL(__m128i)
+descale_pairs_sse2(__m128i lo, __m128i hi, __m128i k)
+{
+    __m128i half = _mm_set1_epi32(ONE_HALF);
+
+    lo = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(lo, k), half), SCALEBITS);
+    hi = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(hi, k), half), SCALEBITS);
+    return _mm_packs_epi32(lo, hi);
+}
+
+
+/*
+ * Convert eight pixels held as 16-bit values; the results come back in
+ * the 16-bit lanes of *r, *g and *b, not yet clamped.
+ */
+
+JSIMD_INLINE JSIMD_TARGET_SSE2
+LOCAL(void)
+ycc_rgb_8_sse2(__m128i y, __m128i cb, __m128i cr,
+    __m128i* r, __m128i* g, __m128i* b)
+{
+    __m128i center = _mm_set1_epi16(CENTERJSAMPLE);
+    __m128i lo, hi;
+
+    cb = _mm_sub_epi16(cb, center);
+    cr = _mm_sub_epi16(cr, center);
+    lo = _mm_unpacklo_epi16(cb, cr);
+    hi = _mm_unpackhi_epi16(cb, cr);
+
+    *r = _mm_add_epi16(_mm_add_epi16(y, cr),
+        descale_pairs_sse2(lo, hi, _mm_set1_epi32(PAIR(0, CR_R_REM))));
+    *g = _mm_add_epi16(_mm_sub_epi16(y, cr),
+        descale_pairs_sse2(lo, hi, _mm_set1_epi32(PAIR(CB_G_REM, CR_G_REM))));
+    *b = _mm_add_epi16(_mm_add_epi16(y, _mm_add_epi16(cb, cb)),
+        descale_pairs_sse2(lo, hi, _mm_set1_epi32(PAIR(CB_B_REM, 0))));
+}
+
+
+/*
+ * Squeeze four 4-byte pixels whose last byte is zero into the low 12 bytes.
+ */
+
+JSIMD_INLINE JSIMD_TARGET_SSE2
+LOCAL(__m128i)
+pack_pixels_3_sse2(__m128i v)
+{
+    /* Within each 64-bit half, move the second pixel down over the zero */
+    v = _mm_or_si128(
+        _mm_and_si128(v, _mm_set_epi32(0, 0x00FFFFFF, 0, 0x00FFFFFF)),
+        _mm_and_si128(_mm_srli_epi64(v, 8),
+            _mm_set_epi32(0x0000FFFF, (int)0xFF000000,
+                0x0000FFFF, (int)0xFF000000)));
+    /* Then move the upper six bytes down against the lower six */
+    return _mm_or_si128(_mm_move_epi64(v),
+        _mm_slli_si128(_mm_srli_si128(v, 8), 6));
+}
+
+
+/*
+ * Convert PIXELS_PER_ITER pixels and store them in the given layout.
+ * The layout arguments are constants in every caller, so the shuffling
+ * compiles down to the instructions for just that layout.
+ */
+
+JSIMD_INLINE JSIMD_TARGET_SSE2
+LOCAL(void)
+ycc_rgb_16_sse2(JSAMPROW inptr0, JSAMPROW inptr1, JSAMPROW inptr2,
+    JSAMPROW outptr, int red, int green, int blue, int pixelsize)
+{
+    __m128i zero = _mm_setzero_si128();
+    __m128i y, cb, cr, rlo, rhi, glo, ghi, blo, bhi;
+    __m128i c[4], t[4];
+
+    y = _mm_loadu_si128((const __m128i*) inptr0);
+    cb = _mm_loadu_si128((const __m128i*) inptr1);
+    cr = _mm_loadu_si128((const __m128i*) inptr2);
+
+    ycc_rgb_8_sse2(_mm_unpacklo_epi8(y, zero), _mm_unpacklo_epi8(cb, zero),
+        _mm_unpacklo_epi8(cr, zero), &rlo, &glo, &blo);
+    ycc_rgb_8_sse2(_mm_unpackhi_epi8(y, zero), _mm_unpackhi_epi8(cb, zero),
+        _mm_unpackhi_epi8(cr, zero), &rhi, &ghi, &bhi);
+
+    /* Gather the planes in output order, padding 3-byte pixels with a
+     * zero byte or filling the extra sample of 4-byte ones.
+     */
+    c[red] = _mm_packus_epi16(rlo, rhi);
+    c[green] = _mm_packus_epi16(glo, ghi);
+    c[blue] = _mm_packus_epi16(blo, bhi);
+    if (pixelsize == 3)
+        c[3] = zero;
+    else
+        c[6 - red - green - blue] = _mm_set1_epi8((char)MAXJSAMPLE);
+
+    /* Interleave: t[] holds pixels 0-3, 4-7, 8-11, 12-15 */
+    t[0] = _mm_unpacklo_epi8(c[0], c[1]);
+    t[1] = _mm_unpackhi_epi8(c[0], c[1]);
+    t[2] = _mm_unpacklo_epi8(c[2], c[3]);
+    t[3] = _mm_unpackhi_epi8(c[2], c[3]);
+    c[0] = _mm_unpacklo_epi16(t[0], t[2]);
+    c[1] = _mm_unpackhi_epi16(t[0], t[2]);
+    c[2] = _mm_unpacklo_epi16(t[1], t[3]);
+    c[3] = _mm_unpackhi_epi16(t[1], t[3]);
+
+    if (pixelsize == 3) {
+        c[0] = pack_pixels_3_sse2(c[0]);
+        c[1] = pack_pixels_3_sse2(c[1]);
+        c[2] = pack_pixels_3_sse2(c[2]);
+        c[3] = pack_pixels_3_sse2(c[3]);
+        _mm_storeu_si128((__m128i*) outptr,
+            _mm_or_si128(c[0], _mm_slli_si128(c[1], 12)));
+        _mm_storeu_si128((__m128i*) (outptr + 16),
+            _mm_or_si128(_mm_srli_si128(c[1], 4), _mm_slli_si128(c[2], 8)));
+        _mm_storeu_si128((__m128i*) (outptr + 32),
+            _mm_or_si128(_mm_srli_si128(c[2], 8), _mm_slli_si128(c[3], 4)));
+    }
+    else {
+        _mm_storeu_si128((__m128i*) outptr, c[0]);
+        _mm_storeu_si128((__m128i*) (outptr + 16), c[1]);
+        _mm_storeu_si128((__m128i*) (outptr + 32), c[2]);
+        _mm_storeu_si128((__m128i*) (outptr + 48), c[3]);
+    }
+}
+
+
+/*
+ * Convert some rows in one layout.  The last few pixels of a row go
+ * through scratch buffers, so that nothing is read or written past the
+ * row ends.
+ */
+
+JSIMD_INLINE JSIMD_TARGET_SSE2
+LOCAL(void)
+ycc_rgb_rows_sse2(JSAMPIMAGE input_buf, JDIMENSION input_row,
+    JSAMPARRAY output_buf, int num_rows, JDIMENSION num_cols,
+    int red, int green, int blue, int pixelsize)
+{
+    JSAMPLE intemp[3][PIXELS_PER_ITER];
+    JSAMPLE outtemp[PIXELS_PER_ITER * 4];
+    JSAMPROW inptr0, inptr1, inptr2, outptr;
+    JDIMENSION col;
+
+    while (--num_rows >= 0) {
+        inptr0 = input_buf[0][input_row];
+        inptr1 = input_buf[1][input_row];
+        inptr2 = input_buf[2][input_row];
+        input_row++;
+        outptr = *output_buf++;
+        for (col = num_cols; col >= PIXELS_PER_ITER; col -= PIXELS_PER_ITER) {
+            ycc_rgb_16_sse2(inptr0, inptr1, inptr2, outptr,
+                red, green, blue, pixelsize);
+            inptr0 += PIXELS_PER_ITER;
+            inptr1 += PIXELS_PER_ITER;
+            inptr2 += PIXELS_PER_ITER;
+            outptr += PIXELS_PER_ITER * pixelsize;
+        }
+        if (col > 0) {
+            MEMCOPY(intemp[0], inptr0, col * SIZEOF(JSAMPLE));
+            MEMCOPY(intemp[1], inptr1, col * SIZEOF(JSAMPLE));
+            MEMCOPY(intemp[2], inptr2, col * SIZEOF(JSAMPLE));
+            ycc_rgb_16_sse2(intemp[0], intemp[1], intemp[2], outtemp,
+                red, green, blue, pixelsize);
+            MEMCOPY(outptr, outtemp, col * pixelsize * SIZEOF(JSAMPLE));
+        }
+    }
+}
+
+
+/*
+ * YCbCr->RGB conversion of num_rows rows, as ycc_rgb_convert in jdcolor.c,
+ * into the pixel layout of out_color_space, which must be a JCS_EXT_ space.
+ */
+
+JSIMD_TARGET_SSE2
+GLOBAL(void)
+jpeg_ycc_rgb_convert_sse2(JSAMPIMAGE input_buf, JDIMENSION input_row,
+    JSAMPARRAY output_buf, int num_rows, JDIMENSION num_cols,
+    J_COLOR_SPACE out_color_space)
+{
+    switch (out_color_space) {
+    case JCS_EXT_RGB:
+        ycc_rgb_rows_sse2(input_buf, input_row, output_buf, num_rows,
+            num_cols, 0, 1, 2, 3);
+        break;
+    case JCS_EXT_BGR:
+        ycc_rgb_rows_sse2(input_buf, input_row, output_buf, num_rows,
+            num_cols, 2, 1, 0, 3);
+        break;
+    case JCS_EXT_RGBX:
+    case JCS_EXT_RGBA:
+        ycc_rgb_rows_sse2(input_buf, input_row, output_buf, num_rows,
+            num_cols, 0, 1, 2, 4);
+        break;
+    case JCS_EXT_BGRA:
+        ycc_rgb_rows_sse2(input_buf, input_row, output_buf, num_rows,
+            num_cols, 2, 1, 0, 4);
+        break;
+    case JCS_EXT_ARGB:
+        ycc_rgb_rows_sse2(input_buf, input_row, output_buf, num_rows,
+            num_cols, 1, 2, 3, 4);
+        break;
+    default:
+        break;
+    }
+}
+
+#endif /* JSIMD_X86 */
@@ -19,6 +19,7 @@
 #include "jinclude.h"
 #include "jpeglib.h"
 #include "jdct.h"		/* Private declarations for DCT subsystem */
+#include "jsimd.h"
 
 
  /*
@@ -64,6 +65,12 @@ typedef union {
 #ifdef DCT_FLOAT_SUPPORTED
     FLOAT_MULT_TYPE float_array[DCTSIZE2];
 #endif
+#ifdef JSIMD_X86
+    struct {
+        ISLOW_MULT_TYPE islow_array[DCTSIZE2];
+        INT16 simd_array[DCTSIZE2];	/* see ISLOW_SIMD_TABLE */
+    } islow_simd;
+#endif
 } multiplier_table;
 
 
@@ -79,6 +86,31 @@ typedef union {
 #endif
 
 
+#ifdef JSIMD_X86
+
+/*
+ * The SIMD IDCT routines multiply in 16 bits, so they can only be used
+ * with multipliers up to 32767 (16-bit quantization tables allow more).
+ */
+
+LOCAL(bool)
+use_simd_idct(jpeg_component_info* compptr)
+{
+    JQUANT_TBL* qtbl = compptr->quant_table;
+    int i;
+
+    if (qtbl != NULL) {		/* no table yet leaves the multipliers zero */
+        for (i = 0; i < DCTSIZE2; i++) {
+            if (qtbl->quantval[i] > 32767)
+                return false;
+        }
+    }
+    return true;
+}
+
+#endif
+
+
  /*
   * Prepare for an output pass.
   * Here we select the proper IDCT routine for each component and build
@@ -93,11 +125,13 @@ start_pass(j_decompress_ptr cinfo)
     jpeg_component_info* compptr;
     int method = 0;
     inverse_DCT_method_ptr method_ptr = NULL;
+    inverse_DCT_method_ptr dc_ptr, sparse2_ptr, sparse4_ptr;
     JQUANT_TBL* qtbl;
 
     for (ci = 0, compptr = cinfo->comp_info; ci < cinfo->num_components;
         ci++, compptr++) {
         /* Select the proper IDCT routine for this component's scaling */
+        dc_ptr = sparse2_ptr = sparse4_ptr = NULL; /* no sparse variants */
         switch (compptr->DCT_scaled_size) {
 #ifdef IDCT_SCALING_SUPPORTED
         case 1:
@@ -106,10 +140,39 @@ start_pass(j_decompress_ptr cinfo)
             break;
         case 2:
             method_ptr = jpeg_idct_2x2;
+            dc_ptr = jpeg_idct_NxN_dc;
+            method = JDCT_ISLOW;	/* jidctred uses islow-style table */
+            break;
+        case 3:
+            method_ptr = jpeg_idct_3x3;
+            dc_ptr = jpeg_idct_NxN_dc;
+            sparse2_ptr = jpeg_idct_NxN_sparse2;
             method = JDCT_ISLOW;	/* jidctred uses islow-style table */
             break;
         case 4:
             method_ptr = jpeg_idct_4x4;
+            dc_ptr = jpeg_idct_NxN_dc;
+            method = JDCT_ISLOW;	/* jidctred uses islow-style table */
+            break;
+        case 5:
+            method_ptr = jpeg_idct_5x5;
+            dc_ptr = jpeg_idct_NxN_dc;
+            sparse2_ptr = jpeg_idct_NxN_sparse2;
+            sparse4_ptr = jpeg_idct_NxN_sparse4;
+            method = JDCT_ISLOW;	/* jidctred uses islow-style table */
+            break;
+        case 6:
+            method_ptr = jpeg_idct_6x6;
+            dc_ptr = jpeg_idct_NxN_dc;
+            sparse2_ptr = jpeg_idct_NxN_sparse2;
+            sparse4_ptr = jpeg_idct_NxN_sparse4;
+            method = JDCT_ISLOW;	/* jidctred uses islow-style table */
+            break;
+        case 7:
+            method_ptr = jpeg_idct_7x7;
+            dc_ptr = jpeg_idct_NxN_dc;
+            sparse2_ptr = jpeg_idct_NxN_sparse2;
+            sparse4_ptr = jpeg_idct_NxN_sparse4;
             method = JDCT_ISLOW;	/* jidctred uses islow-style table */
             break;
 #endif
@@ -118,18 +181,36 @@ start_pass(j_decompress_ptr cinfo)
 #ifdef DCT_ISLOW_SUPPORTED
             case JDCT_ISLOW:
                 method_ptr = jpeg_idct_islow;
+                dc_ptr = jpeg_idct_islow_dc;
+                sparse2_ptr = jpeg_idct_islow_sparse2;
+                sparse4_ptr = jpeg_idct_islow_sparse4;
+#ifdef JSIMD_X86
+                if (use_simd_idct(compptr)) {
+                    if (jpeg_simd_support() & JSIMD_AVX2)
+                        method_ptr = jpeg_idct_islow_avx2;
+                    else if (jpeg_simd_support() & JSIMD_SSE2)
+                        method_ptr = jpeg_idct_islow_sse2;
+                    /* A full SIMD IDCT is faster than the 4x4 variant;
+                     * the DC-only and 2x2 ones still pay off.
+                     */
+                    if (method_ptr != jpeg_idct_islow)
+                        sparse4_ptr = NULL;
+                }
+#endif
                 method = JDCT_ISLOW;
                 break;
 #endif
 #ifdef DCT_IFAST_SUPPORTED
             case JDCT_IFAST:
                 method_ptr = jpeg_idct_ifast;
+                dc_ptr = jpeg_idct_ifast_dc;
                 method = JDCT_IFAST;
                 break;
 #endif
 #ifdef DCT_FLOAT_SUPPORTED
             case JDCT_FLOAT:
                 method_ptr = jpeg_idct_float;
+                dc_ptr = jpeg_idct_float_dc;
                 method = JDCT_FLOAT;
                 break;
 #endif
@@ -143,6 +224,19 @@ start_pass(j_decompress_ptr cinfo)
             break;
         }
         idct->pub.inverse_DCT[ci] = method_ptr;
+        /* Routines for sparse blocks; any not provided falls back to the
+         * routine for the next denser class.
+         */
+        idct->pub.inverse_DCT_sparse[ci][IDCT_FULL] = method_ptr;
+        if (sparse4_ptr == NULL)
+            sparse4_ptr = method_ptr;
+        idct->pub.inverse_DCT_sparse[ci][IDCT_SPARSE_4x4] = sparse4_ptr;
+        if (sparse2_ptr == NULL)
+            sparse2_ptr = sparse4_ptr;
+        idct->pub.inverse_DCT_sparse[ci][IDCT_SPARSE_2x2] = sparse2_ptr;
+        if (dc_ptr == NULL)
+            dc_ptr = sparse2_ptr;
+        idct->pub.inverse_DCT_sparse[ci][IDCT_DC_ONLY] = dc_ptr;
         /* Create multiplier table from quant table.
          * However, we can skip this if the component is uninteresting
          * or if we already built the table.  Also, if no quant table
@@ -167,6 +261,14 @@ start_pass(j_decompress_ptr cinfo)
             for (i = 0; i < DCTSIZE2; i++) {
                 ismtbl[i] = (ISLOW_MULT_TYPE)qtbl->quantval[i];
             }
+#ifdef JSIMD_X86
+            {
+                INT16* simdtbl = ISLOW_SIMD_TABLE(compptr);
+                for (i = 0; i < DCTSIZE2; i++) {
+                    simdtbl[i] = (INT16)qtbl->quantval[i];
+                }
+            }
+#endif
         }
         break;
 #endif
@@ -78,6 +78,62 @@ typedef struct {
 typedef huff_entropy_decoder* huff_entropy_ptr;
 
 
+/*
+ * Build the skip table of an AC derived table (see jdhuff.h), if it isn't
+ * built already.  Each entry is found by decoding codes from its index
+ * bits just as jpeg_huff_decode would, stopping at an EOB, at a code or
+ * magnitude that runs past the end of the index, or once the advance
+ * reaches the end of any block.
+ */
+
+LOCAL(void)
+make_skip_tbl(j_decompress_ptr cinfo, d_derived_tbl* dtbl)
+{
+    int lookbits, pos, l, sym, size, advance, eob;
+    INT32 code;
+
+    if (dtbl->skip_valid)
+        return;
+    if (dtbl->look_skip == NULL)
+        dtbl->look_skip = (UINT16*)
+            (*cinfo->mem->alloc_small) ((j_common_ptr)cinfo, JPOOL_PERMANENT,
+                (1 << HUFF_SKIP_LOOKAHEAD) * SIZEOF(UINT16));
+
+    for (lookbits = 0; lookbits < (1 << HUFF_SKIP_LOOKAHEAD); lookbits++) {
+        pos = 0;			/* bits used by the codes taken so far */
+        advance = 0;
+        eob = 0;
+        while (advance < DCTSIZE2) {
+            /* Figure F.16: decode one code starting pos bits in */
+            code = 0;
+            for (l = 1; pos + l <= HUFF_SKIP_LOOKAHEAD; l++) {
+                code = (code << 1) |
+                    ((lookbits >> (HUFF_SKIP_LOOKAHEAD - pos - l)) & 1);
+                if (code <= dtbl->maxcode[l])
+                    break;
+            }
+            if (pos + l > HUFF_SKIP_LOOKAHEAD)
+                break;			/* code doesn't fit */
+            sym = dtbl->pub->huffval[(int)(code + dtbl->valoffset[l])];
+            size = sym & 15;
+            if (pos + l + size > HUFF_SKIP_LOOKAHEAD)
+                break;			/* magnitude bits don't fit */
+            pos += l + size;
+            if (size == 0 && (sym >> 4) != 15) {
+                advance += 1;		/* EOB */
+                eob = 1;
+                break;
+            }
+            advance += (sym >> 4) + 1;	/* ZRL advances 16 */
+        }
+        dtbl->look_skip[lookbits] = (UINT16)
+            (pos == 0 ? 0 : (eob << 15) | (advance << 8) | pos);
+    }
+
+    dtbl->skip_valid = true;
+}
+
+
 /*
  * Initialize for a Huffman-compressed scan.
  */
@@ -127,6 +183,9 @@ start_pass_huff_decoder(j_decompress_ptr cinfo)
         else {
             entropy->dc_needed[blkn] = entropy->ac_needed[blkn] = false;
         }
+        /* The ACs must still be parsed; skip them several codes at a time */
+        if (!entropy->ac_needed[blkn])
+            make_skip_tbl(cinfo, entropy->ac_cur_tbls[blkn]);
     }
 
     /* Initialize bitread state variables */
@@ -139,6 +198,82 @@ start_pass_huff_decoder(j_decompress_ptr cinfo)
 }
 
 
+/*
+ * Get the derived table cache, creating it on first use.
+ */
+
+LOCAL(struct d_huff_cache*)
+get_huff_cache(j_decompress_ptr cinfo)
+{
+    struct d_huff_cache* cache = cinfo->tables->huff_cache;
+
+    if (cache == NULL) {
+        cache = (struct d_huff_cache*)
+            (*cinfo->mem->alloc_small) ((j_common_ptr)cinfo, JPOOL_PERMANENT,
+                SIZEOF(struct d_huff_cache));
+        MEMZERO(cache, SIZEOF(struct d_huff_cache));
+        cinfo->tables->huff_cache = cache;
+    }
+    return cache;
+}
+
+
+/*
+ * Get the workspace of a derived table slot, allocating it on first use.
+ */
+
+LOCAL(d_derived_tbl*)
+get_derived_tbl(j_decompress_ptr cinfo, struct d_huff_cache* cache,
+    int tblclass, int tblno)
+{
+    if (cache->dtbl[tblclass][tblno] == NULL) {
+        cache->dtbl[tblclass][tblno] = (d_derived_tbl*)
+            (*cinfo->mem->alloc_small) ((j_common_ptr)cinfo, JPOOL_PERMANENT,
+                SIZEOF(d_derived_tbl));
+        cache->dtbl[tblclass][tblno]->look_skip = NULL;
+    }
+    return cache->dtbl[tblclass][tblno];
+}
+
+
+/*
+ * Allocate, at module initialization, the derived table workspaces that
+ * the scans of this image are expected to use, so that they are part of
+ * the setup measured by jpeg_calc_mem_peak rather than appearing later in
+ * the middle of a multi-scan file.  We cannot see the tables of later
+ * scans yet, but encoders redefine the slots they used earlier (a
+ * progressive file typically defines only its DC tables before the first
+ * scan and reuses those slot numbers for AC), so both classes are
+ * allocated for every slot that has a table of either class.  The skip
+ * table is allocated too if some component's ACs will be discarded.
+ *
+ * Note this is also used by jdphuff.c.
+ */
+
+GLOBAL(void)
+jpeg_alloc_d_derived_tbls(j_decompress_ptr cinfo, bool need_skip)
+{
+    struct d_huff_cache* cache;
+    d_derived_tbl* dtbl;
+    int tblno;
+
+    for (tblno = 0; tblno < NUM_HUFF_TBLS; tblno++) {
+        if (cinfo->dc_huff_tbl_ptrs[tblno] == NULL &&
+            cinfo->ac_huff_tbl_ptrs[tblno] == NULL)
+            continue;
+        cache = get_huff_cache(cinfo);
+        (void)get_derived_tbl(cinfo, cache, 1, tblno);
+        dtbl = get_derived_tbl(cinfo, cache, 0, tblno);
+        if (need_skip && dtbl->look_skip == NULL) {
+            dtbl->look_skip = (UINT16*)
+                (*cinfo->mem->alloc_small) ((j_common_ptr)cinfo, JPOOL_PERMANENT,
+                    (1 << HUFF_SKIP_LOOKAHEAD) * SIZEOF(UINT16));
+            dtbl->skip_valid = false;
+        }
+    }
+}
+
+
 /*
  * Compute the derived values for a Huffman table.
  * This routine also performs some validation checks on the table.
@@ -152,6 +287,9 @@ jpeg_make_d_derived_tbl(j_decompress_ptr cinfo, bool isDC, int tblno,
 {
     JHUFF_TBL* htbl;
     d_derived_tbl* dtbl;
+    struct d_huff_cache* cache;
+    JHUFF_TBL* source;
+    int tblclass = isDC ? 1 : 0;
     int p, i, l, si, numsymbols;
     int lookbits, ctr;
     char huffsize[257];
@@ -170,13 +308,26 @@ jpeg_make_d_derived_tbl(j_decompress_ptr cinfo, bool isDC, int tblno,
     if (htbl == NULL)
         ERREXIT1(cinfo, JERR_NO_HUFF_TABLE, tblno);
 
+    /* Reuse the table built for an earlier scan or image if its definition
+     * hasn't changed since; otherwise (re)build it in the cache.
+     */
+    cache = get_huff_cache(cinfo);
+    source = &cache->source[tblclass][tblno];
+    if (cache->valid[tblclass][tblno] &&
+        MEMEQUAL(source->bits, htbl->bits, SIZEOF(htbl->bits)) &&
+        MEMEQUAL(source->huffval, htbl->huffval, SIZEOF(htbl->huffval))) {
+        dtbl = cache->dtbl[tblclass][tblno];
+        dtbl->pub = htbl;		/* fill in back link */
+        *pdtbl = dtbl;
+        return;
+    }
+    cache->valid[tblclass][tblno] = false; /* in case of error exit below */
+
     /* Allocate a workspace if we haven't already done so. */
-    if (*pdtbl == NULL)
-        *pdtbl = (d_derived_tbl*)
-        (*cinfo->mem->alloc_small) ((j_common_ptr)cinfo, JPOOL_IMAGE,
-            SIZEOF(d_derived_tbl));
-    dtbl = *pdtbl;
+    dtbl = get_derived_tbl(cinfo, cache, tblclass, tblno);
+    *pdtbl = dtbl;
     dtbl->pub = htbl;		/* fill in back link */
+    dtbl->skip_valid = false;	/* rebuilt on demand, see make_skip_tbl */
 
     /* Figure C.1: make table of Huffman code length for each symbol */
 
@@ -265,6 +416,43 @@ jpeg_make_d_derived_tbl(j_decompress_ptr cinfo, bool isDC, int tblno,
                 ERREXIT(cinfo, JERR_BAD_HUFF_TABLE);
         }
     }
+
+    /* Compute the combined lookahead table.
+     * For each code of length l whose magnitude category s (a DC symbol,
+     * or the low four bits of an AC symbol) satisfies
+     * l + s <= HUFF_VAL_LOOKAHEAD, fill in all the entries starting with
+     * that code: the s bits that follow give the value, sign-extended as in
+     * Figure F.12, and the high four bits of an AC symbol give the zero run
+     * before it.  Entries for EOB, ZRL and longer codes are left 0.
+     */
+    MEMZERO(dtbl->look_val, SIZEOF(dtbl->look_val));
+
+    p = 0;
+    for (l = 1; l <= HUFF_VAL_LOOKAHEAD; l++) {
+        for (i = 1; i <= (int)htbl->bits[l]; i++, p++) {
+            int sym = htbl->huffval[p];
+            int run = isDC ? 0 : (sym >> 4);
+            int size = isDC ? sym : (sym & 15);
+            int extra = HUFF_VAL_LOOKAHEAD - l - size;
+            if ((size == 0 && !isDC) || extra < 0)
+                continue;
+            lookbits = huffcode[p] << (HUFF_VAL_LOOKAHEAD - l);
+            for (ctr = 0; ctr < (1 << (HUFF_VAL_LOOKAHEAD - l)); ctr++) {
+                int val = ctr >> extra;	/* the size bits after the code */
+                if (size == 0)
+                    val = 0;
+                else if (val < (1 << (size - 1)))
+                    val -= (1 << size) - 1;
+                dtbl->look_val[lookbits + ctr] =
+                    (INT32)val * 65536 + (run << 8) + (l + size);
+            }
+        }
+    }
+
+    /* Remember what the cached table was built from */
+    MEMCOPY(source->bits, htbl->bits, SIZEOF(htbl->bits));
+    MEMCOPY(source->huffval, htbl->huffval, SIZEOF(htbl->huffval));
+    cache->valid[tblclass][tblno] = true;
 }
 
 
@@ -274,9 +462,8 @@ jpeg_make_d_derived_tbl(j_decompress_ptr cinfo, bool isDC, int tblno,
  * Note: current values of get_buffer and bits_left are passed as parameters,
  * but are returned in the corresponding fields of the state struct.
  *
- * On most machines MIN_GET_BITS should be 25 to allow the full 32-bit width
- * of get_buffer to be used.  (On machines with wider words, an even larger
- * buffer could be used.)  However, on some machines 32-bit shifts are
+ * On most machines MIN_GET_BITS should be BIT_BUF_SIZE-7 to allow the full
+ * width of get_buffer to be used.  However, on some machines long shifts are
  * quite slow and take time proportional to the number of places shifted.
  * (This is true with most PC compilers, for instance.)  In this case it may
  * be a win to set MIN_GET_BITS to the minimum value of 15.  This reduces the
@@ -289,6 +476,19 @@ jpeg_make_d_derived_tbl(j_decompress_ptr cinfo, bool isDC, int tblno,
 #define MIN_GET_BITS  (BIT_BUF_SIZE-7)
 #endif
 
+/* Load four bytes as a big-endian word */
+#define GET_4BYTES(ptr) \
+	(((bit_buf_type) GETJOCTET((ptr)[0]) << 24) | \
+	 ((bit_buf_type) GETJOCTET((ptr)[1]) << 16) | \
+	 ((bit_buf_type) GETJOCTET((ptr)[2]) << 8) | \
+	  (bit_buf_type) GETJOCTET((ptr)[3]))
+
+/* Nonzero if any byte of a GET_4BYTES word is 0xFF
+ * (the word XOR 0xFFFFFFFF then has a zero byte).
+ */
+#define HAS_FF_BYTE(word) \
+	((((word) ^ 0xFFFFFFFF) - 0x01010101) & (word) & 0x80808080)
+
 
 GLOBAL(bool)
 jpeg_fill_bit_buffer(bitread_working_state* state,
@@ -309,6 +509,20 @@ jpeg_fill_bit_buffer(bitread_working_state* state,
         while (bits_left < MIN_GET_BITS) {
             register int c;
 
+            /* If four whole bytes fit and none of them is 0xFF, there can be
+             * neither a stuffed zero nor a marker among them: load all four.
+             */
+            if (bits_left <= BIT_BUF_SIZE - 32 && bytes_in_buffer >= 4) {
+                register bit_buf_type word = GET_4BYTES(next_input_byte);
+                if (!HAS_FF_BYTE(word)) {
+                    next_input_byte += 4;
+                    bytes_in_buffer -= 4;
+                    get_buffer = (get_buffer << 32) | word;
+                    bits_left += 32;
+                    continue;
+                }
+            }
+
             /* Attempt to read a byte */
             if (bytes_in_buffer == 0) {
                 if (!(*cinfo->src->fill_input_buffer) (cinfo))
@@ -502,6 +716,230 @@ process_restart(j_decompress_ptr cinfo)
 }
 
 
+/*
+ * Fast path for decode_mcu.
+ *
+ * When the source buffer holds enough bytes for a whole block, the bit
+ * buffer can be refilled in-line without ever calling the data source or
+ * checking for suspension.  FILL_BIT_BUFFER_FAST tops get_buffer up to at
+ * least 32 bits, which covers the longest Huffman code (16 bits, or 17 with
+ * corrupt data) plus its magnitude bits, so no other checks are needed
+ * between refills.  Four bytes are loaded at a time when none of them is
+ * 0xFF; otherwise they are taken one at a time, removing stuffed zeros.
+ * A marker is never passed: zero bits are supplied in its place and
+ * decode_mcu_fast gives up.  FF fill bytes before a marker or a stuffed
+ * zero are left alone the same way, since skipping them could overrun the
+ * per-block byte budget below.  On giving up, decode_mcu_fast re-zeroes
+ * the blocks it has written, so the careful path starts the MCU over from
+ * the state the caller provided: it stores only nonzero coefficients and
+ * would otherwise keep values decoded from the zero padding.  It then
+ * deals with the marker (or skips the fill bytes) as jpeg_fill_bit_buffer
+ * always does.
+ *
+ * Each block consumes at most 64 codes of 17+15 bits, all possibly
+ * stuffed, plus the bits left over from the last refill.
+ */
+
+#define FAST_BYTES_PER_BLOCK  (DCTSIZE2 * 32 / 8 * 2 + 16)
+
+#define FILL_BIT_BUFFER_FAST \
+	{ if (bits_left < 32) { \
+	    register bit_buf_type word = GET_4BYTES(buffer); \
+	    if (!HAS_FF_BYTE(word)) { \
+	      buffer += 4; \
+	    } else { \
+	      register int c, n; \
+	      for (word = 0, n = 4; n > 0; n--) { \
+	        c = GETJOCTET(*buffer++); \
+	        if (c == 0xFF) { \
+	          if (GETJOCTET(*buffer) == 0) \
+	            buffer++;		/* FF/00 is an FF data byte */ \
+	          else { \
+	            buffer--;		/* stay on the marker or fill byte */ \
+	            c = 0; \
+	            hit_marker = true; \
+	          } \
+	        } \
+	        word = (word << 8) | (bit_buf_type) c; \
+	      } \
+	    } \
+	    get_buffer = (get_buffer << 32) | word; \
+	    bits_left += 32; } }
+
+#define HUFF_DECODE_FAST(result,htbl,failaction) \
+{ register int nb, look; \
+  FILL_BIT_BUFFER_FAST; \
+  look = PEEK_BITS(HUFF_LOOKAHEAD); \
+  if ((nb = htbl->look_nbits[look]) != 0) { \
+    DROP_BITS(nb); \
+    result = htbl->look_sym[look]; \
+  } else { \
+    register INT32 code; \
+    nb = HUFF_LOOKAHEAD+1; \
+    code = GET_BITS(nb); \
+    while (code > htbl->maxcode[nb]) { \
+      code = (code << 1) | GET_BITS(1); \
+      nb++; \
+    } \
+    if (nb > 16) \
+      { failaction; }		/* bad code; the careful path warns */ \
+    result = htbl->pub->huffval[(int)(code + htbl->valoffset[nb])]; \
+  } \
+}
+
+LOCAL(bool)
+decode_mcu_fast(j_decompress_ptr cinfo, JBLOCKROW* MCU_data)
+{
+    huff_entropy_ptr entropy = (huff_entropy_ptr)cinfo->entropy;
+    register bit_buf_type get_buffer = entropy->bitstate.get_buffer;
+    register int bits_left = entropy->bitstate.bits_left;
+    const JOCTET* start = cinfo->src->next_input_byte;
+    register const JOCTET* buffer = start;
+    size_t bytes_in_buffer = cinfo->src->bytes_in_buffer;
+    bool hit_marker = false;
+    int blkn;
+    savable_state state;
+    SHIFT_TEMPS
+
+    ASSIGN_STATE(state, entropy->saved);
+
+    for (blkn = 0; blkn < cinfo->blocks_in_MCU; blkn++) {
+        JBLOCKROW block = MCU_data[blkn];
+        d_derived_tbl* dctbl = entropy->dc_cur_tbls[blkn];
+        d_derived_tbl* actbl = entropy->ac_cur_tbls[blkn];
+        register int s, k, r;
+        int last = 0;		/* zigzag index of last coefficient stored */
+
+        /* Give up near the end of the buffer */
+        if ((size_t)(buffer - start) + FAST_BYTES_PER_BLOCK > bytes_in_buffer)
+            goto give_up;
+
+        /* Section F.2.2.1: decode the DC coefficient difference,
+         * in one lookup if its code and magnitude bits are short enough
+         */
+        FILL_BIT_BUFFER_FAST;
+        if ((r = (int)dctbl->look_val[PEEK_BITS(HUFF_VAL_LOOKAHEAD)]) != 0) {
+            DROP_BITS(r & 0xFF);
+            s = (int)RIGHT_SHIFT((INT32)r, 16);
+        }
+        else {
+            HUFF_DECODE_FAST(s, dctbl, goto give_up);
+            if (s) {
+                r = GET_BITS(s);
+                s = HUFF_EXTEND(r, s);
+            }
+        }
+
+        if (entropy->dc_needed[blkn]) {
+            /* Convert DC difference to actual value, update last_dc_val */
+            int ci = cinfo->MCU_membership[blkn];
+            s += state.last_dc_val[ci];
+            state.last_dc_val[ci] = s;
+            /* Output the DC coefficient (assumes jpeg_natural_order[0] = 0) */
+            (*block)[0] = (JCOEF)s;
+        }
+
+        if (entropy->ac_needed[blkn]) {
+
+            /* Section F.2.2.2: decode the AC coefficients */
+            for (k = 1; k < DCTSIZE2; k++) {
+                /* Short code and small coefficient: one lookup gives the
+                 * run, the value and the number of bits to drop
+                 */
+                FILL_BIT_BUFFER_FAST;
+                if ((r = (int)actbl->look_val[PEEK_BITS(HUFF_VAL_LOOKAHEAD)]) != 0) {
+                    DROP_BITS(r & 0xFF);
+                    k += (r & 0xFF00) >> 8;
+                    (*block)[jpeg_natural_order[k]] =
+                        (JCOEF)RIGHT_SHIFT((INT32)r, 16);
+                    last = k;
+                    continue;
+                }
+
+                HUFF_DECODE_FAST(s, actbl, goto give_up);
+
+                r = s >> 4;
+                s &= 15;
+
+                if (s) {
+                    k += r;
+                    r = GET_BITS(s);
+                    s = HUFF_EXTEND(r, s);
+                    (*block)[jpeg_natural_order[k]] = (JCOEF)s;
+                    last = k;
+                }
+                else {
+                    if (r != 15)
+                        break;
+                    k += 15;
+                }
+            }
+
+        }
+        else {
+
+            /* Section F.2.2.2: decode the AC coefficients and discard them */
+            for (k = 1; k < DCTSIZE2; k++) {
+                FILL_BIT_BUFFER_FAST;
+                /* Pass over several codes at once if they all fit in the
+                 * block; otherwise take them one at a time, as usual
+                 */
+                r = (int)actbl->look_skip[PEEK_BITS(HUFF_SKIP_LOOKAHEAD)];
+                if (r != 0 && k + ((r >> 8) & 0x7F) <= DCTSIZE2) {
+                    DROP_BITS(r & 0xFF);
+                    if (r & 0x8000)
+                        break;		/* ended with EOB */
+                    k += ((r >> 8) & 0x7F) - 1;
+                    continue;
+                }
+                if ((r = (int)actbl->look_val[PEEK_BITS(HUFF_VAL_LOOKAHEAD)]) != 0) {
+                    DROP_BITS(r & 0xFF);
+                    k += (r & 0xFF00) >> 8;
+                    continue;
+                }
+
+                HUFF_DECODE_FAST(s, actbl, goto give_up);
+
+                r = s >> 4;
+                s &= 15;
+
+                if (s) {
+                    k += r;
+                    DROP_BITS(s);
+                }
+                else {
+                    if (r != 15)
+                        break;
+                    k += 15;
+                }
+            }
+
+        }
+
+        /* Corrupt data can push k past the end of the block */
+        entropy->pub.block_last[blkn] = (last < DCTSIZE2) ? last : DCTSIZE2 - 1;
+    }
+
+    if (!hit_marker) {
+        /* Completed MCU, so update state */
+        cinfo->src->next_input_byte = buffer;
+        cinfo->src->bytes_in_buffer = bytes_in_buffer - (size_t)(buffer - start);
+        entropy->bitstate.get_buffer = get_buffer;
+        entropy->bitstate.bits_left = bits_left;
+        ASSIGN_STATE(entropy->saved, state);
+        return true;
+    }
+
+give_up:
+    /* Undo the blocks stored so far (the caller had zeroed them) */
+    if (blkn >= cinfo->blocks_in_MCU)
+        blkn = cinfo->blocks_in_MCU - 1;
+    for (; blkn >= 0; blkn--)
+        jzero_far((void FAR*) MCU_data[blkn], SIZEOF(JBLOCK));
+    return false;
+}
+
+
 /*
  * Decode and return one MCU's worth of Huffman-compressed coefficients.
  * The coefficients are reordered from zigzag order into natural array order,
@@ -537,6 +975,14 @@ decode_mcu(j_decompress_ptr cinfo, JBLOCKROW* MCU_data)
      */
     if (!entropy->pub.insufficient_data) {
 
+        /* Try the fast path unless the buffer is nearly empty or we have
+         * already reached the marker ending the data segment
+         */
+        if (cinfo->src->bytes_in_buffer >= FAST_BYTES_PER_BLOCK &&
+            cinfo->unread_marker == 0 &&
+            decode_mcu_fast(cinfo, MCU_data))
+            goto done;
+
         /* Load up working state */
         BITREAD_LOAD_STATE(cinfo, entropy->bitstate);
         ASSIGN_STATE(state, entropy->saved);
@@ -548,6 +994,7 @@ decode_mcu(j_decompress_ptr cinfo, JBLOCKROW* MCU_data)
             d_derived_tbl* dctbl = entropy->dc_cur_tbls[blkn];
             d_derived_tbl* actbl = entropy->ac_cur_tbls[blkn];
             register int s, k, r;
+            int last = 0;		/* zigzag index of last coefficient stored */
 
             /* Decode a single block's worth of coefficients */
 
@@ -588,6 +1035,7 @@ decode_mcu(j_decompress_ptr cinfo, JBLOCKROW* MCU_data)
                          * if k >= DCTSIZE2, which could happen if the data is corrupted.
                          */
                         (*block)[jpeg_natural_order[k]] = (JCOEF)s;
+                        last = k;
                     }
                     else {
                         if (r != 15)
@@ -620,13 +1068,22 @@ decode_mcu(j_decompress_ptr cinfo, JBLOCKROW* MCU_data)
                 }
 
             }
+
+            entropy->pub.block_last[blkn] =
+                (last < DCTSIZE2) ? last : DCTSIZE2 - 1;
         }
 
         /* Completed MCU, so update state */
         BITREAD_SAVE_STATE(cinfo, entropy->bitstate);
         ASSIGN_STATE(entropy->saved, state);
     }
+    else {
+        /* The MCU is left all zero */
+        for (blkn = 0; blkn < cinfo->blocks_in_MCU; blkn++)
+            entropy->pub.block_last[blkn] = 0;
+    }
 
+done:
     /* Account for restart interval (no-op if not using restarts) */
     entropy->restarts_to_go--;
 
@@ -642,7 +1099,9 @@ GLOBAL(void)
 jinit_huff_decoder(j_decompress_ptr cinfo)
 {
     huff_entropy_ptr entropy;
-    int i;
+    jpeg_component_info* compptr;
+    bool need_skip;
+    int ci, i;
 
     entropy = (huff_entropy_ptr)
         (*cinfo->mem->alloc_small) ((j_common_ptr)cinfo, JPOOL_IMAGE,
@@ -655,4 +1114,15 @@ jinit_huff_decoder(j_decompress_ptr cinfo)
     for (i = 0; i < NUM_HUFF_TBLS; i++) {
         entropy->dc_derived_tbls[i] = entropy->ac_derived_tbls[i] = NULL;
     }
+
+    /* Set up the cached workspaces now; the skip table is wanted if some
+     * component's ACs are parsed only to be discarded (see start_pass)
+     */
+    need_skip = false;
+    for (ci = 0, compptr = cinfo->comp_info; ci < cinfo->num_components;
+        ci++, compptr++) {
+        if (!compptr->component_needed || compptr->DCT_scaled_size == 1)
+            need_skip = true;
+    }
+    jpeg_alloc_d_derived_tbls(cinfo, need_skip);
 }
@@ -14,6 +14,7 @@
 
 #ifdef NEED_SHORT_EXTERNAL_NAMES
 #define jpeg_make_d_derived_tbl	jMkDDerived
+#define jpeg_alloc_d_derived_tbls	jAlDDerived
 #define jpeg_fill_bit_buffer	jFilBitBuf
 #define jpeg_huff_decode	jHufDecode
 #endif /* NEED_SHORT_EXTERNAL_NAMES */
@@ -22,6 +23,8 @@
 /* Derived data constructed for each Huffman table */
 
 #define HUFF_LOOKAHEAD	8	/* # of bits of lookahead */
+#define HUFF_VAL_LOOKAHEAD 10	/* # of bits of lookahead for look_val */
+#define HUFF_SKIP_LOOKAHEAD 12	/* # of bits of lookahead for look_skip */
 
 typedef struct {
   /* Basic tables: (element [0] of each array is unused) */
@@ -43,12 +46,45 @@ typedef struct {
    */
   int look_nbits[1<<HUFF_LOOKAHEAD]; /* # bits, or 0 if too long */
   UINT8 look_sym[1<<HUFF_LOOKAHEAD]; /* symbol, or unused */
+
+  /* Combined lookahead table: indexed by the next HUFF_VAL_LOOKAHEAD bits.
+   * When a Huffman code and the magnitude bits following it both fit in
+   * that many bits, the entry holds the decoded (sign-extended) value
+   * << 16, plus the zero run before it (AC only) << 8, plus the total
+   * number of bits; otherwise it is 0 and the code is decoded the
+   * ordinary way.  EOB and ZRL have no entries.
+   */
+  INT32 look_val[1<<HUFF_VAL_LOOKAHEAD];
+
+  /* Skip table for AC coefficients that are decoded only to be discarded
+   * (jdhuff.c builds it on first use): indexed by the next
+   * HUFF_SKIP_LOOKAHEAD bits, each entry covers as many complete AC codes
+   * and their magnitude bits as fit in them, up to and including an EOB.
+   * It holds the number of bits, plus the total advance through the block
+   * << 8 (run + 1 per coefficient, 16 per ZRL, 1 for EOB), plus 0x8000 if
+   * the last code is EOB; 0 if not even one code fits.
+   */
+  UINT16 *look_skip;		/* NULL until allocated */
+  bool skip_valid;		/* look_skip matches the current table? */
 } d_derived_tbl;
 
+/* Derived tables are kept in the permanent pool (cinfo->tables->huff_cache),
+ * one per table slot, along with a copy of the definition they were built
+ * from.  A later scan or image whose table is unchanged reuses them as is.
+ */
+struct d_huff_cache {
+  d_derived_tbl * dtbl[2][NUM_HUFF_TBLS];	/* [isDC][tblno], NULL until built */
+  JHUFF_TBL source[2][NUM_HUFF_TBLS];	/* definition each was built from */
+  bool valid[2][NUM_HUFF_TBLS];		/* dtbl matches source? */
+};
+
 /* Expand a Huffman table definition into the derived format */
 EXTERN(void) jpeg_make_d_derived_tbl
 	JPP((j_decompress_ptr cinfo, bool isDC, int tblno,
 	     d_derived_tbl ** pdtbl));
+/* Allocate the cached workspaces at module initialization */
+EXTERN(void) jpeg_alloc_d_derived_tbls
+	JPP((j_decompress_ptr cinfo, bool need_skip));
 
 
 /*
@@ -69,13 +105,15 @@ EXTERN(void) jpeg_make_d_derived_tbl
  * necessary.
  */
 
-typedef INT32 bit_buf_type;	/* type of bit-extraction buffer */
-#define BIT_BUF_SIZE  32	/* size of buffer in bits */
+typedef unsigned long long bit_buf_type; /* type of bit-extraction buffer */
+#define BIT_BUF_SIZE  64	/* size of buffer in bits */
 
-/* If long is > 32 bits on your machine, and shifting/masking longs is
- * reasonably fast, making bit_buf_type be long and setting BIT_BUF_SIZE
- * appropriately should be a win.  Unfortunately we can't define the size
- * with something like  #define BIT_BUF_SIZE (sizeof(bit_buf_type)*8)
+/* A 64-bit buffer lets jpeg_fill_bit_buffer load more than seven bytes per
+ * call, and holds enough bits for a complete Huffman code plus its magnitude
+ * bits several times over, so the decoders call it far less often.  Bits
+ * above the bits_left valid ones are garbage; the buffer is unsigned so that
+ * shifting them out is well defined.  We can't define the size with
+ * something like  #define BIT_BUF_SIZE (sizeof(bit_buf_type)*8)
  * because not all machines measure sizeof in 8-bit bytes.
  */
 
@@ -142,10 +180,10 @@ typedef struct {		/* Bitreading working state within an MCU */
 	    get_buffer = (state).get_buffer; bits_left = (state).bits_left; } }
 
 #define GET_BITS(nbits) \
-	(((int) (get_buffer >> (bits_left -= (nbits)))) & ((1<<(nbits))-1))
+	((int) ((get_buffer >> (bits_left -= (nbits))) & ((1<<(nbits))-1)))
 
 #define PEEK_BITS(nbits) \
-	(((int) (get_buffer >> (bits_left -  (nbits)))) & ((1<<(nbits))-1))
+	((int) ((get_buffer >> (bits_left -  (nbits))) & ((1<<(nbits))-1)))
 
 #define DROP_BITS(nbits) \
 	(bits_left -= (nbits))
@@ -95,46 +95,34 @@ jpeg_calc_output_dimensions(j_decompress_ptr cinfo)
 
 #ifdef IDCT_SCALING_SUPPORTED
 
-    /* Compute actual output image dimensions and DCT scaling choices. */
-    if (cinfo->scale_num * 8 <= cinfo->scale_denom) {
-        /* Provide 1/8 scaling */
-        cinfo->output_width = (JDIMENSION)
-            jdiv_round_up((long)cinfo->image_width, 8L);
-        cinfo->output_height = (JDIMENSION)
-            jdiv_round_up((long)cinfo->image_height, 8L);
-        cinfo->min_DCT_scaled_size = 1;
-    }
-    else if (cinfo->scale_num * 4 <= cinfo->scale_denom) {
-        /* Provide 1/4 scaling */
-        cinfo->output_width = (JDIMENSION)
-            jdiv_round_up((long)cinfo->image_width, 4L);
-        cinfo->output_height = (JDIMENSION)
-            jdiv_round_up((long)cinfo->image_height, 4L);
-        cinfo->min_DCT_scaled_size = 2;
-    }
-    else if (cinfo->scale_num * 2 <= cinfo->scale_denom) {
-        /* Provide 1/2 scaling */
+    /* Compute actual output image dimensions and DCT scaling choices.
+     * The IDCT can produce any size from 1x1 to 8x8 pixels per block, so
+     * take the smallest M/8 scaling that is at least the requested one.
+     */
+    {
+        int ssize;
+
+        for (ssize = 1; ssize < DCTSIZE; ssize++) {
+            if ((long)cinfo->scale_num * DCTSIZE <=
+                (long)cinfo->scale_denom * ssize)
+                break;
+        }
         cinfo->output_width = (JDIMENSION)
-            jdiv_round_up((long)cinfo->image_width, 2L);
+            jdiv_round_up((long)cinfo->image_width * ssize, (long)DCTSIZE);
         cinfo->output_height = (JDIMENSION)
-            jdiv_round_up((long)cinfo->image_height, 2L);
-        cinfo->min_DCT_scaled_size = 4;
-    }
-    else {
-        /* Provide 1/1 scaling */
-        cinfo->output_width = cinfo->image_width;
-        cinfo->output_height = cinfo->image_height;
-        cinfo->min_DCT_scaled_size = DCTSIZE;
+            jdiv_round_up((long)cinfo->image_height * ssize, (long)DCTSIZE);
+        cinfo->min_DCT_scaled_size = ssize;
     }
     /* In selecting the actual DCT scaling for each component, we try to
      * scale up the chroma components via IDCT scaling rather than upsampling.
      * This saves time if the upsampler gets to use 1:1 scaling.
-     * Note this code assumes that the supported DCT scalings are powers of 2.
+     * Sizes are only ever doubled, so that the ratios left for the upsampler
+     * remain powers of 2.
      */
     for (ci = 0, compptr = cinfo->comp_info; ci < cinfo->num_components;
         ci++, compptr++) {
         int ssize = cinfo->min_DCT_scaled_size;
-        while (ssize < DCTSIZE &&
+        while (ssize * 2 <= DCTSIZE &&
             (compptr->h_samp_factor * ssize * 2 <=
                 cinfo->max_h_samp_factor * cinfo->min_DCT_scaled_size) &&
             (compptr->v_samp_factor * ssize * 2 <=
@@ -189,6 +177,14 @@ jpeg_calc_output_dimensions(j_decompress_ptr cinfo)
     case JCS_YCCK:
         cinfo->out_color_components = 4;
         break;
+    case JCS_EXT_RGB:
+    case JCS_EXT_BGR:
+    case JCS_EXT_RGBX:
+    case JCS_EXT_RGBA:
+    case JCS_EXT_BGRA:
+    case JCS_EXT_ARGB:
+        cinfo->out_color_components = jpeg_rgb_pixelsize[cinfo->out_color_space];
+        break;
     default:			/* else must be same colorspace as in file */
         cinfo->out_color_components = cinfo->num_components;
         break;
@@ -254,8 +250,14 @@ prepare_range_limit_table(j_decompress_ptr cinfo)
     JSAMPLE* table;
     int i;
 
+    /* The table is constant, so it is built once per object */
+    if (cinfo->tables->sample_range_limit != NULL) {
+        cinfo->sample_range_limit = cinfo->tables->sample_range_limit;
+        return;
+    }
+
     table = (JSAMPLE*)
-        (*cinfo->mem->alloc_small) ((j_common_ptr)cinfo, JPOOL_IMAGE,
+        (*cinfo->mem->alloc_small) ((j_common_ptr)cinfo, JPOOL_PERMANENT,
             (5 * (MAXJSAMPLE + 1) + CENTERJSAMPLE) * SIZEOF(JSAMPLE));
     table += (MAXJSAMPLE + 1);	/* allow negative subscripts of simple table */
     cinfo->sample_range_limit = table;
@@ -273,6 +275,7 @@ prepare_range_limit_table(j_decompress_ptr cinfo)
         (2 * (MAXJSAMPLE + 1) - CENTERJSAMPLE) * SIZEOF(JSAMPLE));
     MEMCOPY(table + (4 * (MAXJSAMPLE + 1) - CENTERJSAMPLE),
         cinfo->sample_range_limit, CENTERJSAMPLE * SIZEOF(JSAMPLE));
+    cinfo->tables->sample_range_limit = cinfo->sample_range_limit;
 }
 
 
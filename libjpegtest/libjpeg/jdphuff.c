@@ -82,6 +82,8 @@ METHODDEF(bool) decode_mcu_DC_refine JPP((j_decompress_ptr cinfo,
     JBLOCKROW* MCU_data));
 METHODDEF(bool) decode_mcu_AC_refine JPP((j_decompress_ptr cinfo,
     JBLOCKROW* MCU_data));
+METHODDEF(bool) skip_mcu_AC JPP((j_decompress_ptr cinfo,
+    JBLOCKROW* MCU_data));
 
 
 /*
@@ -159,6 +161,12 @@ start_pass_phuff_decoder(j_decompress_ptr cinfo)
         else
             entropy->pub.decode_mcu = decode_mcu_AC_refine;
     }
+    if (!is_DC_band) {
+        /* Nothing depends on the ACs of an unused or 1x1-scaled component */
+        compptr = cinfo->cur_comp_info[0];
+        if (!compptr->component_needed || compptr->DCT_scaled_size == 1)
+            entropy->pub.decode_mcu = skip_mcu_AC;
+    }
 
     for (ci = 0; ci < cinfo->comps_in_scan; ci++) {
         compptr = cinfo->cur_comp_info[ci];
@@ -640,6 +648,94 @@ undoit:
 }
 
 
+/*
+ * "Decoding" for an AC scan whose coefficients nobody will look at: the
+ * component is not needed, or is being scaled to 1x1 so that only its DC
+ * coefficient matters.  Progressive AC scans hold a single component, so
+ * the whole scan can be passed over without Huffman decoding.  The first
+ * call searches the data for the marker that ends the scan (stepping over
+ * stuffed zeros and restart markers) and leaves it in unread_marker, as
+ * jpeg_fill_bit_buffer would have; the remaining calls do nothing.
+ *
+ * Codes below SOF0 cannot be real markers, so like jpeg_resync_to_restart
+ * we treat them as corrupt data rather than as the end of the scan.  The
+ * bytes from there up to the next restart or real marker are what the
+ * normal decoder would have discarded while resyncing, and are reported
+ * with the same warnings.
+ */
+
+METHODDEF(bool)
+skip_mcu_AC(j_decompress_ptr cinfo, JBLOCKROW* MCU_data)
+{
+    struct jpeg_source_mgr* src = cinfo->src;
+    const JOCTET* next_input_byte;
+    const JOCTET* ffptr;
+    size_t bytes_in_buffer;
+    int c;
+
+    while (cinfo->unread_marker == 0) {
+        if (src->bytes_in_buffer == 0) {
+            if (!(*src->fill_input_buffer) (cinfo))
+                return false;
+        }
+        ffptr = (const JOCTET*)
+            memchr(src->next_input_byte, 0xFF, src->bytes_in_buffer);
+        if (ffptr == NULL) {
+            if (cinfo->entropy->insufficient_data)
+                cinfo->marker->discarded_bytes += (unsigned int)src->bytes_in_buffer;
+            src->next_input_byte += src->bytes_in_buffer;
+            src->bytes_in_buffer = 0;
+            continue;
+        }
+        /* Commit up to the FF, then read past it without committing, as
+         * next_marker does, so that after a suspension we start over there.
+         */
+        if (cinfo->entropy->insufficient_data)
+            cinfo->marker->discarded_bytes +=
+                (unsigned int)(ffptr - src->next_input_byte);
+        src->bytes_in_buffer -= (size_t)(ffptr - src->next_input_byte);
+        src->next_input_byte = ffptr;
+        next_input_byte = ffptr + 1;
+        bytes_in_buffer = src->bytes_in_buffer - 1;
+        do {			/* any number of fill bytes may precede a marker */
+            if (bytes_in_buffer == 0) {
+                if (!(*src->fill_input_buffer) (cinfo))
+                    return false;
+                next_input_byte = src->next_input_byte;
+                bytes_in_buffer = src->bytes_in_buffer;
+            }
+            c = GETJOCTET(*next_input_byte++);
+            bytes_in_buffer--;
+        } while (c == 0xFF);
+        src->next_input_byte = next_input_byte;
+        src->bytes_in_buffer = bytes_in_buffer;
+
+        if (c < 0xC0) {		/* below SOF0 */
+            /* FF/00 is an FF data byte; any other code here is not a marker */
+            if (c != 0 && !cinfo->entropy->insufficient_data) {
+                WARNMS(cinfo, JWRN_HIT_MARKER);
+                cinfo->entropy->insufficient_data = true;
+            }
+            if (cinfo->entropy->insufficient_data)
+                cinfo->marker->discarded_bytes += 2;
+            continue;
+        }
+        if (cinfo->marker->discarded_bytes != 0) {
+            WARNMS2(cinfo, JWRN_EXTRANEOUS_DATA,
+                cinfo->marker->discarded_bytes, c);
+            cinfo->marker->discarded_bytes = 0;
+        }
+        /* RSTn belongs to this scan; a real marker ends it */
+        if (c >= JPEG_RST0 && c <= JPEG_RST0 + 7)
+            cinfo->entropy->insufficient_data = false;
+        else
+            cinfo->unread_marker = c;
+    }
+
+    return true;
+}
+
+
 /*
  * Module initialization routine for progressive Huffman entropy decoding.
  */
@@ -661,6 +757,8 @@ jinit_phuff_decoder(j_decompress_ptr cinfo)
     for (i = 0; i < NUM_HUFF_TBLS; i++) {
         entropy->derived_tbls[i] = NULL;
     }
+    /* Set up the cached workspaces now (skip_mcu_AC needs no skip table) */
+    jpeg_alloc_d_derived_tbls(cinfo, false);
 
     /* Create progression status table */
     cinfo->coef_bits = (int(*)[DCTSIZE2])
@@ -0,0 +1,182 @@
+/*
+ * jdprobe.c
+ *
+ * This file contains a lightweight header probe.  It walks the markers of
+ * a JPEG datastream held in memory, from SOI up to the first SOS, and
+ * reports image geometry, sampling factors, coding process, restart
+ * interval and marker positions.  No JPEG object, memory manager or error
+ * manager is involved, so it costs no more than reading the markers; use
+ * it to decide whether an image is worth decompressing at all.
+ *
+ * The marker syntax follows jdmarker.c, but nothing is validated beyond
+ * what is needed to walk the segments safely.
+ */
+
+ /* this is not a core library module, so it doesn't define JPEG_INTERNALS */
+#include "jinclude.h"
+#include "jpeglib.h"
+
+
+#define M_SOI   0xd8
+#define M_SOS   0xda
+#define M_DRI   0xdd
+#define M_TEM   0x01
+
+
+/* Read a 2-byte big-endian value */
+#define GET_2BYTES(p)  (((unsigned int)(p)[0] << 8) + (unsigned int)(p)[1])
+
+
+/*
+ * Record the frame header of a SOFn segment.
+ * data points just past the length field, length counts the data bytes.
+ */
+
+LOCAL(bool)
+probe_sof(struct jpeg_probe_info* info, int marker,
+    const JOCTET* data, size_t length)
+{
+    int ci;
+
+    if (length < 6)
+        return false;
+    info->sof_marker = marker;
+    info->data_precision = data[0];
+    info->image_height = (JDIMENSION)GET_2BYTES(data + 1);
+    info->image_width = (JDIMENSION)GET_2BYTES(data + 3);
+    info->num_components = data[5];
+    if (info->num_components <= 0 || info->num_components > MAX_COMPONENTS ||
+        length != (size_t)(6 + info->num_components * 3))
+        return false;
+
+    /* SOF2/6/10/14 are progressive, SOF9-15 arithmetic coded */
+    info->progressive_mode = ((marker & 3) == 2);
+    info->arith_code = (marker >= 0xc9);
+
+    for (ci = 0; ci < info->num_components; ci++) {
+        const JOCTET* comp = data + 6 + ci * 3;
+        info->comp_info[ci].component_id = comp[0];
+        info->comp_info[ci].h_samp_factor = (comp[1] >> 4) & 15;
+        info->comp_info[ci].v_samp_factor = comp[1] & 15;
+        info->comp_info[ci].quant_tbl_no = comp[2];
+    }
+    return true;
+}
+
+
+/*
+ * Note JFIF and Adobe markers, which decide the default color space.
+ */
+
+LOCAL(void)
+probe_app(struct jpeg_probe_info* info, int marker,
+    const JOCTET* data, size_t length)
+{
+    if (marker == JPEG_APP0 && length >= 5 &&
+        data[0] == 'J' && data[1] == 'F' && data[2] == 'I' &&
+        data[3] == 'F' && data[4] == 0)
+        info->saw_JFIF_marker = true;
+    else if (marker == JPEG_APP0 + 14 && length >= 12 &&
+        data[0] == 'A' && data[1] == 'd' && data[2] == 'o' &&
+        data[3] == 'b' && data[4] == 'e') {
+        info->saw_Adobe_marker = true;
+        info->Adobe_transform = data[11];
+    }
+}
+
+
+/*
+ * Probe a JPEG datastream in data[0..size-1].
+ *
+ * Returns JPEG_HEADER_OK when a frame header and the first SOS were found,
+ * JPEG_HEADER_TABLES_ONLY when EOI came first, JPEG_SUSPENDED when the data
+ * end before SOS (more of the file is needed), and JPEG_PROBE_INVALID when
+ * the data do not start with SOI or a marker segment is malformed.
+ * info is filled in as far as the data go in every case.
+ */
+
+GLOBAL(int)
+jpeg_probe(const JOCTET* data, size_t size, struct jpeg_probe_info* info)
+{
+    size_t pos, length;
+    int marker;
+
+    MEMZERO(info, SIZEOF(struct jpeg_probe_info));
+
+    if (size < 2 || data[0] != 0xFF || data[1] != M_SOI)
+        return (size < 2) ? JPEG_SUSPENDED : JPEG_PROBE_INVALID;
+    pos = 2;
+
+    for (;;) {
+        /* Find the next marker.  Garbage before it is tolerated, as
+         * next_marker in jdmarker.c does; any number of 0xFF fill bytes
+         * may precede the marker code.
+         */
+        while (pos < size && data[pos] != 0xFF)
+            pos++;
+        while (pos + 1 < size && data[pos + 1] == 0xFF)
+            pos++;
+        if (pos + 1 >= size)
+            return JPEG_SUSPENDED;
+        marker = data[pos + 1];
+        if (marker == 0) {		/* stuffed zero, not a marker */
+            pos += 2;
+            continue;
+        }
+
+        if (marker == JPEG_EOI)
+            return JPEG_HEADER_TABLES_ONLY;
+        if (marker == M_SOI)
+            return JPEG_PROBE_INVALID;
+        if (marker == M_TEM || (marker >= JPEG_RST0 && marker <= JPEG_RST0 + 7)) {
+            pos += 2;		/* no parameters */
+            continue;
+        }
+
+        /* Every other marker has a length field */
+        if (pos + 4 > size)
+            return JPEG_SUSPENDED;
+        length = GET_2BYTES(data + pos + 2);
+        if (length < 2)
+            return JPEG_PROBE_INVALID;
+        length -= 2;
+
+        if (marker == M_SOS) {
+            info->sos_offset = pos;
+            if (info->sof_marker == 0)
+                return JPEG_PROBE_INVALID;	/* SOS before SOF */
+            return JPEG_HEADER_OK;
+        }
+
+        if (info->marker_count < JPEG_PROBE_MAX_MARKERS) {
+            info->markers[info->marker_count].marker = marker;
+            info->markers[info->marker_count].offset = pos;
+            info->markers[info->marker_count].data_length = length;
+        }
+        info->marker_count++;
+
+        /* Only segments we read from must be complete; others are skipped */
+        if ((marker >= 0xc0 && marker <= 0xcf && marker != 0xc4 &&
+            marker != 0xc8 && marker != 0xcc) || marker == M_DRI ||
+            marker == JPEG_APP0 || marker == JPEG_APP0 + 14) {
+            if (pos + 4 + length > size)
+                return JPEG_SUSPENDED;
+            if (marker == M_DRI) {
+                if (length != 2)
+                    return JPEG_PROBE_INVALID;
+                info->restart_interval = GET_2BYTES(data + pos + 4);
+            }
+            else if (marker >= JPEG_APP0) {
+                probe_app(info, marker, data + pos + 4, length);
+            }
+            else {
+                if (info->sof_marker != 0)
+                    return JPEG_PROBE_INVALID;	/* duplicate SOF */
+                if (!probe_sof(info, marker, data + pos + 4, length))
+                    return JPEG_PROBE_INVALID;
+            }
+        }
+
+        pos += 4 + length;
+    }
+}
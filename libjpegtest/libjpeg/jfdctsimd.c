@@ -0,0 +1,378 @@
+/*
+ * jfdctsimd.c
+ *
+ * Based on jfdctint.c, jfdctfst.c and jcdctmgr.c.
+ *
+ * This file contains SSE2 versions of the integer forward DCTs in
+ * jfdctint.c and jfdctfst.c, each fused with the sample loading and the
+ * quantization that forward_DCT in jcdctmgr.c wraps around them.  A block
+ * stays in registers from the samples to the quantized coefficients.
+ * The results are exactly those of the C code.
+ *
+ * For 8-bit samples every intermediate value of both DCTs fits in 16 bits
+ * (jfdctfst.c says so; for jfdctint.c the pass 1 outputs are within +-4K
+ * and the pass 2 DC sum within -32768..32512), so eight columns are done
+ * at once in 16-bit lanes.  Only the constant multiplications of the
+ * islow DCT need 32 bits; they are gathered into pmaddwd pairs, as in
+ * jidctsimd.c.
+ */
+
+#define JPEG_INTERNALS
+#include "jinclude.h"
+#include "jpeglib.h"
+#include "jdct.h"		/* Private declarations for DCT subsystem */
+#include "jsimd.h"
+
+#ifdef JSIMD_X86
+
+#include <emmintrin.h>
+
+
+/*
+ * This module is specialized to the case DCTSIZE = 8 and 8-bit samples.
+ */
+
+#if DCTSIZE != 8
+Sorry, this code only copes with 8x8 DCTs. /* deliberate syntax err */
+#endif
+#if BITS_IN_JSAMPLE != 8
+Sorry, this code only copes with 8-bit samples. /* deliberate syntax err */
+#endif
+
+
+/*
+ * Load a block of samples as eight rows of 16-bit values, applying
+ * unsigned->signed conversion, and transpose it so that one vector holds
+ * a column: pass 1 (rows) then works on all eight rows at once.
+ */
+
+JSIMD_INLINE JSIMD_TARGET_SSE2
+LOCAL(void)
+load_samples_sse2(JSAMPARRAY sample_data, JDIMENSION start_col, __m128i* r)
+{
+    __m128i zero = _mm_setzero_si128();
+    __m128i center = _mm_set1_epi16(CENTERJSAMPLE);
+    int i;
+
+    for (i = 0; i < DCTSIZE; i++) {
+        r[i] = _mm_sub_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64(
+            (const __m128i*)(sample_data[i] + start_col)), zero), center);
+    }
+    TRANSPOSE_8X8_EPI16(r);
+}
+
+
+/*
+ * Quantize eight rows of coefficients in natural order and store them.
+ * With a = |coefficient|, jcdctmgr.c's (a + divisor/2) / divisor equals
+ * ((a + correction) * multiplier) >> shift; pmulhuw yields the product
+ * shifted right by 16, and a second pmulhuw by 2^(32-shift) shifts the
+ * rest of the way.  a + correction stays below 65536 since a < 32768.
+ */
+
+JSIMD_INLINE JSIMD_TARGET_SSE2
+LOCAL(void)
+quantize_sse2(__m128i* r, UINT16* reciprocals, JCOEFPTR output_ptr)
+{
+    __m128i sign, temp;
+    int i;
+
+    for (i = 0; i < DCTSIZE; i++) {
+        sign = _mm_srai_epi16(r[i], 15);
+        temp = _mm_sub_epi16(_mm_xor_si128(r[i], sign), sign);
+        temp = _mm_add_epi16(temp, _mm_loadu_si128((const __m128i*)
+            (reciprocals + RECIP_CORRECTION + DCTSIZE * i)));
+        temp = _mm_mulhi_epu16(temp, _mm_loadu_si128((const __m128i*)
+            (reciprocals + RECIP_MULTIPLIER + DCTSIZE * i)));
+        temp = _mm_mulhi_epu16(temp, _mm_loadu_si128((const __m128i*)
+            (reciprocals + RECIP_SCALE + DCTSIZE * i)));
+        temp = _mm_sub_epi16(_mm_xor_si128(temp, sign), sign);
+        _mm_storeu_si128((__m128i*)(output_ptr + DCTSIZE * i), temp);
+    }
+}
+
+
+#ifdef DCT_ISLOW_SUPPORTED
+
+/* Scaling and constants as in jfdctint.c */
+
+#define CONST_BITS  13
+#define PASS1_BITS  2
+
+#define FIX_0_298631336  2446
+#define FIX_0_390180644  3196
+#define FIX_0_541196100  4433
+#define FIX_0_765366865  6270
+#define FIX_0_899976223  7373
+#define FIX_1_175875602  9633
+#define FIX_1_501321110  12299
+#define FIX_1_847759065  15137
+#define FIX_1_961570560  16069
+#define FIX_2_053119869  16819
+#define FIX_2_562915447  20995
+#define FIX_3_072711026  25172
+
+/* Odd part: the multiplier of each of tmp4..tmp7 in each odd output.
+ * Every output collects its own multiplier, those of z1..z4 for the
+ * inputs it depends on, and z5.
+ */
+
+#define ODD7_T4  (FIX_0_298631336 - FIX_0_899976223 - FIX_1_961570560 + \
+		  FIX_1_175875602)
+#define ODD7_T5  FIX_1_175875602
+#define ODD7_T6  (FIX_1_175875602 - FIX_1_961570560)
+#define ODD7_T7  (FIX_1_175875602 - FIX_0_899976223)
+#define ODD5_T4  FIX_1_175875602
+#define ODD5_T5  (FIX_2_053119869 - FIX_2_562915447 - FIX_0_390180644 + \
+		  FIX_1_175875602)
+#define ODD5_T6  (FIX_1_175875602 - FIX_2_562915447)
+#define ODD5_T7  (FIX_1_175875602 - FIX_0_390180644)
+#define ODD3_T4  (FIX_1_175875602 - FIX_1_961570560)
+#define ODD3_T5  (FIX_1_175875602 - FIX_2_562915447)
+#define ODD3_T6  (FIX_3_072711026 - FIX_2_562915447 - FIX_1_961570560 + \
+		  FIX_1_175875602)
+#define ODD3_T7  FIX_1_175875602
+#define ODD1_T4  (FIX_1_175875602 - FIX_0_899976223)
+#define ODD1_T5  (FIX_1_175875602 - FIX_0_390180644)
+#define ODD1_T6  FIX_1_175875602
+#define ODD1_T7  (FIX_1_501321110 - FIX_0_899976223 - FIX_0_390180644 + \
+		  FIX_1_175875602)
+
+/* The pairs are (tmp12,tmp13), (tmp4,tmp7) and (tmp5,tmp6) */
+
+#define K1213_OUT2  PAIR(FIX_0_541196100, FIX_0_541196100 + FIX_0_765366865)
+#define K1213_OUT6  PAIR(FIX_0_541196100 - FIX_1_847759065, FIX_0_541196100)
+#define K47_OUT7  PAIR(ODD7_T4, ODD7_T7)
+#define K56_OUT7  PAIR(ODD7_T5, ODD7_T6)
+#define K47_OUT5  PAIR(ODD5_T4, ODD5_T7)
+#define K56_OUT5  PAIR(ODD5_T5, ODD5_T6)
+#define K47_OUT3  PAIR(ODD3_T4, ODD3_T7)
+#define K56_OUT3  PAIR(ODD3_T5, ODD3_T6)
+#define K47_OUT1  PAIR(ODD1_T4, ODD1_T7)
+#define K56_OUT1  PAIR(ODD1_T5, ODD1_T6)
+
+
+/* Multiply the pairs lo and hi by k and descale the sums to 16 bits */
+
+#define MADD_DESCALE(lo,hi,k,n) \
+    _mm_packs_epi32( \
+	_mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(lo, _mm_set1_epi32(k)), \
+				     _mm_set1_epi32(1 << ((n)-1))), n), \
+	_mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(hi, _mm_set1_epi32(k)), \
+				     _mm_set1_epi32(1 << ((n)-1))), n))
+
+#define MADD2_DESCALE(lo1,hi1,k1,lo2,hi2,k2,n) \
+    _mm_packs_epi32( \
+	_mm_srai_epi32(_mm_add_epi32(_mm_add_epi32( \
+		_mm_madd_epi16(lo1, _mm_set1_epi32(k1)), \
+		_mm_madd_epi16(lo2, _mm_set1_epi32(k2))), \
+	    _mm_set1_epi32(1 << ((n)-1))), n), \
+	_mm_srai_epi32(_mm_add_epi32(_mm_add_epi32( \
+		_mm_madd_epi16(hi1, _mm_set1_epi32(k1)), \
+		_mm_madd_epi16(hi2, _mm_set1_epi32(k2))), \
+	    _mm_set1_epi32(1 << ((n)-1))), n))
+
+
+/*
+ * One pass of the islow DCT.  r[k] holds input k of the eight 1-D DCTs,
+ * one per lane, and receives output k.
+ */
+
+JSIMD_INLINE JSIMD_TARGET_SSE2
+LOCAL(void)
+fdct_islow_pass_sse2(__m128i* r, bool pass1)
+{
+    __m128i tmp0, tmp1, tmp2, tmp3, tmp4, tmp5, tmp6, tmp7;
+    __m128i tmp10, tmp11, tmp12, tmp13;
+    __m128i lo1213, hi1213, lo47, hi47, lo56, hi56;
+
+    tmp0 = _mm_add_epi16(r[0], r[7]);
+    tmp7 = _mm_sub_epi16(r[0], r[7]);
+    tmp1 = _mm_add_epi16(r[1], r[6]);
+    tmp6 = _mm_sub_epi16(r[1], r[6]);
+    tmp2 = _mm_add_epi16(r[2], r[5]);
+    tmp5 = _mm_sub_epi16(r[2], r[5]);
+    tmp3 = _mm_add_epi16(r[3], r[4]);
+    tmp4 = _mm_sub_epi16(r[3], r[4]);
+
+    /* Even part */
+
+    tmp10 = _mm_add_epi16(tmp0, tmp3);
+    tmp13 = _mm_sub_epi16(tmp0, tmp3);
+    tmp11 = _mm_add_epi16(tmp1, tmp2);
+    tmp12 = _mm_sub_epi16(tmp1, tmp2);
+
+    if (pass1) {
+        r[0] = _mm_slli_epi16(_mm_add_epi16(tmp10, tmp11), PASS1_BITS);
+        r[4] = _mm_slli_epi16(_mm_sub_epi16(tmp10, tmp11), PASS1_BITS);
+    }
+    else {
+        tmp0 = _mm_set1_epi16(1 << (PASS1_BITS - 1));
+        r[0] = _mm_srai_epi16(_mm_add_epi16(_mm_add_epi16(tmp10, tmp11), tmp0),
+            PASS1_BITS);
+        r[4] = _mm_srai_epi16(_mm_add_epi16(_mm_sub_epi16(tmp10, tmp11), tmp0),
+            PASS1_BITS);
+    }
+
+    lo1213 = _mm_unpacklo_epi16(tmp12, tmp13);
+    hi1213 = _mm_unpackhi_epi16(tmp12, tmp13);
+
+    /* Odd part */
+
+    lo47 = _mm_unpacklo_epi16(tmp4, tmp7);
+    hi47 = _mm_unpackhi_epi16(tmp4, tmp7);
+    lo56 = _mm_unpacklo_epi16(tmp5, tmp6);
+    hi56 = _mm_unpackhi_epi16(tmp5, tmp6);
+
+    if (pass1) {
+        r[2] = MADD_DESCALE(lo1213, hi1213, K1213_OUT2, CONST_BITS - PASS1_BITS);
+        r[6] = MADD_DESCALE(lo1213, hi1213, K1213_OUT6, CONST_BITS - PASS1_BITS);
+        r[7] = MADD2_DESCALE(lo47, hi47, K47_OUT7, lo56, hi56, K56_OUT7,
+            CONST_BITS - PASS1_BITS);
+        r[5] = MADD2_DESCALE(lo47, hi47, K47_OUT5, lo56, hi56, K56_OUT5,
+            CONST_BITS - PASS1_BITS);
+        r[3] = MADD2_DESCALE(lo47, hi47, K47_OUT3, lo56, hi56, K56_OUT3,
+            CONST_BITS - PASS1_BITS);
+        r[1] = MADD2_DESCALE(lo47, hi47, K47_OUT1, lo56, hi56, K56_OUT1,
+            CONST_BITS - PASS1_BITS);
+    }
+    else {
+        r[2] = MADD_DESCALE(lo1213, hi1213, K1213_OUT2, CONST_BITS + PASS1_BITS);
+        r[6] = MADD_DESCALE(lo1213, hi1213, K1213_OUT6, CONST_BITS + PASS1_BITS);
+        r[7] = MADD2_DESCALE(lo47, hi47, K47_OUT7, lo56, hi56, K56_OUT7,
+            CONST_BITS + PASS1_BITS);
+        r[5] = MADD2_DESCALE(lo47, hi47, K47_OUT5, lo56, hi56, K56_OUT5,
+            CONST_BITS + PASS1_BITS);
+        r[3] = MADD2_DESCALE(lo47, hi47, K47_OUT3, lo56, hi56, K56_OUT3,
+            CONST_BITS + PASS1_BITS);
+        r[1] = MADD2_DESCALE(lo47, hi47, K47_OUT1, lo56, hi56, K56_OUT1,
+            CONST_BITS + PASS1_BITS);
+    }
+}
+
+
+/*
+ * Perform the islow forward DCT and quantization on num_blocks blocks.
+ */
+
+JSIMD_TARGET_SSE2
+GLOBAL(void)
+jpeg_fdct_islow_quantize_sse2(JSAMPARRAY sample_data, JDIMENSION start_col,
+    JBLOCKROW coef_blocks, JDIMENSION num_blocks,
+    UINT16 * reciprocals)
+{
+    __m128i r[DCTSIZE];
+    JDIMENSION bi;
+
+    for (bi = 0; bi < num_blocks; bi++, start_col += DCTSIZE) {
+        load_samples_sse2(sample_data, start_col, r);
+        fdct_islow_pass_sse2(r, true);	/* Pass 1: process rows. */
+        TRANSPOSE_8X8_EPI16(r);
+        fdct_islow_pass_sse2(r, false);	/* Pass 2: process columns. */
+        quantize_sse2(r, reciprocals, coef_blocks[bi]);
+    }
+}
+
+#endif /* DCT_ISLOW_SUPPORTED */
+
+
+#ifdef DCT_IFAST_SUPPORTED
+
+/*
+ * jfdctfst.c multiplies by 8-bit constants c and truncates:
+ * (x * c) >> 8.  pmulhw by (c - 256) << 8 gives (x * (c - 256)) >> 8,
+ * which plus x is the same thing; for c < 128, pmulhw by c << 8 alone
+ * will do.  Either way the multiplier fits in 16 bits.
+ */
+
+#define K_0_382683433  (98 * 256)		/* FIX(0.382683433) */
+#define K_0_541196100  ((139 - 256) * 256)	/* FIX(0.541196100) - 256 */
+#define K_0_707106781  ((181 - 256) * 256)	/* FIX(0.707106781) - 256 */
+#define K_1_306562965  ((334 - 256) * 256)	/* FIX(1.306562965) - 256 */
+
+#define MULTIPLY_LOW(x,k)   _mm_mulhi_epi16(x, _mm_set1_epi16(k))
+#define MULTIPLY_HIGH(x,k)  _mm_add_epi16(MULTIPLY_LOW(x, k), x)
+
+
+/*
+ * One pass of the ifast DCT.  r[k] holds input k of the eight 1-D DCTs,
+ * one per lane, and receives output k.
+ */
+
+JSIMD_INLINE JSIMD_TARGET_SSE2
+LOCAL(void)
+fdct_ifast_pass_sse2(__m128i* r)
+{
+    __m128i tmp0, tmp1, tmp2, tmp3, tmp4, tmp5, tmp6, tmp7;
+    __m128i tmp10, tmp11, tmp12, tmp13;
+    __m128i z1, z2, z3, z4, z5, z11, z13;
+
+    tmp0 = _mm_add_epi16(r[0], r[7]);
+    tmp7 = _mm_sub_epi16(r[0], r[7]);
+    tmp1 = _mm_add_epi16(r[1], r[6]);
+    tmp6 = _mm_sub_epi16(r[1], r[6]);
+    tmp2 = _mm_add_epi16(r[2], r[5]);
+    tmp5 = _mm_sub_epi16(r[2], r[5]);
+    tmp3 = _mm_add_epi16(r[3], r[4]);
+    tmp4 = _mm_sub_epi16(r[3], r[4]);
+
+    /* Even part */
+
+    tmp10 = _mm_add_epi16(tmp0, tmp3);	/* phase 2 */
+    tmp13 = _mm_sub_epi16(tmp0, tmp3);
+    tmp11 = _mm_add_epi16(tmp1, tmp2);
+    tmp12 = _mm_sub_epi16(tmp1, tmp2);
+
+    r[0] = _mm_add_epi16(tmp10, tmp11);	/* phase 3 */
+    r[4] = _mm_sub_epi16(tmp10, tmp11);
+
+    z1 = MULTIPLY_HIGH(_mm_add_epi16(tmp12, tmp13), K_0_707106781); /* c4 */
+    r[2] = _mm_add_epi16(tmp13, z1);	/* phase 5 */
+    r[6] = _mm_sub_epi16(tmp13, z1);
+
+    /* Odd part */
+
+    tmp10 = _mm_add_epi16(tmp4, tmp5);	/* phase 2 */
+    tmp11 = _mm_add_epi16(tmp5, tmp6);
+    tmp12 = _mm_add_epi16(tmp6, tmp7);
+
+    z5 = MULTIPLY_LOW(_mm_sub_epi16(tmp10, tmp12), K_0_382683433); /* c6 */
+    z2 = _mm_add_epi16(MULTIPLY_HIGH(tmp10, K_0_541196100), z5); /* c2-c6 */
+    z4 = _mm_add_epi16(MULTIPLY_HIGH(tmp12, K_1_306562965), z5); /* c2+c6 */
+    z3 = MULTIPLY_HIGH(tmp11, K_0_707106781); /* c4 */
+
+    z11 = _mm_add_epi16(tmp7, z3);	/* phase 5 */
+    z13 = _mm_sub_epi16(tmp7, z3);
+
+    r[5] = _mm_add_epi16(z13, z2);	/* phase 6 */
+    r[3] = _mm_sub_epi16(z13, z2);
+    r[1] = _mm_add_epi16(z11, z4);
+    r[7] = _mm_sub_epi16(z11, z4);
+}
+
+
+/*
+ * Perform the ifast forward DCT and quantization on num_blocks blocks.
+ */
+
+JSIMD_TARGET_SSE2
+GLOBAL(void)
+jpeg_fdct_ifast_quantize_sse2(JSAMPARRAY sample_data, JDIMENSION start_col,
+    JBLOCKROW coef_blocks, JDIMENSION num_blocks,
+    UINT16 * reciprocals)
+{
+    __m128i r[DCTSIZE];
+    JDIMENSION bi;
+
+    for (bi = 0; bi < num_blocks; bi++, start_col += DCTSIZE) {
+        load_samples_sse2(sample_data, start_col, r);
+        fdct_ifast_pass_sse2(r);	/* Pass 1: process rows. */
+        TRANSPOSE_8X8_EPI16(r);
+        fdct_ifast_pass_sse2(r);	/* Pass 2: process columns. */
+        quantize_sse2(r, reciprocals, coef_blocks[bi]);
+    }
+}
+
+#endif /* DCT_IFAST_SUPPORTED */
+
+#endif /* JSIMD_X86 */
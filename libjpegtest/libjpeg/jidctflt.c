@@ -239,4 +239,40 @@ Sorry, this code only copes with 8x8 DCTs. /* deliberate syntax err */
     }
 }
 
+
+/*
+ * Variant of jpeg_idct_float for blocks with at most the DC coefficient
+ * nonzero.  Every output sample then equals what jpeg_idct_float computes
+ * for the DC term alone, so the block is simply filled with that value.
+ */
+
+GLOBAL(void)
+jpeg_idct_float_dc(j_decompress_ptr cinfo, jpeg_component_info* compptr,
+    JCOEFPTR coef_block,
+    JSAMPARRAY output_buf, JDIMENSION output_col)
+{
+    FLOAT_MULT_TYPE* quantptr = (FLOAT_MULT_TYPE*)compptr->dct_table;
+    JSAMPLE* range_limit = IDCT_range_limit(cinfo);
+    JSAMPROW outptr;
+    FAST_FLOAT dcval;
+    JSAMPLE outval;
+    int ctr;
+    SHIFT_TEMPS
+
+    dcval = DEQUANTIZE(coef_block[0], quantptr[0]);
+    outval = range_limit[(int)DESCALE((INT32)dcval, 3) & RANGE_MASK];
+
+    for (ctr = 0; ctr < DCTSIZE; ctr++) {
+        outptr = output_buf[ctr] + output_col;
+        outptr[0] = outval;
+        outptr[1] = outval;
+        outptr[2] = outval;
+        outptr[3] = outval;
+        outptr[4] = outval;
+        outptr[5] = outval;
+        outptr[6] = outval;
+        outptr[7] = outval;
+    }
+}
+
 #endif /* DCT_FLOAT_SUPPORTED */
@@ -386,4 +386,330 @@ Sorry, this code only copes with 8x8 DCTs. /* deliberate syntax err */
     }
 }
 
+
+/*
+ * Variants of jpeg_idct_islow for sparse blocks.
+ * These compute exactly what jpeg_idct_islow does (the terms they leave
+ * out are all zero), so the choice between them changes only the speed.
+ */
+
+/* Block with at most the DC coefficient nonzero: a flat 8x8 block */
+
+GLOBAL(void)
+jpeg_idct_islow_dc(j_decompress_ptr cinfo, jpeg_component_info* compptr,
+    JCOEFPTR coef_block,
+    JSAMPARRAY output_buf, JDIMENSION output_col)
+{
+    ISLOW_MULT_TYPE* quantptr = (ISLOW_MULT_TYPE*)compptr->dct_table;
+    JSAMPLE* range_limit = IDCT_range_limit(cinfo);
+    JSAMPROW outptr;
+    int dcval, ctr;
+    JSAMPLE outval;
+    SHIFT_TEMPS
+
+    /* Pass 1 leaves dcval in the first row of the work array, zero elsewhere;
+     * pass 2 turns each row into dcval descaled.
+     */
+    dcval = DEQUANTIZE(coef_block[0], quantptr[0]) << PASS1_BITS;
+    outval = range_limit[(int)DESCALE((INT32)dcval, PASS1_BITS + 3)
+        & RANGE_MASK];
+
+    for (ctr = 0; ctr < DCTSIZE; ctr++) {
+        outptr = output_buf[ctr] + output_col;
+        outptr[0] = outval;
+        outptr[1] = outval;
+        outptr[2] = outval;
+        outptr[3] = outval;
+        outptr[4] = outval;
+        outptr[5] = outval;
+        outptr[6] = outval;
+        outptr[7] = outval;
+    }
+}
+
+
+/* Block with nonzero coefficients only in the top-left 2x2 corner */
+
+GLOBAL(void)
+jpeg_idct_islow_sparse2(j_decompress_ptr cinfo, jpeg_component_info* compptr,
+    JCOEFPTR coef_block,
+    JSAMPARRAY output_buf, JDIMENSION output_col)
+{
+    INT32 tmp0, tmp1, tmp2, tmp3, tmp10;
+    INT32 z1, z3, z4;
+    JCOEFPTR inptr;
+    ISLOW_MULT_TYPE* quantptr;
+    int* wsptr;
+    JSAMPROW outptr;
+    JSAMPLE* range_limit = IDCT_range_limit(cinfo);
+    int ctr;
+    int workspace[DCTSIZE2];	/* buffers data between passes */
+    SHIFT_TEMPS
+
+    /* Pass 1: process the two nonzero columns, inputs y0 and y1 only.
+     * Columns 2..7 of the work array would be zero and are never read.
+     */
+    inptr = coef_block;
+    quantptr = (ISLOW_MULT_TYPE*)compptr->dct_table;
+    wsptr = workspace;
+    for (ctr = 2; ctr > 0; ctr--) {
+        /* Even part: only y0 */
+        tmp10 = ((INT32)DEQUANTIZE(inptr[DCTSIZE * 0], quantptr[DCTSIZE * 0]))
+            << CONST_BITS;
+
+        /* Odd part: only y1, so z1 = z4 = y1 and z2 = z3 = 0 before scaling */
+        tmp3 = DEQUANTIZE(inptr[DCTSIZE * 1], quantptr[DCTSIZE * 1]);
+        z3 = MULTIPLY(tmp3, FIX_1_175875602); /* z5 */
+        z1 = MULTIPLY(tmp3, -FIX_0_899976223);
+        z4 = MULTIPLY(tmp3, -FIX_0_390180644) + z3;
+        tmp3 = MULTIPLY(tmp3, FIX_1_501321110) + z1 + z4;
+        tmp0 = z1 + z3;
+        tmp1 = z4;
+        tmp2 = z3;
+
+        wsptr[DCTSIZE * 0] = (int)DESCALE(tmp10 + tmp3, CONST_BITS - PASS1_BITS);
+        wsptr[DCTSIZE * 7] = (int)DESCALE(tmp10 - tmp3, CONST_BITS - PASS1_BITS);
+        wsptr[DCTSIZE * 1] = (int)DESCALE(tmp10 + tmp2, CONST_BITS - PASS1_BITS);
+        wsptr[DCTSIZE * 6] = (int)DESCALE(tmp10 - tmp2, CONST_BITS - PASS1_BITS);
+        wsptr[DCTSIZE * 2] = (int)DESCALE(tmp10 + tmp1, CONST_BITS - PASS1_BITS);
+        wsptr[DCTSIZE * 5] = (int)DESCALE(tmp10 - tmp1, CONST_BITS - PASS1_BITS);
+        wsptr[DCTSIZE * 3] = (int)DESCALE(tmp10 + tmp0, CONST_BITS - PASS1_BITS);
+        wsptr[DCTSIZE * 4] = (int)DESCALE(tmp10 - tmp0, CONST_BITS - PASS1_BITS);
+
+        inptr++;			/* advance pointers to next column */
+        quantptr++;
+        wsptr++;
+    }
+
+    /* Pass 2: process rows from work array, inputs wsptr[0] and [1] only. */
+
+    wsptr = workspace;
+    for (ctr = 0; ctr < DCTSIZE; ctr++) {
+        outptr = output_buf[ctr] + output_col;
+
+        tmp10 = ((INT32)wsptr[0]) << CONST_BITS;
+
+        tmp3 = (INT32)wsptr[1];
+        z3 = MULTIPLY(tmp3, FIX_1_175875602);
+        z1 = MULTIPLY(tmp3, -FIX_0_899976223);
+        z4 = MULTIPLY(tmp3, -FIX_0_390180644) + z3;
+        tmp3 = MULTIPLY(tmp3, FIX_1_501321110) + z1 + z4;
+        tmp0 = z1 + z3;
+        tmp1 = z4;
+        tmp2 = z3;
+
+        outptr[0] = range_limit[(int)DESCALE(tmp10 + tmp3,
+            CONST_BITS + PASS1_BITS + 3)
+            & RANGE_MASK];
+        outptr[7] = range_limit[(int)DESCALE(tmp10 - tmp3,
+            CONST_BITS + PASS1_BITS + 3)
+            & RANGE_MASK];
+        outptr[1] = range_limit[(int)DESCALE(tmp10 + tmp2,
+            CONST_BITS + PASS1_BITS + 3)
+            & RANGE_MASK];
+        outptr[6] = range_limit[(int)DESCALE(tmp10 - tmp2,
+            CONST_BITS + PASS1_BITS + 3)
+            & RANGE_MASK];
+        outptr[2] = range_limit[(int)DESCALE(tmp10 + tmp1,
+            CONST_BITS + PASS1_BITS + 3)
+            & RANGE_MASK];
+        outptr[5] = range_limit[(int)DESCALE(tmp10 - tmp1,
+            CONST_BITS + PASS1_BITS + 3)
+            & RANGE_MASK];
+        outptr[3] = range_limit[(int)DESCALE(tmp10 + tmp0,
+            CONST_BITS + PASS1_BITS + 3)
+            & RANGE_MASK];
+        outptr[4] = range_limit[(int)DESCALE(tmp10 - tmp0,
+            CONST_BITS + PASS1_BITS + 3)
+            & RANGE_MASK];
+
+        wsptr += DCTSIZE;		/* advance pointer to next row */
+    }
+}
+
+
+/* Block with nonzero coefficients only in the top-left 4x4 corner */
+
+GLOBAL(void)
+jpeg_idct_islow_sparse4(j_decompress_ptr cinfo, jpeg_component_info* compptr,
+    JCOEFPTR coef_block,
+    JSAMPARRAY output_buf, JDIMENSION output_col)
+{
+    INT32 tmp0, tmp1, tmp2, tmp3;
+    INT32 tmp10, tmp11, tmp12, tmp13;
+    INT32 z1, z2, z3, z4, z5;
+    JCOEFPTR inptr;
+    ISLOW_MULT_TYPE* quantptr;
+    int* wsptr;
+    JSAMPROW outptr;
+    JSAMPLE* range_limit = IDCT_range_limit(cinfo);
+    int ctr;
+    int workspace[DCTSIZE2];	/* buffers data between passes */
+    SHIFT_TEMPS
+
+    /* Pass 1: process the four nonzero columns, inputs y0..y3 only.
+     * Columns 4..7 of the work array would be zero and are never read.
+     */
+    inptr = coef_block;
+    quantptr = (ISLOW_MULT_TYPE*)compptr->dct_table;
+    wsptr = workspace;
+    for (ctr = 4; ctr > 0; ctr--) {
+        if (inptr[DCTSIZE * 1] == 0 && inptr[DCTSIZE * 2] == 0 &&
+            inptr[DCTSIZE * 3] == 0) {
+            /* AC terms all zero */
+            int dcval = DEQUANTIZE(inptr[DCTSIZE * 0], quantptr[DCTSIZE * 0]) << PASS1_BITS;
+
+            wsptr[DCTSIZE * 0] = dcval;
+            wsptr[DCTSIZE * 1] = dcval;
+            wsptr[DCTSIZE * 2] = dcval;
+            wsptr[DCTSIZE * 3] = dcval;
+            wsptr[DCTSIZE * 4] = dcval;
+            wsptr[DCTSIZE * 5] = dcval;
+            wsptr[DCTSIZE * 6] = dcval;
+            wsptr[DCTSIZE * 7] = dcval;
+
+            inptr++;			/* advance pointers to next column */
+            quantptr++;
+            wsptr++;
+            continue;
+        }
+
+        /* Even part: y4 and y6 are zero */
+
+        z2 = DEQUANTIZE(inptr[DCTSIZE * 2], quantptr[DCTSIZE * 2]);
+
+        z1 = MULTIPLY(z2, FIX_0_541196100);
+        tmp2 = z1;
+        tmp3 = z1 + MULTIPLY(z2, FIX_0_765366865);
+
+        tmp0 = ((INT32)DEQUANTIZE(inptr[DCTSIZE * 0], quantptr[DCTSIZE * 0]))
+            << CONST_BITS;
+
+        tmp10 = tmp0 + tmp3;
+        tmp13 = tmp0 - tmp3;
+        tmp11 = tmp0 + tmp2;
+        tmp12 = tmp0 - tmp2;
+
+        /* Odd part: y5 and y7 are zero */
+
+        tmp2 = DEQUANTIZE(inptr[DCTSIZE * 3], quantptr[DCTSIZE * 3]);
+        tmp3 = DEQUANTIZE(inptr[DCTSIZE * 1], quantptr[DCTSIZE * 1]);
+
+        z5 = MULTIPLY(tmp2 + tmp3, FIX_1_175875602); /* sqrt(2) * c3 */
+
+        z1 = MULTIPLY(tmp3, -FIX_0_899976223); /* sqrt(2) * (c7-c3) */
+        z2 = MULTIPLY(tmp2, -FIX_2_562915447); /* sqrt(2) * (-c1-c3) */
+        z3 = MULTIPLY(tmp2, -FIX_1_961570560) + z5; /* sqrt(2) * (-c3-c5) */
+        z4 = MULTIPLY(tmp3, -FIX_0_390180644) + z5; /* sqrt(2) * (c5-c3) */
+        tmp2 = MULTIPLY(tmp2, FIX_3_072711026); /* sqrt(2) * ( c1+c3+c5-c7) */
+        tmp3 = MULTIPLY(tmp3, FIX_1_501321110); /* sqrt(2) * ( c1+c3-c5-c7) */
+
+        tmp0 = z1 + z3;
+        tmp1 = z2 + z4;
+        tmp2 += z2 + z3;
+        tmp3 += z1 + z4;
+
+        wsptr[DCTSIZE * 0] = (int)DESCALE(tmp10 + tmp3, CONST_BITS - PASS1_BITS);
+        wsptr[DCTSIZE * 7] = (int)DESCALE(tmp10 - tmp3, CONST_BITS - PASS1_BITS);
+        wsptr[DCTSIZE * 1] = (int)DESCALE(tmp11 + tmp2, CONST_BITS - PASS1_BITS);
+        wsptr[DCTSIZE * 6] = (int)DESCALE(tmp11 - tmp2, CONST_BITS - PASS1_BITS);
+        wsptr[DCTSIZE * 2] = (int)DESCALE(tmp12 + tmp1, CONST_BITS - PASS1_BITS);
+        wsptr[DCTSIZE * 5] = (int)DESCALE(tmp12 - tmp1, CONST_BITS - PASS1_BITS);
+        wsptr[DCTSIZE * 3] = (int)DESCALE(tmp13 + tmp0, CONST_BITS - PASS1_BITS);
+        wsptr[DCTSIZE * 4] = (int)DESCALE(tmp13 - tmp0, CONST_BITS - PASS1_BITS);
+
+        inptr++;			/* advance pointers to next column */
+        quantptr++;
+        wsptr++;
+    }
+
+    /* Pass 2: process rows from work array, inputs wsptr[0..3] only. */
+
+    wsptr = workspace;
+    for (ctr = 0; ctr < DCTSIZE; ctr++) {
+        outptr = output_buf[ctr] + output_col;
+
+#ifndef NO_ZERO_ROW_TEST
+        if (wsptr[1] == 0 && wsptr[2] == 0 && wsptr[3] == 0) {
+            /* AC terms all zero */
+            JSAMPLE dcval = range_limit[(int)DESCALE((INT32)wsptr[0], PASS1_BITS + 3)
+                & RANGE_MASK];
+
+            outptr[0] = dcval;
+            outptr[1] = dcval;
+            outptr[2] = dcval;
+            outptr[3] = dcval;
+            outptr[4] = dcval;
+            outptr[5] = dcval;
+            outptr[6] = dcval;
+            outptr[7] = dcval;
+
+            wsptr += DCTSIZE;		/* advance pointer to next row */
+            continue;
+        }
+#endif
+
+        /* Even part */
+
+        z2 = (INT32)wsptr[2];
+
+        z1 = MULTIPLY(z2, FIX_0_541196100);
+        tmp2 = z1;
+        tmp3 = z1 + MULTIPLY(z2, FIX_0_765366865);
+
+        tmp0 = ((INT32)wsptr[0]) << CONST_BITS;
+
+        tmp10 = tmp0 + tmp3;
+        tmp13 = tmp0 - tmp3;
+        tmp11 = tmp0 + tmp2;
+        tmp12 = tmp0 - tmp2;
+
+        /* Odd part */
+
+        tmp2 = (INT32)wsptr[3];
+        tmp3 = (INT32)wsptr[1];
+
+        z5 = MULTIPLY(tmp2 + tmp3, FIX_1_175875602);
+
+        z1 = MULTIPLY(tmp3, -FIX_0_899976223);
+        z2 = MULTIPLY(tmp2, -FIX_2_562915447);
+        z3 = MULTIPLY(tmp2, -FIX_1_961570560) + z5;
+        z4 = MULTIPLY(tmp3, -FIX_0_390180644) + z5;
+        tmp2 = MULTIPLY(tmp2, FIX_3_072711026);
+        tmp3 = MULTIPLY(tmp3, FIX_1_501321110);
+
+        tmp0 = z1 + z3;
+        tmp1 = z2 + z4;
+        tmp2 += z2 + z3;
+        tmp3 += z1 + z4;
+
+        outptr[0] = range_limit[(int)DESCALE(tmp10 + tmp3,
+            CONST_BITS + PASS1_BITS + 3)
+            & RANGE_MASK];
+        outptr[7] = range_limit[(int)DESCALE(tmp10 - tmp3,
+            CONST_BITS + PASS1_BITS + 3)
+            & RANGE_MASK];
+        outptr[1] = range_limit[(int)DESCALE(tmp11 + tmp2,
+            CONST_BITS + PASS1_BITS + 3)
+            & RANGE_MASK];
+        outptr[6] = range_limit[(int)DESCALE(tmp11 - tmp2,
+            CONST_BITS + PASS1_BITS + 3)
+            & RANGE_MASK];
+        outptr[2] = range_limit[(int)DESCALE(tmp12 + tmp1,
+            CONST_BITS + PASS1_BITS + 3)
+            & RANGE_MASK];
+        outptr[5] = range_limit[(int)DESCALE(tmp12 - tmp1,
+            CONST_BITS + PASS1_BITS + 3)
+            & RANGE_MASK];
+        outptr[3] = range_limit[(int)DESCALE(tmp13 + tmp0,
+            CONST_BITS + PASS1_BITS + 3)
+            & RANGE_MASK];
+        outptr[4] = range_limit[(int)DESCALE(tmp13 - tmp0,
+            CONST_BITS + PASS1_BITS + 3)
+            & RANGE_MASK];
+
+        wsptr += DCTSIZE;		/* advance pointer to next row */
+    }
+}
+
 #endif /* DCT_ISLOW_SUPPORTED */
@@ -6,7 +6,7 @@
  * For conditions of distribution and use, see the accompanying README file.
  *
  * This file contains inverse-DCT routines that produce reduced-size output:
- * either 4x4, 2x2, or 1x1 pixels from an 8x8 DCT block.
+ * anything from 7x7 down to 1x1 pixels from an 8x8 DCT block.
  *
  * The implementation is based on the Loeffler, Ligtenberg and Moschytz (LL&M)
  * algorithm used in jidctint.c.  We simply replace each 8-to-8 1-D IDCT step
@@ -17,6 +17,9 @@
  *
  * 1x1 is trivial: just take the DC coefficient divided by 8.
  *
+ * The other sizes (7x7, 6x6, 5x5, 3x3) use a direct N-point IDCT of the
+ * low-frequency coefficients; see idct_NxN.
+ *
  * See jidctint.c for additional comments.
  */
 
@@ -370,6 +373,280 @@ jpeg_idct_2x2(j_decompress_ptr cinfo, jpeg_component_info* compptr,
 }
 
 
+/*
+ * The remaining sizes (7x7, 6x6, 5x5 and 3x3) have no neat relation to the
+ * 8-point transform, so they use a plain N-point IDCT of the top-left NxN
+ * coefficients.  This samples the same continuous reconstruction as the
+ * full-size IDCT, at the N points (2n+1)/2N of the block instead of eight.
+ * Outputs n and N-1-n share the even- and odd-numbered terms with opposite
+ * signs, so each table holds only the first (N+1)/2 output rows:
+ *   entry [n][k] = c(k) * cos((2n+1)*k*pi / (2N)) * 2^CONST_BITS
+ * with c(0) = 1 and c(k) = sqrt(2) otherwise, which gives the same overall
+ * scaling as jidctint.c (the outputs are descaled by 8 at the end).
+ */
+
+static const INT32 idct_3_cos[2 * 3] = {
+    8192, 10033, 5793,
+    8192, 0, -11585
+};
+
+static const INT32 idct_5_cos[3 * 5] = {
+    8192, 11018, 9373, 6810, 3580,
+    8192, 6810, -3580, -11018, -9373,
+    8192, 0, -11585, 0, 11585
+};
+
+static const INT32 idct_6_cos[3 * 6] = {
+    8192, 11190, 10033, 8192, 5793, 2998,
+    8192, 8192, 0, -8192, -11585, -8192,
+    8192, 2998, -10033, -8192, 5793, 11190
+};
+
+static const INT32 idct_7_cos[4 * 7] = {
+    8192, 11295, 10438, 9058, 7223, 5027, 2578,
+    8192, 9058, 2578, -5027, -10438, -11295, -7223,
+    8192, 5027, -7223, -11295, -2578, 9058, 10438,
+    8192, 0, -11585, 0, 11585, 0, -11585
+};
+
+
+/* Sum the even- and the odd-numbered terms of one output of an N-point
+ * IDCT whose inputs past the first ncoef are zero (2 <= ncoef <= N).
+ * ncoef is a constant wherever this is used, so the tests fold away.
+ */
+
+#define IDCT_N_SUMS(in,cosptr,ncoef) { \
+    tmpeven = MULTIPLY(in(0), (cosptr)[0]); \
+    if ((ncoef) > 2) tmpeven += MULTIPLY(in(2), (cosptr)[2]); \
+    if ((ncoef) > 4) tmpeven += MULTIPLY(in(4), (cosptr)[4]); \
+    if ((ncoef) > 6) tmpeven += MULTIPLY(in(6), (cosptr)[6]); \
+    tmpodd = MULTIPLY(in(1), (cosptr)[1]); \
+    if ((ncoef) > 3) tmpodd += MULTIPLY(in(3), (cosptr)[3]); \
+    if ((ncoef) > 5) tmpodd += MULTIPLY(in(5), (cosptr)[5]); \
+  }
+
+
+/*
+ * Perform dequantization and an N-point inverse DCT on one block of
+ * coefficients, producing a reduced-size NxN output block.  Only the
+ * top-left ncoef x ncoef coefficients are examined; the sparse variants
+ * pass a smaller ncoef when block_last says the rest are zero.  This is
+ * inlined into each caller, so that size and ncoef are constants there.
+ */
+
+INLINE
+LOCAL(void)
+idct_NxN(j_decompress_ptr cinfo, jpeg_component_info* compptr,
+    JCOEFPTR coef_block,
+    JSAMPARRAY output_buf, JDIMENSION output_col,
+    int size, const INT32* costab, int ncoef)
+{
+    INT32 tmpeven, tmpodd;
+    INT32 z[DCTSIZE - 1];
+    JCOEFPTR inptr;
+    ISLOW_MULT_TYPE* quantptr;
+    const INT32* cosptr;
+    int* wsptr;
+    JSAMPROW outptr;
+    JSAMPLE* range_limit = IDCT_range_limit(cinfo);
+    int ctr, n, k;
+    int workspace[DCTSIZE * (DCTSIZE - 1)];	/* buffers data between passes */
+    SHIFT_TEMPS
+
+        /* Pass 1: process columns from input, store into work array. */
+        /* Columns past ncoef are all zero; pass 2 never looks at them. */
+
+        inptr = coef_block;
+    quantptr = (ISLOW_MULT_TYPE*)compptr->dct_table;
+    wsptr = workspace;
+    for (ctr = 0; ctr < ncoef; inptr++, quantptr++, wsptr++, ctr++) {
+        for (k = 1; k < ncoef; k++) {
+            if (inptr[DCTSIZE * k] != 0)
+                break;
+        }
+        if (k == ncoef) {
+            /* AC terms all zero */
+            int dcval = DEQUANTIZE(inptr[DCTSIZE * 0], quantptr[DCTSIZE * 0]) << PASS1_BITS;
+
+            for (n = 0; n < size; n++)
+                wsptr[DCTSIZE * n] = dcval;
+            continue;
+        }
+
+        for (k = 0; k < ncoef; k++)
+            z[k] = DEQUANTIZE(inptr[DCTSIZE * k], quantptr[DCTSIZE * k]);
+
+#define IDCT_N_COLUMN(k)  z[k]
+        for (n = 0, cosptr = costab; n < (size + 1) / 2; n++, cosptr += size) {
+            IDCT_N_SUMS(IDCT_N_COLUMN, cosptr, ncoef);
+
+            /* For odd N the middle output is stored twice; its odd part is 0 */
+            wsptr[DCTSIZE * n] = (int)DESCALE(tmpeven + tmpodd, CONST_BITS - PASS1_BITS);
+            wsptr[DCTSIZE * (size - 1 - n)] =
+                (int)DESCALE(tmpeven - tmpodd, CONST_BITS - PASS1_BITS);
+        }
+#undef IDCT_N_COLUMN
+    }
+
+    /* Pass 2: process N rows from work array, store into output array. */
+
+    wsptr = workspace;
+    for (ctr = 0; ctr < size; ctr++) {
+        outptr = output_buf[ctr] + output_col;
+
+#ifndef NO_ZERO_ROW_TEST
+        for (k = 1; k < ncoef; k++) {
+            if (wsptr[k] != 0)
+                break;
+        }
+        if (k == ncoef) {
+            /* AC terms all zero */
+            JSAMPLE dcval = range_limit[(int)DESCALE((INT32)wsptr[0], PASS1_BITS + 3)
+                & RANGE_MASK];
+
+            for (n = 0; n < size; n++)
+                outptr[n] = dcval;
+
+            wsptr += DCTSIZE;		/* advance pointer to next row */
+            continue;
+        }
+#endif
+
+#define IDCT_N_ROW(k)  ((INT32) wsptr[k])
+        for (n = 0, cosptr = costab; n < (size + 1) / 2; n++, cosptr += size) {
+            IDCT_N_SUMS(IDCT_N_ROW, cosptr, ncoef);
+
+            outptr[n] = range_limit[(int)DESCALE(tmpeven + tmpodd,
+                CONST_BITS + PASS1_BITS + 3)
+                & RANGE_MASK];
+            outptr[size - 1 - n] = range_limit[(int)DESCALE(tmpeven - tmpodd,
+                CONST_BITS + PASS1_BITS + 3)
+                & RANGE_MASK];
+        }
+#undef IDCT_N_ROW
+
+        wsptr += DCTSIZE;		/* advance pointer to next row */
+    }
+}
+
+
+/*
+ * Produce reduced-size 7x7, 6x6, 5x5 or 3x3 output blocks.
+ */
+
+GLOBAL(void)
+jpeg_idct_7x7(j_decompress_ptr cinfo, jpeg_component_info* compptr,
+    JCOEFPTR coef_block,
+    JSAMPARRAY output_buf, JDIMENSION output_col)
+{
+    idct_NxN(cinfo, compptr, coef_block, output_buf, output_col, 7, idct_7_cos, 7);
+}
+
+GLOBAL(void)
+jpeg_idct_6x6(j_decompress_ptr cinfo, jpeg_component_info* compptr,
+    JCOEFPTR coef_block,
+    JSAMPARRAY output_buf, JDIMENSION output_col)
+{
+    idct_NxN(cinfo, compptr, coef_block, output_buf, output_col, 6, idct_6_cos, 6);
+}
+
+GLOBAL(void)
+jpeg_idct_5x5(j_decompress_ptr cinfo, jpeg_component_info* compptr,
+    JCOEFPTR coef_block,
+    JSAMPARRAY output_buf, JDIMENSION output_col)
+{
+    idct_NxN(cinfo, compptr, coef_block, output_buf, output_col, 5, idct_5_cos, 5);
+}
+
+GLOBAL(void)
+jpeg_idct_3x3(j_decompress_ptr cinfo, jpeg_component_info* compptr,
+    JCOEFPTR coef_block,
+    JSAMPARRAY output_buf, JDIMENSION output_col)
+{
+    idct_NxN(cinfo, compptr, coef_block, output_buf, output_col, 3, idct_3_cos, 3);
+}
+
+
+/*
+ * Variants of the 7x7, 6x6, 5x5 and 3x3 routines for sparse blocks (see
+ * IDCT_SPARSE_CLASS in jpegint.h); each routine serves all the sizes it is
+ * selected for.  A 3x3 block has nothing to gain from the 4x4 variant.
+ */
+
+GLOBAL(void)
+jpeg_idct_NxN_sparse4(j_decompress_ptr cinfo, jpeg_component_info* compptr,
+    JCOEFPTR coef_block,
+    JSAMPARRAY output_buf, JDIMENSION output_col)
+{
+    switch (compptr->DCT_scaled_size) {
+    case 7:
+        idct_NxN(cinfo, compptr, coef_block, output_buf, output_col, 7, idct_7_cos, 4);
+        break;
+    case 6:
+        idct_NxN(cinfo, compptr, coef_block, output_buf, output_col, 6, idct_6_cos, 4);
+        break;
+    default:			/* 5 */
+        idct_NxN(cinfo, compptr, coef_block, output_buf, output_col, 5, idct_5_cos, 4);
+        break;
+    }
+}
+
+GLOBAL(void)
+jpeg_idct_NxN_sparse2(j_decompress_ptr cinfo, jpeg_component_info* compptr,
+    JCOEFPTR coef_block,
+    JSAMPARRAY output_buf, JDIMENSION output_col)
+{
+    switch (compptr->DCT_scaled_size) {
+    case 7:
+        idct_NxN(cinfo, compptr, coef_block, output_buf, output_col, 7, idct_7_cos, 2);
+        break;
+    case 6:
+        idct_NxN(cinfo, compptr, coef_block, output_buf, output_col, 6, idct_6_cos, 2);
+        break;
+    case 5:
+        idct_NxN(cinfo, compptr, coef_block, output_buf, output_col, 5, idct_5_cos, 2);
+        break;
+    default:			/* 3 */
+        idct_NxN(cinfo, compptr, coef_block, output_buf, output_col, 3, idct_3_cos, 2);
+        break;
+    }
+}
+
+
+/*
+ * Produce a reduced-size NxN output block, for any N from 2 to 7, from a
+ * block whose AC terms are all zero.  The result is the same as what the
+ * routine for that size would produce, namely the DC coefficient divided
+ * by 8 (compare jpeg_idct_1x1).
+ */
+
+GLOBAL(void)
+jpeg_idct_NxN_dc(j_decompress_ptr cinfo, jpeg_component_info* compptr,
+    JCOEFPTR coef_block,
+    JSAMPARRAY output_buf, JDIMENSION output_col)
+{
+    int dcval;
+    JSAMPLE outval;
+    ISLOW_MULT_TYPE* quantptr;
+    JSAMPROW outptr;
+    JSAMPLE* range_limit = IDCT_range_limit(cinfo);
+    int size = compptr->DCT_scaled_size;
+    int ctr, n;
+    SHIFT_TEMPS
+
+        quantptr = (ISLOW_MULT_TYPE*)compptr->dct_table;
+    dcval = DEQUANTIZE(coef_block[0], quantptr[0]);
+    dcval = (int)DESCALE((INT32)dcval, 3);
+    outval = range_limit[dcval & RANGE_MASK];
+
+    for (ctr = 0; ctr < size; ctr++) {
+        outptr = output_buf[ctr] + output_col;
+        for (n = 0; n < size; n++)
+            outptr[n] = outval;
+    }
+}
+
+
 /*
  * Perform dequantization and inverse DCT on one block of coefficients,
  * producing a reduced-size 1x1 output block.
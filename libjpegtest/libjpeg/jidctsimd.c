@@ -0,0 +1,494 @@
+/*
+ * jidctsimd.c
+ *
+ * Based on jidctint.c.
+ *
+ * This file contains SSE2 and AVX2 versions of the slow-but-accurate
+ * integer inverse DCT in jidctint.c.  They perform the same dequantization,
+ * the same two passes (columns, then rows) and the same range limiting,
+ * and produce exactly the same output.
+ *
+ * Every output of a 1-D pass is a sum of the eight inputs times constants.
+ * jidctint.c forms it through shared partial products; here each output is
+ * gathered from pairs of inputs times combined constants with pmaddwd
+ * (16x16->32 bit multiply and add).  The sums are mathematically identical,
+ * so the results agree bit for bit, provided the inputs of each pass fit
+ * in 16 bits.  That holds for any sensible JPEG file; blocks of corrupt
+ * data that break it are handed to jpeg_idct_islow instead.
+ */
+
+#define JPEG_INTERNALS
+#include "jinclude.h"
+#include "jpeglib.h"
+#include "jdct.h"		/* Private declarations for DCT subsystem */
+#include "jsimd.h"
+
+#if defined(JSIMD_X86) && defined(DCT_ISLOW_SUPPORTED)
+
+#include <emmintrin.h>
+#include <immintrin.h>
+
+
+/*
+ * This module is specialized to the case DCTSIZE = 8 and 8-bit samples.
+ */
+
+#if DCTSIZE != 8
+Sorry, this code only copes with 8x8 DCTs. /* deliberate syntax err */
+#endif
+#if BITS_IN_JSAMPLE != 8
+Sorry, this code only copes with 8-bit samples. /* deliberate syntax err */
+#endif
+
+
+/* Scaling and constants as in jidctint.c */
+
+#define CONST_BITS  13
+#define PASS1_BITS  2
+
+#define FIX_0_298631336  2446
+#define FIX_0_390180644  3196
+#define FIX_0_541196100  4433
+#define FIX_0_765366865  6270
+#define FIX_0_899976223  7373
+#define FIX_1_175875602  9633
+#define FIX_1_501321110  12299
+#define FIX_1_847759065  15137
+#define FIX_1_961570560  16069
+#define FIX_2_053119869  16819
+#define FIX_2_562915447  20995
+#define FIX_3_072711026  25172
+
+/* Odd part: the multiplier of each input y1,y3,y5,y7 in each of the odd
+ * results tmp0..tmp3 of jidctint.c.  Every result collects its own
+ * multiplier, those of z1..z4 for the inputs it depends on, and z5.
+ */
+
+#define ODD0_Y1  (FIX_1_175875602 - FIX_0_899976223)
+#define ODD0_Y3  (FIX_1_175875602 - FIX_1_961570560)
+#define ODD0_Y5  FIX_1_175875602
+#define ODD0_Y7  (FIX_0_298631336 - FIX_0_899976223 - FIX_1_961570560 + \
+		  FIX_1_175875602)
+#define ODD1_Y1  (FIX_1_175875602 - FIX_0_390180644)
+#define ODD1_Y3  (FIX_1_175875602 - FIX_2_562915447)
+#define ODD1_Y5  (FIX_2_053119869 - FIX_2_562915447 - FIX_0_390180644 + \
+		  FIX_1_175875602)
+#define ODD1_Y7  FIX_1_175875602
+#define ODD2_Y1  FIX_1_175875602
+#define ODD2_Y3  (FIX_3_072711026 - FIX_2_562915447 - FIX_1_961570560 + \
+		  FIX_1_175875602)
+#define ODD2_Y5  (FIX_1_175875602 - FIX_2_562915447)
+#define ODD2_Y7  (FIX_1_175875602 - FIX_1_961570560)
+#define ODD3_Y1  (FIX_1_501321110 - FIX_0_899976223 - FIX_0_390180644 + \
+		  FIX_1_175875602)
+#define ODD3_Y3  FIX_1_175875602
+#define ODD3_Y5  (FIX_1_175875602 - FIX_0_390180644)
+#define ODD3_Y7  (FIX_1_175875602 - FIX_0_899976223)
+
+
+/* Inputs are paired by unpacking two rows against each other; the pairs
+ * are (y0,y4), (y2,y6), (y1,y5) and (y3,y7).
+ */
+
+/* Even part: tmp0, tmp1 from (y0,y4) and tmp2, tmp3 from (y2,y6) */
+#define K04_TMP0  PAIR(1 << CONST_BITS, 1 << CONST_BITS)
+#define K04_TMP1  PAIR(1 << CONST_BITS, -(1 << CONST_BITS))
+#define K26_TMP2  PAIR(FIX_0_541196100, FIX_0_541196100 - FIX_1_847759065)
+#define K26_TMP3  PAIR(FIX_0_541196100 + FIX_0_765366865, FIX_0_541196100)
+/* Odd part */
+#define K15_TMP0  PAIR(ODD0_Y1, ODD0_Y5)
+#define K37_TMP0  PAIR(ODD0_Y3, ODD0_Y7)
+#define K15_TMP1  PAIR(ODD1_Y1, ODD1_Y5)
+#define K37_TMP1  PAIR(ODD1_Y3, ODD1_Y7)
+#define K15_TMP2  PAIR(ODD2_Y1, ODD2_Y5)
+#define K37_TMP2  PAIR(ODD2_Y3, ODD2_Y7)
+#define K15_TMP3  PAIR(ODD3_Y1, ODD3_Y5)
+#define K37_TMP3  PAIR(ODD3_Y3, ODD3_Y7)
+
+
+/*
+ * Range limiting.  The C code indexes range_limit[] with the descaled
+ * value masked to 10 bits (RANGE_MASK); that table maps the 10 bits, read
+ * as a signed number s, to s + CENTERJSAMPLE clamped to 0..MAXJSAMPLE.
+ * Shifting the undescaled sum left by RANGE_SHIFT, then arithmetically
+ * right by PASS2_BITS + RANGE_SHIFT leaves exactly that signed 10-bit s;
+ * the clamp comes from the saturating pack to bytes.
+ */
+
+#define PASS2_BITS   (CONST_BITS + PASS1_BITS + 3)
+#define RANGE_SHIFT  (32 - 10 - PASS2_BITS)
+
+
+/*
+ * SSE2 version.  One vector holds a row of the block; the 1-D passes
+ * work on all eight columns at once, four lanes per pmaddwd.
+ */
+
+/*
+ * Dequantize a block into eight rows of 16-bit values.
+ * Returns false if some product does not fit in 16 bits.
+ */
+
+JSIMD_INLINE JSIMD_TARGET_SSE2
+LOCAL(bool)
+dequantize_sse2(JCOEFPTR coef_block, INT16* quantptr, __m128i* r)
+{
+    __m128i coef, quant, prodlo, prodhi;
+    __m128i bad = _mm_setzero_si128();
+    int i;
+
+    for (i = 0; i < DCTSIZE; i++) {
+        coef = _mm_loadu_si128((const __m128i*)(coef_block + DCTSIZE * i));
+        quant = _mm_loadu_si128((const __m128i*)(quantptr + DCTSIZE * i));
+        prodlo = _mm_mullo_epi16(coef, quant);
+        prodhi = _mm_mulhi_epi16(coef, quant);
+        /* The product fits iff its high half is the sign of its low half */
+        bad = _mm_or_si128(bad,
+            _mm_xor_si128(prodhi, _mm_srai_epi16(prodlo, 15)));
+        r[i] = prodlo;
+    }
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(bad, _mm_setzero_si128())) == 0xFFFF;
+}
+
+
+/*
+ * 1-D IDCT of four lanes.  x04, x26, x15 and x37 hold the input pairs
+ * named by their suffixes; out[] receives the undescaled outputs 0..7.
+ */
+
+JSIMD_INLINE JSIMD_TARGET_SSE2
+LOCAL(void)
+idct_1d_sse2(__m128i x04, __m128i x26, __m128i x15, __m128i x37,
+    __m128i* out)
+{
+    __m128i tmp0, tmp1, tmp2, tmp3, tmp10, tmp11, tmp12, tmp13;
+
+    /* Even part */
+    tmp0 = _mm_madd_epi16(x04, _mm_set1_epi32(K04_TMP0));
+    tmp1 = _mm_madd_epi16(x04, _mm_set1_epi32(K04_TMP1));
+    tmp2 = _mm_madd_epi16(x26, _mm_set1_epi32(K26_TMP2));
+    tmp3 = _mm_madd_epi16(x26, _mm_set1_epi32(K26_TMP3));
+
+    tmp10 = _mm_add_epi32(tmp0, tmp3);
+    tmp13 = _mm_sub_epi32(tmp0, tmp3);
+    tmp11 = _mm_add_epi32(tmp1, tmp2);
+    tmp12 = _mm_sub_epi32(tmp1, tmp2);
+
+    /* Odd part */
+    tmp0 = _mm_add_epi32(_mm_madd_epi16(x15, _mm_set1_epi32(K15_TMP0)),
+        _mm_madd_epi16(x37, _mm_set1_epi32(K37_TMP0)));
+    tmp1 = _mm_add_epi32(_mm_madd_epi16(x15, _mm_set1_epi32(K15_TMP1)),
+        _mm_madd_epi16(x37, _mm_set1_epi32(K37_TMP1)));
+    tmp2 = _mm_add_epi32(_mm_madd_epi16(x15, _mm_set1_epi32(K15_TMP2)),
+        _mm_madd_epi16(x37, _mm_set1_epi32(K37_TMP2)));
+    tmp3 = _mm_add_epi32(_mm_madd_epi16(x15, _mm_set1_epi32(K15_TMP3)),
+        _mm_madd_epi16(x37, _mm_set1_epi32(K37_TMP3)));
+
+    /* Final output stage */
+    out[0] = _mm_add_epi32(tmp10, tmp3);
+    out[7] = _mm_sub_epi32(tmp10, tmp3);
+    out[1] = _mm_add_epi32(tmp11, tmp2);
+    out[6] = _mm_sub_epi32(tmp11, tmp2);
+    out[2] = _mm_add_epi32(tmp12, tmp1);
+    out[5] = _mm_sub_epi32(tmp12, tmp1);
+    out[3] = _mm_add_epi32(tmp13, tmp0);
+    out[4] = _mm_sub_epi32(tmp13, tmp0);
+}
+
+
+/*
+ * 1-D IDCT of eight rows of 16-bit values, one lane per column.
+ * Pass 1 descales the results to 16 bits; pass 2 range-limits them to
+ * signed samples (see RANGE_SHIFT).
+ */
+
+JSIMD_INLINE JSIMD_TARGET_SSE2
+LOCAL(void)
+idct_pass_sse2(__m128i* r, bool pass1)
+{
+    __m128i lo[DCTSIZE], hi[DCTSIZE];
+    __m128i round;
+    int i;
+
+    idct_1d_sse2(_mm_unpacklo_epi16(r[0], r[4]), _mm_unpacklo_epi16(r[2], r[6]),
+        _mm_unpacklo_epi16(r[1], r[5]), _mm_unpacklo_epi16(r[3], r[7]), lo);
+    idct_1d_sse2(_mm_unpackhi_epi16(r[0], r[4]), _mm_unpackhi_epi16(r[2], r[6]),
+        _mm_unpackhi_epi16(r[1], r[5]), _mm_unpackhi_epi16(r[3], r[7]), hi);
+
+    if (pass1) {
+        round = _mm_set1_epi32(1 << (CONST_BITS - PASS1_BITS - 1));
+        for (i = 0; i < DCTSIZE; i++) {
+            lo[i] = _mm_srai_epi32(_mm_add_epi32(lo[i], round),
+                CONST_BITS - PASS1_BITS);
+            hi[i] = _mm_srai_epi32(_mm_add_epi32(hi[i], round),
+                CONST_BITS - PASS1_BITS);
+            r[i] = _mm_packs_epi32(lo[i], hi[i]);
+        }
+    }
+    else {
+        round = _mm_set1_epi32(1 << (PASS2_BITS - 1));
+        for (i = 0; i < DCTSIZE; i++) {
+            lo[i] = _mm_srai_epi32(_mm_slli_epi32(_mm_add_epi32(lo[i], round),
+                RANGE_SHIFT), PASS2_BITS + RANGE_SHIFT);
+            hi[i] = _mm_srai_epi32(_mm_slli_epi32(_mm_add_epi32(hi[i], round),
+                RANGE_SHIFT), PASS2_BITS + RANGE_SHIFT);
+            r[i] = _mm_packs_epi32(lo[i], hi[i]);
+        }
+    }
+}
+
+
+/*
+ * Perform dequantization and inverse DCT on one block of coefficients
+ * with SSE2.
+ */
+
+JSIMD_TARGET_SSE2
+GLOBAL(void)
+jpeg_idct_islow_sse2(j_decompress_ptr cinfo, jpeg_component_info * compptr,
+    JCOEFPTR coef_block,
+    JSAMPARRAY output_buf, JDIMENSION output_col)
+{
+    __m128i r[DCTSIZE];
+    __m128i vmin, vmax, out;
+    int i;
+
+    if (!dequantize_sse2(coef_block, ISLOW_SIMD_TABLE(compptr), r))
+        goto use_c;
+
+    /* Pass 1: process columns; r[] becomes the work array.
+     * Pass 2 needs it in 16 bits; a saturated pack sends the block to the
+     * C code (values legitimately at the limits do too, which is harmless).
+     */
+    idct_pass_sse2(r, true);
+    vmin = vmax = r[0];
+    for (i = 1; i < DCTSIZE; i++) {
+        vmin = _mm_min_epi16(vmin, r[i]);
+        vmax = _mm_max_epi16(vmax, r[i]);
+    }
+    if (_mm_movemask_epi8(_mm_or_si128(
+        _mm_cmpeq_epi16(vmin, _mm_set1_epi16(-0x8000)),
+        _mm_cmpeq_epi16(vmax, _mm_set1_epi16(0x7FFF)))) != 0)
+        goto use_c;
+
+    /* Pass 2: process rows, which the transpose turns into columns */
+    TRANSPOSE_8X8_EPI16(r);
+    idct_pass_sse2(r, false);
+    TRANSPOSE_8X8_EPI16(r);
+
+    for (i = 0; i < DCTSIZE; i += 2) {
+        out = _mm_packus_epi16(_mm_add_epi16(r[i], _mm_set1_epi16(CENTERJSAMPLE)),
+            _mm_add_epi16(r[i + 1], _mm_set1_epi16(CENTERJSAMPLE)));
+        _mm_storel_epi64((__m128i*)(output_buf[i] + output_col), out);
+        _mm_storeh_pd((double*)(output_buf[i + 1] + output_col),
+            _mm_castsi128_pd(out));
+    }
+    return;
+
+use_c:
+    jpeg_idct_islow(cinfo, compptr, coef_block, output_buf, output_col);
+}
+
+
+/*
+ * AVX2 version.  One vector holds two rows of the block, so the block is
+ * four vectors: rows 0|1, 2|3, 4|5 and 6|7.  Unpacking rows 0|1 against
+ * 4|5 pairs (y0,y4) in the low lane with (y1,y5) in the high lane, and
+ * 2|3 against 6|7 pairs (y2,y6) with (y3,y7); so each pmaddwd computes an
+ * even part in the low lane and an odd part in the high lane, and the
+ * two lanes are brought together for the final output stage.
+ */
+
+/* A pmaddwd constant with a for the low lane and b for the high lane */
+#define LANES(a,b)  _mm256_setr_epi32(a, a, a, a, b, b, b, b)
+
+/* Even part with the sign of tmp2 or tmp3 reversed, giving tmp12, tmp13 */
+#define K26_NTMP2  PAIR(-FIX_0_541196100, FIX_1_847759065 - FIX_0_541196100)
+#define K26_NTMP3  PAIR(-FIX_0_541196100 - FIX_0_765366865, -FIX_0_541196100)
+
+
+/*
+ * Dequantize a block into four vectors of 16-bit values.
+ * Returns false if some product does not fit in 16 bits.
+ */
+
+JSIMD_INLINE JSIMD_TARGET_AVX2
+LOCAL(bool)
+dequantize_avx2(JCOEFPTR coef_block, INT16* quantptr, __m256i* p)
+{
+    __m256i coef, quant, prodlo, prodhi;
+    __m256i bad = _mm256_setzero_si256();
+    int i;
+
+    for (i = 0; i < 4; i++) {
+        coef = _mm256_loadu_si256((const __m256i*)(coef_block + DCTSIZE * 2 * i));
+        quant = _mm256_loadu_si256((const __m256i*)(quantptr + DCTSIZE * 2 * i));
+        prodlo = _mm256_mullo_epi16(coef, quant);
+        prodhi = _mm256_mulhi_epi16(coef, quant);
+        bad = _mm256_or_si256(bad,
+            _mm256_xor_si256(prodhi, _mm256_srai_epi16(prodlo, 15)));
+        p[i] = prodlo;
+    }
+    return _mm256_testz_si256(bad, bad);
+}
+
+
+/*
+ * 1-D IDCT of a block held as four vectors of row pairs, one lane per
+ * column.  out[] receives the undescaled outputs 0..7, eight lanes each.
+ */
+
+JSIMD_INLINE JSIMD_TARGET_AVX2
+LOCAL(void)
+idct_1d_avx2(__m256i* p, __m256i* out)
+{
+    __m256i e, f, s_lo[4], s_hi[4], even, odd;
+    int half, i;
+
+    for (half = 0; half < 2; half++) {
+        __m256i* s = half ? s_hi : s_lo;
+
+        /* Columns 0..3, then 4..7 */
+        if (half == 0) {
+            e = _mm256_unpacklo_epi16(p[0], p[2]);	/* (y0,y4) | (y1,y5) */
+            f = _mm256_unpacklo_epi16(p[1], p[3]);	/* (y2,y6) | (y3,y7) */
+        }
+        else {
+            e = _mm256_unpackhi_epi16(p[0], p[2]);
+            f = _mm256_unpackhi_epi16(p[1], p[3]);
+        }
+        /* tmp10 | odd tmp3 */
+        s[0] = _mm256_add_epi32(
+            _mm256_madd_epi16(e, LANES(K04_TMP0, K15_TMP3)),
+            _mm256_madd_epi16(f, LANES(K26_TMP3, K37_TMP3)));
+        /* tmp11 | odd tmp2 */
+        s[1] = _mm256_add_epi32(
+            _mm256_madd_epi16(e, LANES(K04_TMP1, K15_TMP2)),
+            _mm256_madd_epi16(f, LANES(K26_TMP2, K37_TMP2)));
+        /* tmp12 | odd tmp1 */
+        s[2] = _mm256_add_epi32(
+            _mm256_madd_epi16(e, LANES(K04_TMP1, K15_TMP1)),
+            _mm256_madd_epi16(f, LANES(K26_NTMP2, K37_TMP1)));
+        /* tmp13 | odd tmp0 */
+        s[3] = _mm256_add_epi32(
+            _mm256_madd_epi16(e, LANES(K04_TMP0, K15_TMP0)),
+            _mm256_madd_epi16(f, LANES(K26_NTMP3, K37_TMP0)));
+    }
+
+    /* Final output stage: even +/- odd, all eight columns */
+    for (i = 0; i < 4; i++) {
+        even = _mm256_permute2x128_si256(s_lo[i], s_hi[i], 0x20);
+        odd = _mm256_permute2x128_si256(s_lo[i], s_hi[i], 0x31);
+        out[i] = _mm256_add_epi32(even, odd);
+        out[DCTSIZE - 1 - i] = _mm256_sub_epi32(even, odd);
+    }
+}
+
+
+/*
+ * Pack eight vectors of 32-bit values to 16 bits and transpose them.
+ * Returns the rows of the transpose as pairs 0|4, 1|5, 2|6 and 3|7.
+ */
+
+JSIMD_INLINE JSIMD_TARGET_AVX2
+LOCAL(void)
+pack_transpose_avx2(__m256i* out, __m256i* v)
+{
+    __m256i p01, p23, p45, p67, q0, q1, q2, q3, r0, r1, r2, r3;
+
+    /* Packing leaves the low lane with columns 0..3 of both inputs and
+     * the high lane with columns 4..7; the transpose works within lanes.
+     */
+    p01 = _mm256_packs_epi32(out[0], out[1]);
+    p23 = _mm256_packs_epi32(out[2], out[3]);
+    p45 = _mm256_packs_epi32(out[4], out[5]);
+    p67 = _mm256_packs_epi32(out[6], out[7]);
+
+    q0 = _mm256_unpacklo_epi16(p01, p23);	/* interleaved rows 0, 2 */
+    q1 = _mm256_unpackhi_epi16(p01, p23);	/* interleaved rows 1, 3 */
+    q2 = _mm256_unpacklo_epi16(p45, p67);	/* interleaved rows 4, 6 */
+    q3 = _mm256_unpackhi_epi16(p45, p67);	/* interleaved rows 5, 7 */
+
+    r0 = _mm256_unpacklo_epi16(q0, q1);	/* rows 0..3 of cols 0, 1 | 4, 5 */
+    r1 = _mm256_unpackhi_epi16(q0, q1);	/* rows 0..3 of cols 2, 3 | 6, 7 */
+    r2 = _mm256_unpacklo_epi16(q2, q3);	/* rows 4..7 of cols 0, 1 | 4, 5 */
+    r3 = _mm256_unpackhi_epi16(q2, q3);	/* rows 4..7 of cols 2, 3 | 6, 7 */
+
+    v[0] = _mm256_unpacklo_epi64(r0, r2);	/* col 0 | col 4 */
+    v[1] = _mm256_unpackhi_epi64(r0, r2);	/* col 1 | col 5 */
+    v[2] = _mm256_unpacklo_epi64(r1, r3);	/* col 2 | col 6 */
+    v[3] = _mm256_unpackhi_epi64(r1, r3);	/* col 3 | col 7 */
+}
+
+
+/*
+ * Perform dequantization and inverse DCT on one block of coefficients
+ * with AVX2.
+ */
+
+JSIMD_TARGET_AVX2
+GLOBAL(void)
+jpeg_idct_islow_avx2(j_decompress_ptr cinfo, jpeg_component_info * compptr,
+    JCOEFPTR coef_block,
+    JSAMPARRAY output_buf, JDIMENSION output_col)
+{
+    __m256i p[4], v[4], out[DCTSIZE];
+    __m256i round, vmin, vmax;
+    __m128i lo, hi;
+    int i;
+
+    if (!dequantize_avx2(coef_block, ISLOW_SIMD_TABLE(compptr), p))
+        goto use_c;
+
+    /* Pass 1: process columns */
+    idct_1d_avx2(p, out);
+    round = _mm256_set1_epi32(1 << (CONST_BITS - PASS1_BITS - 1));
+    for (i = 0; i < DCTSIZE; i++)
+        out[i] = _mm256_srai_epi32(_mm256_add_epi32(out[i], round),
+            CONST_BITS - PASS1_BITS);
+    /* The transpose of the work array, as row pairs again */
+    pack_transpose_avx2(out, v);
+    p[0] = _mm256_permute2x128_si256(v[0], v[1], 0x20);
+    p[1] = _mm256_permute2x128_si256(v[2], v[3], 0x20);
+    p[2] = _mm256_permute2x128_si256(v[0], v[1], 0x31);
+    p[3] = _mm256_permute2x128_si256(v[2], v[3], 0x31);
+
+    /* Pass 2 needs the work array in 16 bits; see the SSE2 version */
+    vmin = _mm256_min_epi16(_mm256_min_epi16(p[0], p[1]),
+        _mm256_min_epi16(p[2], p[3]));
+    vmax = _mm256_max_epi16(_mm256_max_epi16(p[0], p[1]),
+        _mm256_max_epi16(p[2], p[3]));
+    if (!_mm256_testz_si256(_mm256_cmpeq_epi16(vmin, _mm256_set1_epi16(-0x8000)),
+        _mm256_set1_epi16(-1)) ||
+        !_mm256_testz_si256(_mm256_cmpeq_epi16(vmax, _mm256_set1_epi16(0x7FFF)),
+            _mm256_set1_epi16(-1)))
+        goto use_c;
+
+    /* Pass 2: process rows, which the transpose turned into columns */
+    idct_1d_avx2(p, out);
+    round = _mm256_set1_epi32(1 << (PASS2_BITS - 1));
+    for (i = 0; i < DCTSIZE; i++)
+        out[i] = _mm256_srai_epi32(_mm256_slli_epi32(_mm256_add_epi32(out[i], round),
+            RANGE_SHIFT), PASS2_BITS + RANGE_SHIFT);
+    pack_transpose_avx2(out, v);	/* output rows 0|4, 1|5, 2|6, 3|7 */
+
+    for (i = 0; i < 4; i += 2) {
+        p[i] = _mm256_packus_epi16(
+            _mm256_add_epi16(v[i], _mm256_set1_epi16(CENTERJSAMPLE)),
+            _mm256_add_epi16(v[i + 1], _mm256_set1_epi16(CENTERJSAMPLE)));
+        lo = _mm256_castsi256_si128(p[i]);
+        hi = _mm256_extracti128_si256(p[i], 1);
+        _mm_storel_epi64((__m128i*)(output_buf[i] + output_col), lo);
+        _mm_storeh_pd((double*)(output_buf[i + 1] + output_col),
+            _mm_castsi128_pd(lo));
+        _mm_storel_epi64((__m128i*)(output_buf[i + 4] + output_col), hi);
+        _mm_storeh_pd((double*)(output_buf[i + 5] + output_col),
+            _mm_castsi128_pd(hi));
+    }
+    return;
+
+use_c:
+    jpeg_idct_islow(cinfo, compptr, coef_block, output_buf, output_col);
+}
+
+#endif /* JSIMD_X86 && DCT_ISLOW_SUPPORTED */
@@ -46,7 +46,8 @@
 #include <stdio.h>
 
 /*
- * We need memory copying and zeroing functions, plus strncpy().
+ * We need memory copying (MEMMOVE for overlapping areas), zeroing and
+ * comparison functions, plus strncpy().
  * ANSI and System V implementations declare these in <string.h>.
  * BSD doesn't have the mem() functions, but it does have bcopy()/bzero().
  * Some systems may declare memset and memcpy in <memory.h>.
@@ -60,12 +61,16 @@
 #include <strings.h>
 #define MEMZERO(target,size)	bzero((void *)(target), (size_t)(size))
 #define MEMCOPY(dest,src,size)	bcopy((const void *)(src), (void *)(dest), (size_t)(size))
+#define MEMMOVE(dest,src,size)	bcopy((const void *)(src), (void *)(dest), (size_t)(size))
+#define MEMEQUAL(a,b,size)	(bcmp((const void *)(a), (const void *)(b), (size_t)(size)) == 0)
 
 #else /* not BSD, assume ANSI/SysV string lib */
 
 #include <string.h>
 #define MEMZERO(target,size)	memset((void *)(target), 0, (size_t)(size))
 #define MEMCOPY(dest,src,size)	memcpy((void *)(dest), (const void *)(src), (size_t)(size))
+#define MEMMOVE(dest,src,size)	memmove((void *)(dest), (const void *)(src), (size_t)(size))
+#define MEMEQUAL(a,b,size)	(memcmp((const void *)(a), (const void *)(b), (size_t)(size)) == 0)
 
 #endif
 
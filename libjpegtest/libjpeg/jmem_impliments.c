@@ -6,6 +6,7 @@
 #include "jerror.h"
 #include "jmemsys.h"		/* import the system-dependent declarations */
 #include "mem_region_list.h"
+#include "mem_slab.h"
 
 /**
  * stdlibmallocgǂB
@@ -16,116 +17,533 @@
 #define USE_MEMALLOC (1)
 
 /**
- * AP[V/ƂɃ_v邩ǂ
+ * 16MiB̗̈(Xu)y[WPʂŊmۂ邩ǂB(USE_MEMALLOC 1̏ꍇ)
+ *
+ * 1: mem_slab_map()ŊmۂB(q[Wy[WNUMAm[h̎w肪)
+ * 0: malloc()ŊmۂB
  */
-#define DUMP_MEMORY (1)
+#define USE_MAPPED_SLAB (1)
+
+/**
+ * XuzuNUMAm[hB(MEM_SLAB_NODE_ANY: w肵Ȃ)
+ */
+#define SLAB_NUMA_NODE MEM_SLAB_NODE_ANY
+
+/**
+ * ėp̂߂ɕێĂXu̐B
+ *
+ * jpeg_mem_term ŕԋpꂽXu jpeg_mem_init Ŏg񂵁A
+ * mۂƃy[WtHgJԂȂ悤ɂB0̏ꍇ͕ێȂB
+ */
+#define SLAB_CACHE_COUNT (2)
+
+/**
+ * 蓖ĂɎsƂɃ_v邩ǂ
+ */
+#define DUMP_MEMORY (0)
+
+/**
+ * AP[V/̃CxgL^邩ǂB
+ *
+ * 1: jpeg_mem_set_trace ŗLɂƂAA[ĩOobt@ɋL^B
+ * 0: L^ȂB(JE^̂)
+ */
+#define TRACE_MEMORY (1)
+
+/**
+ * SR[fbNIuWFNg1̃̈L邩ǂB
+ *
+ * 1: L̈悩犄蓖ĂB(Xbhgp\BubN̓A[iɃLbV)
+ * 0: R[fbNIuWFNgɗ̈mۂB(R[fbNIuWFNg1XbhĝŁÄ惊Xg̓bNȂ)
+ *
+ * jconfig.h vWFNg̃vvZbT` JMEM_SHARE_MEMORY `đIԁB
+ */
+#ifdef JMEM_SHARE_MEMORY
+#define SHARE_MEMORY (JMEM_SHARE_MEMORY)
+#else
+#define SHARE_MEMORY (0)
+#endif
+
+/**
+ * ȂAzzꎞt@Cɑޔ邩ǂB
+ *
+ * 1: tmpfile()ō쐬ꎞt@CɑޔB
+ * 0: ޔȂB(t@CVXe)
+ */
+#define USE_BACKING_STORE (1)
 
 
 #if USE_MEMALLOC
 #include <stdlib.h>
 #else
 #define MEM_ADDR (mem_addr_t*)(0x00000000) 
-#define MEM_SIZE (16 * 1024 * 1024) // 16Mib
 #endif
+#define MEM_SIZE (16 * 1024 * 1024) // 16Mib
 
 #define MEM_REGION_COUNT (64)
-static struct mem_region MemRegions[MEM_REGION_COUNT];
-static mem_region_list_t MemRegionList;
-static j_common_ptr UsedObject = NULL;
 
+/**
+ * jpeg_mem_available ŋ󂫗eʂ獷TCYB
+ * (v[̃wb_⋫E^OAGg̒ǉɎg镪)
+ */
+#define MEM_RESERVE_SIZE (64 * 1024)
+
+#if TRACE_MEMORY
+#include <time.h>
+/**
+ * Oobt@ɕێCxg̐B(Â̂㏑)
+ */
+#define MEM_TRACE_COUNT (256)
+#endif
+
+/**
+ * R[fbNIuWFNg̃A[iB
+ * jpeg_compress_struct/jpeg_decompress_struct  mem_arena ɕێB
+ */
+struct jmem_arena {
+#if SHARE_MEMORY
+    mem_region_cache_t cache; // L̈惊Xg̑OiɒuLbV
+#else
+    mem_region_list_t region_list; // ̈惊Xg
+    struct mem_region regions[MEM_REGION_COUNT]; // ̈惊Xg̃Gg
+#endif
+    struct jpeg_mem_stats stats; // v
+#if TRACE_MEMORY
+    bool trace_enabled; // CxgL^邩ǂ
+    int trace_next; // ɏވʒu
+    int trace_count; // L^ĂCxg̐
+    struct jpeg_mem_event trace[MEM_TRACE_COUNT]; // Cxg̃Oobt@
+#endif
+};
+
+#if SHARE_MEMORY
+static mem_region_list_t SharedRegionList; // L̈惊Xg
+static struct mem_region SharedRegions[MEM_REGION_COUNT]; // L̈惊Xg̃Gg
+static int32_t SharedRefCount = 0; // L̈gpĂA[i̐
+static mem_region_lock_t SharedLock = MEM_REGION_LOCK_INITIALIZER; // SharedRefCount ̔rp
+#endif
+#if USE_MEMALLOC
+static mem_addr_t SlabCache[SLAB_CACHE_COUNT + 1]; // ėp҂̃Xu(vf0̔z邽+1)
+static int32_t SlabCacheCount = 0; // SlabCache ɕێĂXu̐
+static mem_region_lock_t SlabCacheLock = MEM_REGION_LOCK_INITIALIZER; // SlabCache ̔rp
+#elif !SHARE_MEMORY
+static struct jmem_arena FixedArena; // Œ̈p̃A[i(1Ȃ)
+static bool IsFixedArenaUsed = false;
+#endif
+
+#define GET_ARENA(cinfo) ((struct jmem_arena*)((cinfo)->mem_arena))
+
+static mem_region_list_t* get_region_list(const struct jmem_arena* arena);
+#if USE_MEMALLOC
+static mem_addr_t get_slab(void);
+static void put_slab(mem_addr_t slab);
+#endif
+static void* assign_memory(struct jmem_arena* arena, size_t sizeofobject);
+static void release_memory(struct jmem_arena* arena, void* object, size_t sizeofobject);
+static void* get_memory(j_common_ptr cinfo, size_t sizeofobject, J_MEM_EVENT_TYPE type);
+static void free_memory(j_common_ptr cinfo, void* object, size_t sizeofobject, J_MEM_EVENT_TYPE type);
+#if TRACE_MEMORY
+static void record_event(struct jmem_arena* arena, J_MEM_EVENT_TYPE type, size_t size, void* address);
+#endif
+#if SHARE_MEMORY
+static bool open_shared_region(void);
+static void close_shared_region(void);
+#endif
 #if DUMP_MEMORY
-static void dump_memories(void);
+static void dump_memories(const mem_region_list_t* list);
 #endif
 
 /**
  * mۂB
+ *
+ * cinfoɃA[i쐬B
+ * SHARE_MEMORY 1̏ꍇAA[i͋L̈悩犄蓖ĂB
+ * 
+ * @param cinfo R[fbNIuWFNg
+ * @retval gp\ȃTCY
+ * @retval 0 A[i쐬łȂ
  */
 long
 jpeg_mem_init(j_common_ptr cinfo)
 {
-    if (UsedObject != NULL) {
+    struct jmem_arena* arena;
+
+    cinfo->mem_arena = NULL;
+#if SHARE_MEMORY
+    if (!open_shared_region()) {
+        return 0;
+    }
+    arena = (struct jmem_arena*)(mem_region_list_assign(&SharedRegionList, sizeof(struct jmem_arena)));
+    if (arena == NULL) {
+        close_shared_region();
         return 0;
     }
+    mem_region_cache_init(&(arena->cache), &SharedRegionList);
+#else
+    mem_size_t mem_size = MEM_SIZE;
 #if USE_MEMALLOC
-    mem_size_t mem_size = 16 * 1024 * 1024;
-    mem_addr_t mem_addr = (mem_addr_t)(malloc(mem_size));
+    arena = (struct jmem_arena*)(malloc(sizeof(struct jmem_arena)));
+    if (arena == NULL) {
+        return 0;
+    }
+    mem_addr_t mem_addr = get_slab();
     if (mem_addr == NULL) {
+        free(arena);
         return 0;
     }
 #else
+    if (IsFixedArenaUsed) { // Œ͎̈gpH
+        return 0;
+    }
+    arena = &FixedArena;
     mem_addr_t mem_addr = MEM_ADDR;
-    mem_size_t mem_size = MEM_SIZE;
+    IsFixedArenaUsed = true;
 #endif
 
-    mem_region_list_init(&MemRegionList, mem_addr, mem_size, MemRegions, MEM_REGION_COUNT);
-    UsedObject = cinfo;
-    return mem_region_list_get_free(&MemRegionList);
+    mem_region_list_init(&(arena->region_list), mem_addr, mem_size, arena->regions, MEM_REGION_COUNT, false);
+#endif
+    MEMZERO(&(arena->stats), SIZEOF(arena->stats));
+#if TRACE_MEMORY
+    arena->trace_enabled = false;
+    arena->trace_next = 0;
+    arena->trace_count = 0;
+#endif
+    cinfo->mem_arena = arena;
+    return mem_region_list_get_free(get_region_list(arena));
 }
 
 /**
  * ̊mۂIB(N[Abv)
+ *
+ * @param cinfo R[fbNIuWFNg
  */
 void
 jpeg_mem_term(j_common_ptr cinfo)
 {
-    if ((UsedObject != NULL) && (cinfo == UsedObject)) {
+    struct jmem_arena* arena = GET_ARENA(cinfo);
+    if (arena != NULL) {
+#if SHARE_MEMORY
+        mem_region_cache_flush(&(arena->cache));
+        mem_region_list_release(&SharedRegionList, (mem_addr_t)(arena));
+        close_shared_region();
+#else
+#if USE_MEMALLOC
+        put_slab(arena->region_list.free.address); // Return slab.
+#endif
+        mem_region_list_destroy(&(arena->region_list));
 #if USE_MEMALLOC
-        free(MemRegionList.free.address); // Cleanup heap.
+        free(arena);
+#else
+        IsFixedArenaUsed = false;
+#endif
 #endif
-        mem_region_list_destroy(&MemRegionList);
-        UsedObject = NULL;
+        cinfo->mem_arena = NULL;
     }
     return;
 }
 
+#if SHARE_MEMORY
+/**
+ * L̈̎gpJnB
+ *
+ * ŏɎgpƂɗ̈惊XgB
+ *
+ * @retval true 
+ * @retval false s
+ */
+static bool
+open_shared_region(void)
+{
+    bool ret = true;
+    mem_region_lock_acquire(&SharedLock);
+    if (SharedRefCount == 0) {
+        mem_size_t mem_size = MEM_SIZE;
+#if USE_MEMALLOC
+        mem_addr_t mem_addr = get_slab();
+#else
+        mem_addr_t mem_addr = MEM_ADDR;
+#endif
+        if (mem_addr == NULL) {
+            ret = false;
+        }
+        else {
+            mem_region_list_init(&SharedRegionList, mem_addr, mem_size, SharedRegions, MEM_REGION_COUNT, true);
+        }
+    }
+    if (ret) {
+        SharedRefCount++;
+    }
+    mem_region_lock_release(&SharedLock);
 
- /*
-  * Memory allocation and freeing are controlled by the regular library
-  * routines malloc() and free().
-  */
+    return ret;
+}
 
-void*
-jpeg_get_small(j_common_ptr cinfo, size_t sizeofobject)
+/**
+ * L̈̎gpIB
+ *
+ * Ō̎gp҂IƂɗ̈惊XgjB
+ */
+static void
+close_shared_region(void)
+{
+    mem_region_lock_acquire(&SharedLock);
+    SharedRefCount--;
+    if (SharedRefCount == 0) {
+#if USE_MEMALLOC
+        put_slab(SharedRegionList.free.address); // Return slab.
+#endif
+        mem_region_list_destroy(&SharedRegionList);
+    }
+    mem_region_lock_release(&SharedLock);
+
+    return;
+}
+#endif
+
+#if USE_MEMALLOC
+/**
+ * Xu擾B
+ *
+ * ێĂXu΂gAΐVmۂB
+ *
+ * @retval Xu (MEM_SIZE oCg)
+ * @retval NULL mۂłȂ
+ */
+static mem_addr_t
+get_slab(void)
+{
+    mem_addr_t slab = NULL;
+    mem_region_lock_acquire(&SlabCacheLock);
+    if (SlabCacheCount > 0) {
+        SlabCacheCount--;
+        slab = SlabCache[SlabCacheCount];
+    }
+    mem_region_lock_release(&SlabCacheLock);
+
+    if (slab == NULL) {
+#if USE_MAPPED_SLAB
+        slab = mem_slab_map(MEM_SIZE, SLAB_NUMA_NODE);
+#else
+        slab = (mem_addr_t)(malloc(MEM_SIZE));
+#endif
+    }
+    return slab;
+}
+
+/**
+ * XuԋpB
+ *
+ * SLAB_CACHE_COUNT ܂ŕێAȏ͉B
+ *
+ * @param slab Xu
+ */
+static void
+put_slab(mem_addr_t slab)
+{
+    mem_region_lock_acquire(&SlabCacheLock);
+    if (SlabCacheCount < SLAB_CACHE_COUNT) {
+        SlabCache[SlabCacheCount] = slab;
+        SlabCacheCount++;
+        slab = NULL;
+    }
+    mem_region_lock_release(&SlabCacheLock);
+
+    if (slab != NULL) {
+#if USE_MAPPED_SLAB
+        mem_slab_unmap(slab, MEM_SIZE);
+#else
+        free(slab);
+#endif
+    }
+}
+#endif
+
+/**
+ * ێĂXuSĉB
+ *
+ * SẴR[fbNIuWFNgjAOSɕԂƂɌĂԁB
+ */
+GLOBAL(void)
+jpeg_mem_purge_slabs(void)
+{
+#if USE_MEMALLOC
+    mem_region_lock_acquire(&SlabCacheLock);
+    while (SlabCacheCount > 0) {
+        SlabCacheCount--;
+#if USE_MAPPED_SLAB
+        mem_slab_unmap(SlabCache[SlabCacheCount], MEM_SIZE);
+#else
+        free(SlabCache[SlabCacheCount]);
+#endif
+    }
+    mem_region_lock_release(&SlabCacheLock);
+#endif
+}
+
+/**
+ * A[i蓖ĂɎg̈惊Xg擾B
+ *
+ * @param arena A[i
+ * @retval ̈惊Xg
+ */
+static mem_region_list_t*
+get_region_list(const struct jmem_arena* arena)
+{
+#if SHARE_MEMORY
+    return arena->cache.list;
+#else
+    return (mem_region_list_t*)(&(arena->region_list));
+#endif
+}
+
+/**
+ * A[i烁蓖ĂB
+ *
+ * @param arena A[i
+ * @param sizeofobject TCY
+ * @retval 蓖Ă
+ * @retval NULL 蓖ĂȂ
+ */
+static void*
+assign_memory(struct jmem_arena* arena, size_t sizeofobject)
+{
+#if SHARE_MEMORY
+    return mem_region_cache_assign(&(arena->cache), (mem_size_t)(sizeofobject));
+#else
+    return mem_region_list_assign(&(arena->region_list), (mem_size_t)(sizeofobject));
+#endif
+}
+
+/**
+ * A[iɃԋpB
+ *
+ * @param arena A[i
+ * @param object ԋp郁
+ * @param sizeofobject 蓖Ď̃TCY
+ */
+static void
+release_memory(struct jmem_arena* arena, void* object, size_t sizeofobject)
+{
+#if SHARE_MEMORY
+    mem_region_cache_release(&(arena->cache), (mem_addr_t)(object), (mem_size_t)(sizeofobject));
+#else
+    mem_region_list_release(&(arena->region_list), (mem_addr_t)(object));
+#endif
+}
+
+
+/**
+ * 蓖āAvƃCxgXVB
+ *
+ * @param cinfo R[fbNIuWFNg
+ * @param sizeofobject TCY
+ * @param type Cxg̎
+ * @retval 蓖Ă
+ * @retval NULL 蓖ĂȂ
+ */
+static void*
+get_memory(j_common_ptr cinfo, size_t sizeofobject, J_MEM_EVENT_TYPE type)
 {
     void* ret = NULL;
-    if (cinfo == UsedObject) {
-        ret = mem_region_list_assign(&MemRegionList, (mem_size_t)(sizeofobject));
-#if DUMP_MEMORY
+    struct jmem_arena* arena = GET_ARENA(cinfo);
+    if (arena != NULL) {
+        ret = assign_memory(arena, sizeofobject);
         if (ret != NULL) {
-            uint32_t used_count;
-            uint32_t free_count;
-            mem_region_list_get_entry_count(&MemRegionList, &free_count, &used_count);
-            printf("Allocate %d bytes. TotalUsed=%d/%d EntryUsed=%d/%d\n",
-                (int)(sizeofobject),
-                (int)(mem_region_list_get_used(&MemRegionList)),
-                (int)(mem_region_list_get_used(&MemRegionList) + mem_region_list_get_free(&MemRegionList)),
-                (int)(used_count), (int)(used_count + free_count));
-        } else {
-            dump_memories();
+            arena->stats.alloc_count++;
+            arena->stats.bytes_in_use += (long)(sizeofobject);
+            if (arena->stats.bytes_in_use > arena->stats.peak_bytes_in_use) {
+                arena->stats.peak_bytes_in_use = arena->stats.bytes_in_use;
+            }
+        }
+        else {
+            arena->stats.fail_count++;
+#if DUMP_MEMORY
+            dump_memories(get_region_list(arena));
+#endif
+        }
+#if TRACE_MEMORY
+        if (arena->trace_enabled) {
+            record_event(arena, type, sizeofobject, ret);
         }
 #endif
     }
     return ret;
 }
 
-void
-jpeg_free_small(j_common_ptr cinfo, void* object, size_t sizeofobject)
+/**
+ * ԋpAvƃCxgXVB
+ *
+ * @param cinfo R[fbNIuWFNg
+ * @param object ԋp郁
+ * @param sizeofobject 蓖Ď̃TCY
+ * @param type Cxg̎
+ */
+static void
+free_memory(j_common_ptr cinfo, void* object, size_t sizeofobject, J_MEM_EVENT_TYPE type)
 {
-    if (cinfo == UsedObject) {
-        mem_region_list_release(&MemRegionList, object);
-#if DUMP_MEMORY
-        uint32_t used_count;
-        uint32_t free_count;
-        mem_region_list_get_entry_count(&MemRegionList, &free_count, &used_count);
-        printf("Release %d bytes. TotalUsed=%d/%d EntryUsed=%d/%d\n",
-            (int)(sizeofobject),
-            (int)(mem_region_list_get_used(&MemRegionList)),
-            (int)(mem_region_list_get_used(&MemRegionList) + mem_region_list_get_free(&MemRegionList)),
-            (int)(used_count), (int)(used_count + free_count));
+    struct jmem_arena* arena = GET_ARENA(cinfo);
+    if (arena != NULL) {
+        release_memory(arena, object, sizeofobject);
+        arena->stats.free_count++;
+        arena->stats.bytes_in_use -= (long)(sizeofobject);
+#if TRACE_MEMORY
+        if (arena->trace_enabled) {
+            record_event(arena, type, sizeofobject, object);
+        }
 #endif
     }
 }
 
+#if TRACE_MEMORY
+/**
+ * CxgOobt@ɋL^B
+ *
+ * @param arena A[i
+ * @param type Cxg̎
+ * @param size v/ԋpꂽTCY
+ * @param address Ώۂ̃AhX (蓖ĎsNULL)
+ */
+static void
+record_event(struct jmem_arena* arena, J_MEM_EVENT_TYPE type, size_t size, void* address)
+{
+    struct jpeg_mem_event* event = &(arena->trace[arena->trace_next]);
+    struct timespec ts;
+
+    if (timespec_get(&ts, TIME_UTC) == 0) {
+        ts.tv_sec = 0;
+        ts.tv_nsec = 0;
+    }
+    event->type = type;
+    event->size = size;
+    event->address = address;
+    event->bytes_in_use = arena->stats.bytes_in_use;
+    event->timestamp = (unsigned long long)(ts.tv_sec) * 1000000000ull + (unsigned long long)(ts.tv_nsec);
+
+    arena->trace_next = (arena->trace_next + 1) % MEM_TRACE_COUNT;
+    if (arena->trace_count < MEM_TRACE_COUNT) {
+        arena->trace_count++;
+    }
+}
+#endif
+
+
+ /*
+  * Memory allocation and freeing are controlled by the regular library
+  * routines malloc() and free().
+  */
+
+void*
+jpeg_get_small(j_common_ptr cinfo, size_t sizeofobject)
+{
+    return get_memory(cinfo, sizeofobject, JMEM_GET_SMALL);
+}
+
+void
+jpeg_free_small(j_common_ptr cinfo, void* object, size_t sizeofobject)
+{
+    free_memory(cinfo, object, sizeofobject, JMEM_FREE_SMALL);
+}
+
 
 /*
  * "Large" objects are treated the same as "small" ones.
@@ -137,64 +555,187 @@ jpeg_free_small(j_common_ptr cinfo, void* object, size_t sizeofobject)
 void*
 jpeg_get_large(j_common_ptr cinfo, size_t sizeofobject)
 {
-    void* ret = NULL;
-    if (cinfo == UsedObject) {
-        ret = mem_region_list_assign(&MemRegionList, (mem_size_t)(sizeofobject));
-#if DUMP_MEMORY
-        if (ret != NULL) {
-            uint32_t used_count;
-            uint32_t free_count;
-            mem_region_list_get_entry_count(&MemRegionList, &free_count, &used_count);
-            printf("Allocate %d bytes. TotalUsed=%d/%d EntryUsed=%d/%d\n",
-                (int)(sizeofobject),
-                (int)(mem_region_list_get_used(&MemRegionList)),
-                (int)(mem_region_list_get_used(&MemRegionList) + mem_region_list_get_free(&MemRegionList)),
-                (int)(used_count), (int)(used_count + free_count));
-        }
-        else {
-            dump_memories();
-        }
-#endif
-    }
-    return ret;
+    return get_memory(cinfo, sizeofobject, JMEM_GET_LARGE);
 }
 
 void
 jpeg_free_large(j_common_ptr cinfo, void FAR* object, size_t sizeofobject)
 {
-    if (cinfo == UsedObject) {
-        mem_region_list_release(&MemRegionList, object);
-#if DUMP_MEMORY
-        uint32_t used_count;
-        uint32_t free_count;
-        mem_region_list_get_entry_count(&MemRegionList, &free_count, &used_count);
-        printf("Release %d bytes. TotalUsed=%d/%d EntryUsed=%d/%d\n",
-            (int)(sizeofobject),
-            (int)(mem_region_list_get_used(&MemRegionList)),
-            (int)(mem_region_list_get_used(&MemRegionList) + mem_region_list_get_free(&MemRegionList)),
-            (int)(used_count), (int)(used_count + free_count));
+    free_memory(cinfo, object, sizeofobject, JMEM_FREE_LARGE);
+}
+
+
+/**
+ * Cxg̋L^Jn/~B
+ *
+ * JnƂ͋L^ς݂̃CxgjB
+ * TRACE_MEMORY 0̏ꍇ͉ȂB
+ *
+ * @param cinfo R[fbNIuWFNg
+ * @param enable L^ꍇtrue
+ */
+GLOBAL(void)
+jpeg_mem_set_trace(j_common_ptr cinfo, bool enable)
+{
+#if TRACE_MEMORY
+    struct jmem_arena* arena = GET_ARENA(cinfo);
+    if (arena != NULL) {
+        if (enable && !arena->trace_enabled) {
+            arena->trace_next = 0;
+            arena->trace_count = 0;
+        }
+        arena->trace_enabled = enable;
+    }
 #endif
+}
+
+/**
+ * v擾B
+ *
+ * @param cinfo R[fbNIuWFNg
+ * @param stats vi[
+ */
+GLOBAL(void)
+jpeg_mem_get_stats(j_common_ptr cinfo, struct jpeg_mem_stats* stats)
+{
+    struct jmem_arena* arena = GET_ARENA(cinfo);
+    if (arena != NULL) {
+        *stats = arena->stats;
+    }
+    else {
+        MEMZERO(stats, SIZEOF(*stats));
     }
 }
 
+/**
+ * L^ꂽCxgÂɎ擾B
+ *
+ * @param cinfo R[fbNIuWFNg
+ * @param events Cxgi[z
+ * @param max_events events̗vf
+ * @retval i[Cxg̐
+ */
+GLOBAL(int)
+jpeg_mem_get_trace(j_common_ptr cinfo, struct jpeg_mem_event* events, int max_events)
+{
+    int count = 0;
+#if TRACE_MEMORY
+    struct jmem_arena* arena = GET_ARENA(cinfo);
+    if (arena != NULL) {
+        int skip;
+        int i;
+        count = arena->trace_count;
+        if (count > max_events) {
+            count = max_events;
+        }
+        /* 肫Ȃꍇ͐V̂c */
+        skip = arena->trace_count - count;
+        for (i = 0; i < count; i++) {
+            int index = (arena->trace_next - arena->trace_count + skip + i + MEM_TRACE_COUNT) % MEM_TRACE_COUNT;
+            events[i] = arena->trace[index];
+        }
+    }
+#endif
+    return count;
+}
 
 /*
  * This routine computes the total memory space available for allocation.
- * Here we always say, "we got all you want bud!"
+ * It is the smaller of the codec's budget (cinfo->mem->max_memory_to_use,
+ * which the application may lower before jpeg_start_*) and the space
+ * actually left in the arena's region list.
  */
 
 long
 jpeg_mem_available(j_common_ptr cinfo, long min_bytes_needed,
     long max_bytes_needed, long already_allocated)
 {
-    return max_bytes_needed;
+    long avail = cinfo->mem->max_memory_to_use - already_allocated;
+    struct jmem_arena* arena = GET_ARENA(cinfo);
+    if (arena != NULL) {
+        long region_free = (long)(mem_region_list_get_free(get_region_list(arena))) - MEM_RESERVE_SIZE;
+        if (region_free < avail) {
+            avail = region_free;
+        }
+    }
+    return avail;
 }
 
 
+#if USE_BACKING_STORE
+
 /*
  * Backing store (temporary file) management.
- * Since jpeg_mem_available always promised the moon,
- * this should never be called and we can just error out.
+ * Virtual arrays which exceed jpeg_mem_available are spilled to an
+ * anonymous temporary file obtained from tmpfile(), as jmemansi.c does.
+ */
+
+METHODDEF(void)
+read_backing_store(j_common_ptr cinfo, backing_store_ptr info,
+    void FAR* buffer_address,
+    long file_offset, long byte_count)
+{
+    if (fseek(info->temp_file, file_offset, SEEK_SET)) {
+        ERREXIT(cinfo, JERR_TFILE_SEEK);
+    }
+    if (JFREAD(info->temp_file, buffer_address, byte_count)
+        != (size_t)byte_count) {
+        ERREXIT(cinfo, JERR_TFILE_READ);
+    }
+}
+
+
+METHODDEF(void)
+write_backing_store(j_common_ptr cinfo, backing_store_ptr info,
+    void FAR* buffer_address,
+    long file_offset, long byte_count)
+{
+    if (fseek(info->temp_file, file_offset, SEEK_SET)) {
+        ERREXIT(cinfo, JERR_TFILE_SEEK);
+    }
+    if (JFWRITE(info->temp_file, buffer_address, byte_count)
+        != (size_t)byte_count) {
+        ERREXIT(cinfo, JERR_TFILE_WRITE);
+    }
+}
+
+
+METHODDEF(void)
+close_backing_store(j_common_ptr cinfo, backing_store_ptr info)
+{
+    fclose(info->temp_file);
+    /* Since this implementation uses tmpfile() to create the file,
+     * no explicit file deletion is needed.
+     */
+}
+
+
+/*
+ * Initial opening of a backing-store object.
+ *
+ * This version uses tmpfile(), which constructs a suitable file name
+ * behind the scenes.  We don't have to use info->temp_name[] at all;
+ * indeed, we can't even find out the actual name of the temp file.
+ */
+
+void
+jpeg_open_backing_store(j_common_ptr cinfo, backing_store_ptr info,
+    long total_bytes_needed)
+{
+    if ((info->temp_file = tmpfile()) == NULL) {
+        ERREXITS(cinfo, JERR_TFILE_CREATE, "");
+    }
+    info->read_backing_store = read_backing_store;
+    info->write_backing_store = write_backing_store;
+    info->close_backing_store = close_backing_store;
+}
+
+#else /* !USE_BACKING_STORE */
+
+/*
+ * Backing store (temporary file) management.
+ * Without a file system we can't spill, so jpeg_mem_available's budget
+ * must cover the whole image.
  */
 
 void
@@ -204,23 +745,25 @@ jpeg_open_backing_store(j_common_ptr cinfo, backing_store_ptr info,
     ERREXIT(cinfo, JERR_NO_BACKING_STORE);
 }
 
+#endif /* USE_BACKING_STORE */
+
 #if DUMP_MEMORY
-static void dump_memories(void) {
-    mem_size_t used_size = mem_region_list_get_used(&MemRegionList);
-    mem_size_t free_size = mem_region_list_get_free(&MemRegionList);
+static void dump_memories(const mem_region_list_t* list) {
+    mem_size_t used_size = mem_region_list_get_used(list);
+    mem_size_t free_size = mem_region_list_get_free(list);
     printf("Used = %u\n", used_size);
     {
-        const struct mem_region* pregion = MemRegionList.used.next;
-        while (pregion != &(MemRegionList.used)) {
+        const struct mem_region* pregion = list->used.next;
+        while (pregion != &(list->used)) {
             printf("  %p %u\n", pregion->address, pregion->length);
             pregion = pregion->next;
         }
     }
 
     printf("Free = %u\n", free_size);
-    {
-        const struct mem_region* pregion = MemRegionList.free.next;
-        while (pregion != &(MemRegionList.free)) {
+    for (int i = 0; i < MEM_REGION_BIN_COUNT; i++) {
+        const struct mem_region* pregion = list->bins[i].next;
+        while (pregion != &(list->bins[i])) {
             printf("  %p %u\n", pregion->address, pregion->length);
             pregion = pregion->next;
         }
@@ -94,6 +94,7 @@ typedef union small_pool_struct {
         small_pool_ptr next;	/* next in list of pools */
         size_t bytes_used;		/* how many bytes already used within pool */
         size_t bytes_left;		/* bytes still available in this pool */
+        size_t bytes_marked;	/* bytes_used at the last mark_image_pool */
     } hdr;
     ALIGN_TYPE dummy;		/* included in union to ensure alignment */
 } small_pool_hdr;
@@ -110,6 +111,20 @@ typedef union large_pool_struct {
 } large_pool_hdr;
 
 
+/*
+ * Cleanup routines registered for a pool are kept in a list allocated in
+ * that same pool, newest first.
+ */
+
+typedef struct cleanup_struct* cleanup_ptr;
+
+typedef struct cleanup_struct {
+    cleanup_ptr next;		/* next (older) entry for this pool */
+    jpeg_cleanup_method func;	/* routine to call */
+    void* arg;			/* its argument */
+} cleanup_entry;
+
+
 /*
  * Here is the full definition of a memory manager object.
  */
@@ -129,17 +144,61 @@ typedef struct {
     jvirt_sarray_ptr virt_sarray_list;
     jvirt_barray_ptr virt_barray_list;
 
+    /* Routines to run before each pool is freed */
+    cleanup_ptr cleanup_list[JPOOL_NUMPOOLS];
+
     /* This counts total space obtained from jpeg_get_small/large */
     long total_space_allocated;
+    /* High-water mark of total_space_allocated since the last mark */
+    long peak_space_allocated;
+
+    /* State of the IMAGE pool saved by mark_image_pool, so that
+     * release_to_mark can roll it back.  Small pools are appended to the
+     * end of their list and large pools are pushed on the front, so the
+     * list positions tell which pools are newer than the mark.
+     */
+    small_pool_ptr small_mark;	/* last small pool at mark time */
+    large_pool_ptr large_mark;	/* first large pool at mark time */
+    jvirt_sarray_ptr virt_sarray_mark;	/* virtual array lists at mark time */
+    jvirt_barray_ptr virt_barray_mark;
+    cleanup_ptr cleanup_mark;	/* IMAGE cleanup list at mark time */
+    size_t permanent_used_mark;	/* permanent_bytes_used at mark time */
 
     /* alloc_sarray and alloc_barray set this value for use by virtual
      * array routines.
      */
     JDIMENSION last_rowsperchunk;	/* from most recent alloc_sarray/barray */
+
+#ifdef USE_IMAGE_ARENA
+    /* JPOOL_IMAGE objects are bump-allocated from a single slab, which is
+     * reset as a whole by free_pool(JPOOL_IMAGE) and kept for the next image.
+     * Requests that don't fit fall back to the pool lists; the slab is then
+     * regrown before the next image to the largest image pool seen so far.
+     * An image that needed no more than a quarter of it trims the slab to
+     * its own size right away; after IMAGE_ARENA_TRIM_COUNT images in a row
+     * that needed no more than half of it, the slab is trimmed to the
+     * largest of those images.
+     */
+    char FAR* image_arena;	/* => the slab, or NULL if none yet */
+    size_t image_arena_size;	/* total size of the slab */
+    size_t image_arena_used;	/* bytes already used within the slab */
+    size_t image_arena_wanted;	/* slab size wanted for the next image */
+    size_t image_bytes_requested;	/* JPOOL_IMAGE bytes requested so far */
+    size_t image_bytes_recent_max;	/* largest of the small images in a row */
+    int image_arena_small_images;	/* number of small images in a row */
+    size_t image_arena_used_mark;	/* image_arena_used at mark time */
+    size_t image_bytes_requested_mark;	/* image_bytes_requested at mark time */
+#endif
 } my_memory_mgr;
 
 typedef my_memory_mgr* my_mem_ptr;
 
+/* Count space obtained from jpeg_get_small/large, tracking the peak */
+#define ADD_SPACE_ALLOCATED(mem, nbytes)  \
+    ((mem)->total_space_allocated += (long)(nbytes), \
+     (mem)->peak_space_allocated = MAX((mem)->peak_space_allocated, \
+         (mem)->total_space_allocated))
+
 
 /*
  * The control blocks for virtual arrays.
@@ -197,6 +256,13 @@ print_mem_stats(j_common_ptr cinfo, int pool_id)
     fprintf(stderr, "Freeing pool %d, total space = %ld\n",
         pool_id, mem->total_space_allocated);
 
+#ifdef USE_IMAGE_ARENA
+    if (pool_id == JPOOL_IMAGE) {
+        fprintf(stderr, "  Image arena used %ld of %ld\n",
+            (long)mem->image_arena_used, (long)mem->image_arena_size);
+    }
+#endif
+
     for (lhdr_ptr = mem->large_list[pool_id]; lhdr_ptr != NULL;
         lhdr_ptr = lhdr_ptr->hdr.next) {
         fprintf(stderr, "  Large chunk used %ld\n",
@@ -254,6 +320,67 @@ static const size_t extra_pool_slop[JPOOL_NUMPOOLS] =
 #define MIN_SLOP  50		/* greater than 0 to avoid futile looping */
 
 
+#ifdef USE_IMAGE_ARENA
+
+/*
+ * The image arena is trimmed after this many images in a row that needed no
+ * more than half of the slab (at once, if one needed a quarter or less, so
+ * that a single large image isn't kept around for the following small ones).
+ * IMAGE_ARENA_MAX_SIZE, if defined, caps the slab size; larger image pools
+ * then spill over into the pool lists.  Both can be overridden from jconfig.h.
+ */
+
+#ifndef IMAGE_ARENA_TRIM_COUNT
+#define IMAGE_ARENA_TRIM_COUNT  8
+#endif
+
+/*
+ * Allocation from the image arena.
+ * sizeofobject must already be rounded up to a multiple of SIZEOF(ALIGN_TYPE).
+ * Returns NULL if the object doesn't fit; the caller then uses the pools.
+ */
+
+LOCAL(void FAR*)
+alloc_image_arena(j_common_ptr cinfo, size_t sizeofobject)
+{
+    my_mem_ptr mem = (my_mem_ptr)cinfo->mem;
+    char FAR* data_ptr;
+
+    mem->image_bytes_requested += sizeofobject;
+
+    /* At the start of an image, regrow the slab if the last image needed more */
+    if (mem->image_arena_used == 0 &&
+        mem->image_arena_size < mem->image_arena_wanted) {
+        if (mem->image_arena != NULL) {
+            jpeg_free_large(cinfo, (void FAR*) mem->image_arena,
+                mem->image_arena_size);
+            mem->total_space_allocated -= (long)mem->image_arena_size;
+            mem->image_arena = NULL;
+            mem->image_arena_size = 0;
+        }
+        mem->image_arena = (char FAR*) jpeg_get_large(cinfo,
+            mem->image_arena_wanted);
+        if (mem->image_arena != NULL) {
+            mem->image_arena_size = mem->image_arena_wanted;
+            ADD_SPACE_ALLOCATED(mem, mem->image_arena_size);
+        }
+        else {
+            mem->image_arena_wanted = 0; /* learn again from this image */
+        }
+    }
+
+    if (mem->image_arena == NULL ||
+        sizeofobject > mem->image_arena_size - mem->image_arena_used)
+        return NULL;
+
+    data_ptr = mem->image_arena + mem->image_arena_used;
+    mem->image_arena_used += sizeofobject;
+    return (void FAR*) data_ptr;
+}
+
+#endif /* USE_IMAGE_ARENA */
+
+
 METHODDEF(void*)
 alloc_small(j_common_ptr cinfo, int pool_id, size_t sizeofobject)
 /* Allocate a "small" object */
@@ -279,6 +406,13 @@ alloc_small(j_common_ptr cinfo, int pool_id, size_t sizeofobject)
         ERREXIT1(cinfo, JERR_BAD_POOL_ID, pool_id);	/* safety check */
         return NULL;
     }
+#ifdef USE_IMAGE_ARENA
+    if (pool_id == JPOOL_IMAGE) {
+        data_ptr = (char*)alloc_image_arena(cinfo, sizeofobject);
+        if (data_ptr != NULL)
+            return (void*)data_ptr;
+    }
+#endif
     prev_hdr_ptr = NULL;
     hdr_ptr = mem->small_list[pool_id];
     while (hdr_ptr != NULL) {
@@ -308,11 +442,12 @@ alloc_small(j_common_ptr cinfo, int pool_id, size_t sizeofobject)
             if (slop < MIN_SLOP)	/* give up when it gets real small */
                 out_of_memory(cinfo, 2); /* jpeg_get_small failed */
         }
-        mem->total_space_allocated += (long)(min_request + slop);
+        ADD_SPACE_ALLOCATED(mem, min_request + slop);
         /* Success, initialize the new pool header and add to end of list */
         hdr_ptr->hdr.next = NULL;
         hdr_ptr->hdr.bytes_used = 0;
         hdr_ptr->hdr.bytes_left = sizeofobject + slop;
+        hdr_ptr->hdr.bytes_marked = 0;
         if (prev_hdr_ptr == NULL)	/* first pool in class? */
             mem->small_list[pool_id] = hdr_ptr;
         else
@@ -369,14 +504,20 @@ alloc_large(j_common_ptr cinfo, int pool_id, size_t sizeofobject)
         ERREXIT1(cinfo, JERR_BAD_POOL_ID, pool_id);	/* safety check */
         return NULL;
     }
-    
+#ifdef USE_IMAGE_ARENA
+    if (pool_id == JPOOL_IMAGE) {
+        void FAR* data_ptr = alloc_image_arena(cinfo, sizeofobject);
+        if (data_ptr != NULL)
+            return data_ptr;
+    }
+#endif
 
     hdr_ptr = (large_pool_ptr)jpeg_get_large(cinfo, sizeofobject + SIZEOF(large_pool_hdr));
     if (hdr_ptr == NULL) {
         out_of_memory(cinfo, 4);	/* jpeg_get_large failed */
         return NULL;
     }
-    mem->total_space_allocated += (long)(sizeofobject + SIZEOF(large_pool_hdr));
+    ADD_SPACE_ALLOCATED(mem, sizeofobject + SIZEOF(large_pool_hdr));
 
     /* Success, initialize the new pool header and add to list */
     hdr_ptr->hdr.next = mem->large_list[pool_id];
@@ -629,8 +770,15 @@ realize_virt_arrays(j_common_ptr cinfo)
         return;			/* no unrealized arrays, no work */
 
     /* Determine amount of memory to actually use; this is system-dependent. */
+#ifdef USE_IMAGE_ARENA
+    /* The unused part of the image arena is still available for the arrays */
+    avail_mem = jpeg_mem_available(cinfo, space_per_minheight, maximum_space,
+        mem->total_space_allocated -
+        (long)(mem->image_arena_size - mem->image_arena_used));
+#else
     avail_mem = jpeg_mem_available(cinfo, space_per_minheight, maximum_space,
         mem->total_space_allocated);
+#endif
 
     /* If the maximum space needed is available, make all the buffers full
      * height; otherwise parcel it out with the same number of minheights
@@ -953,6 +1101,47 @@ access_virt_barray(j_common_ptr cinfo, jvirt_barray_ptr ptr,
 }
 
 
+/*
+ * Register a routine to be called just before the pool is freed, whether
+ * by free_pool (jpeg_abort, jpeg_destroy) or by release_to_mark.  This lets
+ * a module that owns something outside the pools, such as a helper thread
+ * working on a pool buffer, shut it down even after an error exit.
+ */
+
+METHODDEF(void)
+register_cleanup(j_common_ptr cinfo, int pool_id,
+    jpeg_cleanup_method func, void* arg)
+{
+    my_mem_ptr mem = (my_mem_ptr)cinfo->mem;
+    cleanup_ptr entry;
+
+    entry = (cleanup_ptr)alloc_small(cinfo, pool_id, SIZEOF(cleanup_entry));
+    entry->func = func;
+    entry->arg = arg;
+    entry->next = mem->cleanup_list[pool_id];
+    mem->cleanup_list[pool_id] = entry;
+}
+
+
+/*
+ * Run the cleanup routines of a pool, newest first, down to (not including)
+ * stop.  Each entry is unlinked before it is called, so that an error exit
+ * from a routine does not run it again.
+ */
+
+LOCAL(void)
+run_cleanups(j_common_ptr cinfo, int pool_id, cleanup_ptr stop)
+{
+    my_mem_ptr mem = (my_mem_ptr)cinfo->mem;
+    cleanup_ptr entry;
+
+    while ((entry = mem->cleanup_list[pool_id]) != stop) {
+        mem->cleanup_list[pool_id] = entry->next;
+        (*entry->func) (cinfo, entry->arg);
+    }
+}
+
+
 /*
  * Release all objects belonging to a specified pool.
  */
@@ -973,6 +1162,9 @@ free_pool(j_common_ptr cinfo, int pool_id)
         print_mem_stats(cinfo, pool_id); /* print pool's memory usage statistics */
 #endif
 
+    /* Let the owners of anything still using the pool shut it down */
+    run_cleanups(cinfo, pool_id, (cleanup_ptr)NULL);
+
     /* If freeing IMAGE pool, close any virtual arrays first */
     if (pool_id == JPOOL_IMAGE) {
         jvirt_sarray_ptr sptr;
@@ -1021,6 +1213,197 @@ free_pool(j_common_ptr cinfo, int pool_id)
         mem->total_space_allocated -= (long)(space_freed);
         shdr_ptr = next_shdr_ptr;
     }
+
+#ifdef USE_IMAGE_ARENA
+    /* Release the image arena in one step, keeping the slab for next image */
+    if (pool_id == JPOOL_IMAGE) {
+        size_t requested = mem->image_bytes_requested;
+
+        mem->image_arena_used = 0;
+        mem->image_bytes_requested = 0;
+        if (requested > mem->image_arena_wanted) {
+            /* Grow before the next image */
+            mem->image_arena_wanted = requested;
+            mem->image_arena_small_images = 0;
+            mem->image_bytes_recent_max = 0;
+        }
+        else if (requested > 0 && requested <= mem->image_arena_wanted / 4) {
+            /* Far below the slab (e.g. the images after an outlier): shrink now */
+            mem->image_arena_wanted = requested;
+            mem->image_arena_small_images = 0;
+            mem->image_bytes_recent_max = 0;
+        }
+        else if (requested > 0 && requested <= mem->image_arena_wanted / 2) {
+            /* Shrink once enough small images have gone by */
+            mem->image_bytes_recent_max =
+                MAX(mem->image_bytes_recent_max, requested);
+            if (++mem->image_arena_small_images >= IMAGE_ARENA_TRIM_COUNT) {
+                mem->image_arena_wanted = mem->image_bytes_recent_max;
+                mem->image_arena_small_images = 0;
+                mem->image_bytes_recent_max = 0;
+            }
+        }
+        else if (requested > 0) {
+            mem->image_arena_small_images = 0;
+            mem->image_bytes_recent_max = 0;
+        }
+#ifdef IMAGE_ARENA_MAX_SIZE
+        if (mem->image_arena_wanted > (size_t)IMAGE_ARENA_MAX_SIZE)
+            mem->image_arena_wanted = (size_t)IMAGE_ARENA_MAX_SIZE;
+#endif
+
+        /* Give a slab that is now too big back right away */
+        if (mem->image_arena != NULL &&
+            mem->image_arena_size > mem->image_arena_wanted) {
+            jpeg_free_large(cinfo, (void FAR*) mem->image_arena,
+                mem->image_arena_size);
+            mem->total_space_allocated -= (long)mem->image_arena_size;
+            mem->image_arena = NULL;
+            mem->image_arena_size = 0;
+        }
+    }
+#endif
+}
+
+
+/*
+ * Count the bytes handed out from the permanent pool.  Permanent objects
+ * are never freed individually, so any allocation there changes this.
+ */
+
+LOCAL(size_t)
+permanent_bytes_used(my_mem_ptr mem)
+{
+    small_pool_ptr shdr_ptr;
+    large_pool_ptr lhdr_ptr;
+    size_t used = 0;
+
+    for (shdr_ptr = mem->small_list[JPOOL_PERMANENT]; shdr_ptr != NULL;
+        shdr_ptr = shdr_ptr->hdr.next)
+        used += shdr_ptr->hdr.bytes_used;
+    for (lhdr_ptr = mem->large_list[JPOOL_PERMANENT]; lhdr_ptr != NULL;
+        lhdr_ptr = lhdr_ptr->hdr.next)
+        used += lhdr_ptr->hdr.bytes_used;
+    return used;
+}
+
+
+/*
+ * Mark the current state of the IMAGE pool, and start tracking the peak
+ * of total_space_allocated from here.  release_to_mark frees everything
+ * allocated in the IMAGE pool since the mark (including virtual arrays)
+ * and returns the peak; objects allocated before the mark are untouched.
+ * This lets jpeg_calc_mem_peak run the module setup as a dry run.
+ * The permanent pool cannot be rolled back, so release_to_mark reports
+ * whether anything was allocated there since the mark.
+ */
+
+METHODDEF(void)
+mark_image_pool(j_common_ptr cinfo)
+{
+    my_mem_ptr mem = (my_mem_ptr)cinfo->mem;
+    small_pool_ptr shdr_ptr;
+
+    mem->small_mark = NULL;
+    for (shdr_ptr = mem->small_list[JPOOL_IMAGE]; shdr_ptr != NULL;
+        shdr_ptr = shdr_ptr->hdr.next) {
+        shdr_ptr->hdr.bytes_marked = shdr_ptr->hdr.bytes_used;
+        mem->small_mark = shdr_ptr;
+    }
+    mem->large_mark = mem->large_list[JPOOL_IMAGE];
+    mem->virt_sarray_mark = mem->virt_sarray_list;
+    mem->virt_barray_mark = mem->virt_barray_list;
+    mem->cleanup_mark = mem->cleanup_list[JPOOL_IMAGE];
+    mem->permanent_used_mark = permanent_bytes_used(mem);
+#ifdef USE_IMAGE_ARENA
+    mem->image_arena_used_mark = mem->image_arena_used;
+    mem->image_bytes_requested_mark = mem->image_bytes_requested;
+#endif
+    mem->peak_space_allocated = mem->total_space_allocated;
+}
+
+
+METHODDEF(long)
+release_to_mark(j_common_ptr cinfo, bool* permanent_changed)
+{
+    my_mem_ptr mem = (my_mem_ptr)cinfo->mem;
+    small_pool_ptr shdr_ptr;
+    large_pool_ptr lhdr_ptr;
+    jvirt_sarray_ptr sptr;
+    jvirt_barray_ptr bptr;
+    size_t space_freed;
+    long peak = mem->peak_space_allocated;
+
+    run_cleanups(cinfo, JPOOL_IMAGE, mem->cleanup_mark);
+
+    /* Close virtual arrays requested since the mark; their control blocks
+     * and buffers are released with the pools below.
+     */
+    for (sptr = mem->virt_sarray_list; sptr != mem->virt_sarray_mark;
+        sptr = sptr->next) {
+        if (sptr->b_s_open) {	/* there may be no backing store */
+            sptr->b_s_open = false;	/* prevent recursive close if error */
+            (*sptr->b_s_info.close_backing_store) (cinfo, &sptr->b_s_info);
+        }
+    }
+    mem->virt_sarray_list = mem->virt_sarray_mark;
+    for (bptr = mem->virt_barray_list; bptr != mem->virt_barray_mark;
+        bptr = bptr->next) {
+        if (bptr->b_s_open) {	/* there may be no backing store */
+            bptr->b_s_open = false;	/* prevent recursive close if error */
+            (*bptr->b_s_info.close_backing_store) (cinfo, &bptr->b_s_info);
+        }
+    }
+    mem->virt_barray_list = mem->virt_barray_mark;
+
+    /* Release large objects pushed since the mark */
+    lhdr_ptr = mem->large_list[JPOOL_IMAGE];
+    while (lhdr_ptr != mem->large_mark) {
+        large_pool_ptr next_lhdr_ptr = lhdr_ptr->hdr.next;
+        space_freed = lhdr_ptr->hdr.bytes_used +
+            lhdr_ptr->hdr.bytes_left +
+            SIZEOF(large_pool_hdr);
+        jpeg_free_large(cinfo, (void FAR*) lhdr_ptr, space_freed);
+        mem->total_space_allocated -= (long)(space_freed);
+        lhdr_ptr = next_lhdr_ptr;
+    }
+    mem->large_list[JPOOL_IMAGE] = lhdr_ptr;
+
+    /* Rewind small pools that existed at the mark, release the newer ones */
+    if (mem->small_mark == NULL) {
+        shdr_ptr = mem->small_list[JPOOL_IMAGE];
+        mem->small_list[JPOOL_IMAGE] = NULL;
+    }
+    else {
+        for (shdr_ptr = mem->small_list[JPOOL_IMAGE]; ;
+            shdr_ptr = shdr_ptr->hdr.next) {
+            shdr_ptr->hdr.bytes_left += shdr_ptr->hdr.bytes_used -
+                shdr_ptr->hdr.bytes_marked;
+            shdr_ptr->hdr.bytes_used = shdr_ptr->hdr.bytes_marked;
+            if (shdr_ptr == mem->small_mark)
+                break;
+        }
+        shdr_ptr = mem->small_mark->hdr.next;
+        mem->small_mark->hdr.next = NULL;
+    }
+    while (shdr_ptr != NULL) {
+        small_pool_ptr next_shdr_ptr = shdr_ptr->hdr.next;
+        space_freed = shdr_ptr->hdr.bytes_used +
+            shdr_ptr->hdr.bytes_left +
+            SIZEOF(small_pool_hdr);
+        jpeg_free_small(cinfo, (void*)shdr_ptr, space_freed);
+        mem->total_space_allocated -= (long)(space_freed);
+        shdr_ptr = next_shdr_ptr;
+    }
+
+#ifdef USE_IMAGE_ARENA
+    /* The slab itself is kept; only its fill level goes back */
+    mem->image_arena_used = mem->image_arena_used_mark;
+    mem->image_bytes_requested = mem->image_bytes_requested_mark;
+#endif
+
+    *permanent_changed = (permanent_bytes_used(mem) != mem->permanent_used_mark);
+    return peak;
 }
 
 
@@ -1042,6 +1425,18 @@ self_destruct(j_common_ptr cinfo)
         free_pool(cinfo, pool);
     }
 
+#ifdef USE_IMAGE_ARENA
+    {
+        my_mem_ptr mem = (my_mem_ptr)cinfo->mem;
+
+        if (mem->image_arena != NULL) {
+            jpeg_free_large(cinfo, (void FAR*) mem->image_arena,
+                mem->image_arena_size);
+            mem->image_arena = NULL;
+        }
+    }
+#endif
+
     /* Release the memory manager control block too. */
     jpeg_free_small(cinfo, (void*)cinfo->mem, SIZEOF(my_memory_mgr));
     cinfo->mem = NULL;		/* ensures I will be called only once */
@@ -1108,6 +1503,9 @@ jinit_memory_mgr(j_common_ptr cinfo)
     mem->pub.access_virt_barray = access_virt_barray;
     mem->pub.free_pool = free_pool;
     mem->pub.self_destruct = self_destruct;
+    mem->pub.mark_image_pool = mark_image_pool;
+    mem->pub.release_to_mark = release_to_mark;
+    mem->pub.register_cleanup = register_cleanup;
 
     /* Make MAX_ALLOC_CHUNK accessible to other modules */
     mem->pub.max_alloc_chunk = MAX_ALLOC_CHUNK;
@@ -1118,11 +1516,31 @@ jinit_memory_mgr(j_common_ptr cinfo)
     for (pool = JPOOL_NUMPOOLS - 1; pool >= JPOOL_PERMANENT; pool--) {
         mem->small_list[pool] = NULL;
         mem->large_list[pool] = NULL;
+        mem->cleanup_list[pool] = NULL;
     }
     mem->virt_sarray_list = NULL;
     mem->virt_barray_list = NULL;
 
+#ifdef USE_IMAGE_ARENA
+    mem->image_arena = NULL;
+    mem->image_arena_size = 0;
+    mem->image_arena_used = 0;
+    mem->image_arena_wanted = 0;
+    mem->image_bytes_requested = 0;
+    mem->image_bytes_recent_max = 0;
+    mem->image_arena_small_images = 0;
+    mem->image_arena_used_mark = 0;
+    mem->image_bytes_requested_mark = 0;
+#endif
+
+    mem->small_mark = NULL;
+    mem->large_mark = NULL;
+    mem->virt_sarray_mark = NULL;
+    mem->virt_barray_mark = NULL;
+    mem->cleanup_mark = NULL;
+
     mem->total_space_allocated = SIZEOF(my_memory_mgr);
+    mem->peak_space_allocated = mem->total_space_allocated;
 
     /* Declare ourselves open for business */
     cinfo->mem = &mem->pub;
@@ -214,9 +214,30 @@ struct jpeg_entropy_decoder {
   /* This is here to share code between baseline and progressive decoders; */
   /* other modules probably should not use it */
   bool insufficient_data;	/* set true after emitting warning */
+
+  /* Zigzag index of the last nonzero coefficient stored into each block
+   * by the latest decode_mcu call (0 if at most the DC term is nonzero).
+   * Set by the sequential decoder only; the single-pass coefficient
+   * controller uses it to pick an IDCT routine for sparse blocks.
+   */
+  int block_last[D_MAX_BLOCKS_IN_MCU];
 };
 
 /* Inverse DCT (also performs dequantization) */
+
+/* Sparseness classes of a coefficient block, decided by the zigzag index
+ * of its last nonzero coefficient.  Zigzag positions 0..2 lie within the
+ * top-left 2x2 coefficients and 0..9 within the top-left 4x4.
+ */
+#define IDCT_DC_ONLY		0	/* at most the DC term is nonzero */
+#define IDCT_SPARSE_2x2		1	/* nonzero terms only in top-left 2x2 */
+#define IDCT_SPARSE_4x4		2	/* nonzero terms only in top-left 4x4 */
+#define IDCT_FULL		3	/* anything */
+#define IDCT_SPARSE_CLASSES	4
+#define IDCT_SPARSE_CLASS(last) \
+	((last) == 0 ? IDCT_DC_ONLY : (last) <= 2 ? IDCT_SPARSE_2x2 : \
+	 (last) <= 9 ? IDCT_SPARSE_4x4 : IDCT_FULL)
+
 typedef JMETHOD(void, inverse_DCT_method_ptr,
 		(j_decompress_ptr cinfo, jpeg_component_info * compptr,
 		 JCOEFPTR coef_block,
@@ -226,8 +247,13 @@ struct jpeg_inverse_dct {
   JMETHOD(void, start_pass, (j_decompress_ptr cinfo));
   /* It is useful to allow each component to have a separate IDCT method. */
   inverse_DCT_method_ptr inverse_DCT[MAX_COMPONENTS];
+  /* Equivalent routines specialized for sparse blocks, indexed by
+   * IDCT_SPARSE_CLASS(block_last) (see jpeg_entropy_decoder).
+   */
+  inverse_DCT_method_ptr inverse_DCT_sparse[MAX_COMPONENTS][IDCT_SPARSE_CLASSES];
 };
 
+
 /* Upsampling (note that upsampler must also call color converter) */
 struct jpeg_upsampler {
   JMETHOD(void, start_pass, (j_decompress_ptr cinfo));
@@ -260,6 +286,21 @@ struct jpeg_color_quantizer {
   JMETHOD(void, new_color_map, (j_decompress_ptr cinfo));
 };
 
+/* Tables kept across images (decompression only).
+ * These live in the permanent pool and are built the first time a module
+ * needs them, so that a decompression object reused for many images does
+ * not rebuild them for each one.  NULL means "not built yet".
+ */
+struct jpeg_decomp_tables {
+  JSAMPLE * sample_range_limit;	/* range-limit table (jdmaster.c) */
+  /* YCbCr->RGB conversion tables (jdcolor.c, jdmerge.c) */
+  int * Cr_r_tab;
+  int * Cb_b_tab;
+  INT32 * Cr_g_tab;
+  INT32 * Cb_g_tab;
+  struct d_huff_cache * huff_cache; /* derived Huffman tables (jdhuff.c) */
+};
+
 
 /* Miscellaneous useful macros */
 
@@ -327,6 +368,10 @@ struct jpeg_color_quantizer {
 #define jzero_far		jZeroFar
 #define jpeg_zigzag_order	jZIGTable
 #define jpeg_natural_order	jZAGTable
+#define jpeg_rgb_red		jRGBred
+#define jpeg_rgb_green		jRGBgreen
+#define jpeg_rgb_blue		jRGBblue
+#define jpeg_rgb_pixelsize	jRGBpixsize
 #endif /* NEED_SHORT_EXTERNAL_NAMES */
 
 
@@ -381,6 +426,16 @@ EXTERN(void) jzero_far JPP((void FAR * target, size_t bytestozero));
 extern const int jpeg_zigzag_order[]; /* natural coef order to zigzag order */
 #endif
 extern const int jpeg_natural_order[]; /* zigzag coef order to natural order */
+/* Pixel layout of each RGB colorspace (JCS_RGB and JCS_EXT_*), indexed by
+ * J_COLOR_SPACE: the offsets of red, green and blue, and the samples per
+ * pixel.  A 4-sample pixel has its extra sample at offset
+ * 6 - red - green - blue.  jpeg_rgb_pixelsize is 0 for other colorspaces.
+ */
+extern const int jpeg_rgb_red[];
+extern const int jpeg_rgb_green[];
+extern const int jpeg_rgb_blue[];
+extern const int jpeg_rgb_pixelsize[];
+#define IS_RGB_SPACE(cs)  (jpeg_rgb_pixelsize[cs] != 0)
 
 /* Suppress undefined-structure complaints if necessary. */
 
@@ -209,9 +209,22 @@ typedef enum {
     JCS_RGB,		/* red/green/blue */
     JCS_YCbCr,		/* Y/Cb/Cr (also known as YUV) */
     JCS_CMYK,		/* C/M/Y/K */
-    JCS_YCCK		/* Y/Cb/Cr/K */
+    JCS_YCCK,		/* Y/Cb/Cr/K */
+    /* RGB in a fixed pixel layout, regardless of RGB_RED etc. in jmorecfg.h.
+     * These are valid only as out_color_space (or in_color_space); the
+     * JPEG file itself is YCbCr or RGB.  The extra sample of a 4-sample
+     * layout is set to MAXJSAMPLE on output and ignored on input.
+     */
+    JCS_EXT_RGB,		/* R/G/B */
+    JCS_EXT_BGR,		/* B/G/R */
+    JCS_EXT_RGBX,		/* R/G/B/unused */
+    JCS_EXT_RGBA,		/* R/G/B/alpha */
+    JCS_EXT_BGRA,		/* B/G/R/alpha */
+    JCS_EXT_ARGB		/* alpha/R/G/B */
 } J_COLOR_SPACE;
 
+#define JPEG_NUMCS  ((int) JCS_EXT_ARGB + 1) /* number of J_COLOR_SPACEs */
+
 /* DCT/IDCT algorithm options. */
 
 typedef enum {
@@ -244,7 +257,8 @@ typedef enum {
   struct jpeg_progress_mgr * progress; /* Progress monitor, or NULL if none */\
   void * client_data;		/* Available for use by application */\
   bool is_decompressor;	/* So common code can tell which is which */\
-  int global_state		/* For checking call sequence validity */
+  int global_state;		/* For checking call sequence validity */\
+  void * mem_arena		/* System-dependent memory arena (jmemsys.h) */
 
 /* Routines that are to be used by both halves of the library are declared
  * to receive a pointer to this structure.  There are no actual instances of
@@ -627,6 +641,7 @@ struct jpeg_decompress_struct {
     struct jpeg_upsampler* upsample;
     struct jpeg_color_deconverter* cconvert;
     struct jpeg_color_quantizer* cquantize;
+    struct jpeg_decomp_tables* tables;
 };
 
 
@@ -752,6 +767,9 @@ struct jpeg_source_mgr {
 typedef struct jvirt_sarray_control* jvirt_sarray_ptr;
 typedef struct jvirt_barray_control* jvirt_barray_ptr;
 
+/* Cleanup routine run before a pool is freed (see register_cleanup) */
+typedef JMETHOD(void, jpeg_cleanup_method, (j_common_ptr cinfo, void* arg));
+
 
 struct jpeg_memory_mgr {
     /* Method pointers */
@@ -790,6 +808,13 @@ struct jpeg_memory_mgr {
         bool writable));
     JMETHOD(void, free_pool, (j_common_ptr cinfo, int pool_id));
     JMETHOD(void, self_destruct, (j_common_ptr cinfo));
+    /* Dry-run support: roll the IMAGE pool back to a marked state */
+    JMETHOD(void, mark_image_pool, (j_common_ptr cinfo));
+    JMETHOD(long, release_to_mark, (j_common_ptr cinfo,
+        bool* permanent_changed));
+    /* Call func(cinfo, arg) just before the pool is next freed */
+    JMETHOD(void, register_cleanup, (j_common_ptr cinfo, int pool_id,
+        jpeg_cleanup_method func, void* arg));
 
     /* Limit on memory allocation for this JPEG object.  (Note that this is
      * merely advisory, not a guaranteed maximum; it only affects the space
@@ -803,6 +828,81 @@ struct jpeg_memory_mgr {
 };
 
 
+/* Allocation statistics and tracing of the system-dependent memory
+ * manager (jmem_impliments.c).  Counters are always kept; events are
+ * recorded into a per-object ring buffer only while tracing is enabled.
+ */
+
+typedef enum {
+    JMEM_GET_SMALL,		/* jpeg_get_small */
+    JMEM_FREE_SMALL,	/* jpeg_free_small */
+    JMEM_GET_LARGE,		/* jpeg_get_large */
+    JMEM_FREE_LARGE		/* jpeg_free_large */
+} J_MEM_EVENT_TYPE;
+
+struct jpeg_mem_stats {
+    long alloc_count;		/* # of successful get_small/get_large calls */
+    long free_count;		/* # of free_small/free_large calls */
+    long fail_count;		/* # of get_small/get_large calls that failed */
+    long bytes_in_use;		/* bytes currently obtained by this object */
+    long peak_bytes_in_use;	/* high-water mark of bytes_in_use */
+};
+
+struct jpeg_mem_event {
+    J_MEM_EVENT_TYPE type;	/* which call */
+    size_t size;			/* requested or released size */
+    void FAR* address;		/* object address; NULL if allocation failed */
+    long bytes_in_use;		/* bytes_in_use after this event */
+    unsigned long long timestamp;	/* nanoseconds since the epoch */
+};
+
+
+/* Result of jpeg_probe (jdprobe.c): what the markers up to the first SOS
+ * say about an image, found without creating a decompression object.
+ */
+
+#define JPEG_PROBE_MAX_MARKERS  32	/* marker positions recorded */
+
+struct jpeg_probe_marker {
+    int marker;			/* marker code (e.g. JPEG_APP0+1) */
+    size_t offset;		/* offset of its 0xFF byte; data begin at offset+4 */
+    size_t data_length;		/* # bytes of data after the length field */
+};
+
+struct jpeg_probe_info {
+    JDIMENSION image_width;	/* from SOFn */
+    JDIMENSION image_height;	/* 0 if defined later by DNL */
+    int num_components;
+    int data_precision;
+    int sof_marker;		/* SOFn marker code, 0 if none seen */
+    bool progressive_mode;
+    bool arith_code;
+    unsigned int restart_interval; /* from DRI, 0 if none */
+    struct {
+        int component_id;
+        int h_samp_factor;
+        int v_samp_factor;
+        int quant_tbl_no;
+    } comp_info[MAX_COMPONENTS];
+
+    bool saw_JFIF_marker;	/* JFIF APP0 marker present */
+    bool saw_Adobe_marker;	/* Adobe APP14 marker present */
+    UINT8 Adobe_transform;	/* color transform code from Adobe marker */
+
+    size_t sos_offset;		/* offset of first SOS marker, 0 if not reached */
+    int marker_count;		/* # markers between SOI and SOS (may exceed */
+    struct jpeg_probe_marker markers[JPEG_PROBE_MAX_MARKERS]; /* the array) */
+};
+
+/* Routine signatures for the chunked data destination (jdatadst_chunk.c).
+ * get_chunk returns an empty buffer of the chunk size; put_chunk receives
+ * each buffer back in output order with the number of bytes stored.
+ */
+typedef JMETHOD(JOCTET*, jpeg_chunk_get_method,
+    (j_compress_ptr cinfo, void* chunk_data));
+typedef JMETHOD(void, jpeg_chunk_put_method,
+    (j_compress_ptr cinfo, void* chunk_data, JOCTET* chunk, size_t datacount));
+
 /* Routine signature for application-supplied marker processing methods.
  * Need not pass marker code since it is stored in cinfo->unread_marker.
  */
@@ -836,6 +936,17 @@ typedef JMETHOD(bool, jpeg_marker_parser_method, (j_decompress_ptr cinfo));
 #define jpeg_destroy_decompress	jDestDecompress
 #define jpeg_stdio_dest		jStdDest
 #define jpeg_stdio_src		jStdSrc
+#define jpeg_stdio_dest_buffered	jStdDestBuf
+#define jpeg_stdio_src_buffered	jStdSrcBuf
+#define jpeg_stdio_dest_sync	jStdDestSync
+#define jpeg_stdio_src_sync	jStdSrcSync
+#define jpeg_chunk_dest		jChunkDest
+#define jpeg_push_src		jPushSrc
+#define jpeg_push_src_append	jPushSrcAppend
+#define jpeg_push_src_end	jPushSrcEnd
+#define jpeg_push_decode	jPushDecode
+#define jpeg_map_src		jMapSrc
+#define jpeg_unmap_src		jUnmapSrc
 #define jpeg_set_defaults	jSetDefaults
 #define jpeg_set_colorspace	jSetColorspace
 #define jpeg_default_colorspace	jDefColorspace
@@ -867,6 +978,9 @@ typedef JMETHOD(bool, jpeg_marker_parser_method, (j_decompress_ptr cinfo));
 #define jpeg_new_colormap	jNewCMap
 #define jpeg_consume_input	jConsumeInput
 #define jpeg_calc_output_dimensions	jCalcDimensions
+#define jpeg_calc_mem_peak	jCalcMemPeak
+#define jpeg_probe		jProbe
+#define jpeg_simd_mask		jSimdMask
 #define jpeg_save_markers	jSaveMarkers
 #define jpeg_set_marker_processor	jSetMarker
 #define jpeg_read_coefficients	jReadCoefs
@@ -912,8 +1026,33 @@ extern "C" {
     /* Caller is responsible for opening the file before and closing after. */
     EXTERN(void) jpeg_stdio_dest JPP((j_compress_ptr cinfo, FILE* outfile));
     EXTERN(void) jpeg_stdio_src JPP((j_decompress_ptr cinfo, FILE* infile));
+    /* Same, with a chosen buffer size and optional helper-thread I/O. */
+    /* The helper thread is stopped by jpeg_finish_*, jpeg_abort and */
+    /* jpeg_destroy; the _sync routines stop it while still mid-image. */
+    EXTERN(void) jpeg_stdio_dest_buffered JPP((j_compress_ptr cinfo,
+        FILE* outfile, size_t buffer_size, bool double_buffered));
+    EXTERN(void) jpeg_stdio_src_buffered JPP((j_decompress_ptr cinfo,
+        FILE* infile, size_t buffer_size, bool double_buffered));
+    EXTERN(void) jpeg_stdio_dest_sync JPP((j_compress_ptr cinfo));
+    EXTERN(void) jpeg_stdio_src_sync JPP((j_decompress_ptr cinfo));
     EXTERN(bool) jpeg_mem_dest(j_compress_ptr cinfo, unsigned char** outbuffer, size_t* outsize, bool allow_allocate_memory);
     EXTERN(bool) jpeg_mem_src(j_decompress_ptr cinfo, const unsigned char* inbuffer, size_t insize);
+    EXTERN(void) jpeg_mem_dest_shrink_to_fit(j_compress_ptr cinfo, bool shrink_to_fit);
+    /* Data destination writing into a chain of application buffers. */
+    EXTERN(void) jpeg_chunk_dest JPP((j_compress_ptr cinfo, size_t chunk_size,
+        jpeg_chunk_get_method get_chunk, jpeg_chunk_put_method put_chunk,
+        void* chunk_data));
+    /* Data source reading a memory-mapped file in place (no copy, no size limit). */
+    /* The file is unmapped by jpeg_finish_decompress, jpeg_abort or jpeg_destroy. */
+    EXTERN(bool) jpeg_map_src(j_decompress_ptr cinfo, const char* path);
+    EXTERN(void) jpeg_unmap_src(j_decompress_ptr cinfo);
+    /* Suspending data source fed by the application (see jdatasrc_push.c). */
+    EXTERN(void) jpeg_push_src JPP((j_decompress_ptr cinfo));
+    EXTERN(void) jpeg_push_src_append JPP((j_decompress_ptr cinfo,
+        const JOCTET* data, size_t size));
+    EXTERN(void) jpeg_push_src_end JPP((j_decompress_ptr cinfo));
+    EXTERN(int) jpeg_push_decode JPP((j_decompress_ptr cinfo,
+        JSAMPARRAY scanlines, JDIMENSION max_lines, JDIMENSION* lines_read));
 
     /* Default parameter setup for compression */
     EXTERN(void) jpeg_set_defaults JPP((j_compress_ptr cinfo));
@@ -970,6 +1109,7 @@ extern "C" {
 #define JPEG_SUSPENDED		0 /* Suspended due to lack of input data */
 #define JPEG_HEADER_OK		1 /* Found valid image datastream */
 #define JPEG_HEADER_TABLES_ONLY	2 /* Found valid table-specs-only datastream */
+#define JPEG_PROBE_INVALID	(-1) /* jpeg_probe: not a JPEG, or bad marker */
 /* If you pass require_image = true (normal case), you need not check for
  * a TABLES_ONLY return code; an abbreviated file will cause an error exit.
  * JPEG_SUSPENDED is only possible if you use a data source module that can
@@ -1006,6 +1146,13 @@ extern "C" {
 /* Precalculate output dimensions for current decompression parameters. */
     EXTERN(void) jpeg_calc_output_dimensions JPP((j_decompress_ptr cinfo));
 
+    /* Read image parameters straight from a buffer, without a JPEG object. */
+    EXTERN(int) jpeg_probe JPP((const JOCTET* data, size_t size,
+        struct jpeg_probe_info* info));
+
+    /* Predict peak memory use of decompression with current parameters. */
+    EXTERN(long) jpeg_calc_mem_peak JPP((j_decompress_ptr cinfo));
+
     /* Control saving of COM and APPn markers into marker_list. */
     EXTERN(void) jpeg_save_markers
         JPP((j_decompress_ptr cinfo, int marker_code,
@@ -1042,6 +1189,25 @@ extern "C" {
     EXTERN(bool) jpeg_resync_to_restart JPP((j_decompress_ptr cinfo,
         int desired));
 
+    /* Memory allocation statistics and tracing (jmem_impliments.c) */
+    EXTERN(void) jpeg_mem_set_trace JPP((j_common_ptr cinfo, bool enable));
+    EXTERN(void) jpeg_mem_get_stats JPP((j_common_ptr cinfo,
+        struct jpeg_mem_stats* stats));
+    EXTERN(int) jpeg_mem_get_trace JPP((j_common_ptr cinfo,
+        struct jpeg_mem_event* events, int max_events));
+    /* Release memory slabs kept for reuse after jpeg_destroy */
+    EXTERN(void) jpeg_mem_purge_slabs JPP((void));
+
+    /* Restrict the SIMD routines to the instruction sets in mask (jsimd.c).
+     * Takes effect for modules set up afterwards, in any JPEG object.
+     */
+    EXTERN(void) jpeg_simd_mask JPP((int mask));
+    /* mask is a combination of: */
+#define JPEG_SIMD_NONE		0x00 /* C code only */
+#define JPEG_SIMD_SSE2		0x01 /* SSE2 routines */
+#define JPEG_SIMD_AVX2		0x02 /* AVX2 routines */
+#define JPEG_SIMD_ALL		0xFF /* whatever the CPU supports (default) */
+
 #ifdef __cplusplus
 }
 #endif
@@ -1085,6 +1251,7 @@ struct jpeg_inverse_dct { long dummy; };
 struct jpeg_upsampler { long dummy; };
 struct jpeg_color_deconverter { long dummy; };
 struct jpeg_color_quantizer { long dummy; };
+struct jpeg_decomp_tables { long dummy; };
 #endif /* JPEG_INTERNALS */
 #endif /* INCOMPLETE_TYPES_BROKEN */
 
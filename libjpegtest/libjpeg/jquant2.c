@@ -196,6 +196,7 @@ typedef struct {
     /* Space for the eventually created colormap is stashed here */
     JSAMPARRAY sv_colormap;	/* colormap allocated at init time */
     int desired;			/* desired # of colors = size of colormap */
+    struct box_struct* boxlist;	/* workspace for select_colors */
 
     /* Variables for accumulating image statistics */
     hist3d histogram;		/* pointer to the histogram */
@@ -255,7 +256,7 @@ prescan_quantize(j_decompress_ptr cinfo, JSAMPARRAY input_buf,
  * subset of the input color space (to histogram precision).
  */
 
-typedef struct {
+typedef struct box_struct {
     /* The bounds of the box (inclusive); expressed as histogram indexes */
     int c0min, c0max;
     int c1min, c1max;
@@ -540,13 +541,11 @@ LOCAL(void)
 select_colors(j_decompress_ptr cinfo, int desired_colors)
 /* Master routine for color selection */
 {
-    boxptr boxlist;
+    my_cquantize_ptr cquantize = (my_cquantize_ptr)cinfo->cquantize;
+    boxptr boxlist = cquantize->boxlist; /* allocated at init time */
     int numboxes;
     int i;
 
-    /* Allocate workspace for box list */
-    boxlist = (boxptr)(*cinfo->mem->alloc_small)
-        ((j_common_ptr)cinfo, JPOOL_IMAGE, desired_colors * SIZEOF(box));
     /* Initialize one box containing whole space */
     numboxes = 1;
     boxlist[0].c0min = 0;
@@ -1297,9 +1296,14 @@ jinit_2pass_quantizer(j_decompress_ptr cinfo)
         cquantize->sv_colormap = (*cinfo->mem->alloc_sarray)
             ((j_common_ptr)cinfo, JPOOL_IMAGE, (JDIMENSION)desired, (JDIMENSION)3);
         cquantize->desired = desired;
+        /* The box list for color selection is reused by every prescan pass */
+        cquantize->boxlist = (boxptr)(*cinfo->mem->alloc_small)
+            ((j_common_ptr)cinfo, JPOOL_IMAGE, desired * SIZEOF(box));
     }
-    else
+    else {
         cquantize->sv_colormap = NULL;
+        cquantize->boxlist = NULL;
+    }
 
     /* Only F-S dithering or no dithering is supported. */
     /* If user asks for ordered dither, give him F-S. */
@@ -0,0 +1,148 @@
+/*
+ * jsimd.c
+ *
+ * This file contains the CPU feature detection that decides which SIMD
+ * routines (see jsimd.h) may be used.
+ */
+
+#define JPEG_INTERNALS
+#include "jinclude.h"
+#include "jpeglib.h"
+#include "jsimd.h"
+
+
+/* Instruction sets the application allows (see jpeg_simd_mask) */
+static volatile int simd_mask = JPEG_SIMD_ALL;
+
+
+/*
+ * Restrict the SIMD routines to the instruction sets in mask, e.g.
+ * JPEG_SIMD_NONE to force the C code when comparing against it.
+ * Modules pick their routines when they are initialized, so this affects
+ * jpeg_start_compress/jpeg_start_decompress calls made afterwards.
+ */
+
+GLOBAL(void)
+jpeg_simd_mask(int mask)
+{
+    simd_mask = mask;
+}
+
+#ifdef JSIMD_X86
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#include <immintrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+#ifndef HAVE_STDLIB_H		/* <stdlib.h> should declare getenv() */
+extern char* getenv JPP((const char* name));
+#endif
+
+
+/* CPUID bits */
+#define CPUID1_EDX_SSE2		(1 << 26)
+#define CPUID1_ECX_OSXSAVE	(1 << 27)
+#define CPUID1_ECX_AVX		(1 << 28)
+#define CPUID7_EBX_AVX2		(1 << 5)
+/* XCR0 bits: the OS saves XMM and YMM state */
+#define XCR0_XMM_YMM		0x06
+
+
+LOCAL(void)
+get_cpuid(unsigned int leaf, unsigned int regs[4])
+/* regs[] receives EAX, EBX, ECX, EDX; all zero if leaf is not supported */
+{
+#ifdef _MSC_VER
+    int info[4];
+
+    __cpuid(info, 0);
+    if ((unsigned int)info[0] < leaf) {
+        regs[0] = regs[1] = regs[2] = regs[3] = 0;
+        return;
+    }
+    __cpuidex(info, (int)leaf, 0);
+    regs[0] = (unsigned int)info[0];
+    regs[1] = (unsigned int)info[1];
+    regs[2] = (unsigned int)info[2];
+    regs[3] = (unsigned int)info[3];
+#else
+    if (!__get_cpuid_count(leaf, 0, &regs[0], &regs[1], &regs[2], &regs[3]))
+        regs[0] = regs[1] = regs[2] = regs[3] = 0;
+#endif
+}
+
+
+LOCAL(unsigned int)
+get_xcr0(void)
+/* Call only when CPUID reports OSXSAVE */
+{
+#ifdef _MSC_VER
+    return (unsigned int)_xgetbv(0);
+#else
+    unsigned int eax, edx;
+
+    __asm__ volatile ("xgetbv" : "=a" (eax), "=d" (edx) : "c" (0));
+    return eax;
+#endif
+}
+
+
+LOCAL(int)
+detect_simd(void)
+{
+    unsigned int regs[4];
+    int support = 0;
+
+    get_cpuid(1, regs);
+    if (regs[3] & CPUID1_EDX_SSE2)
+        support |= JSIMD_SSE2;
+    if ((regs[2] & CPUID1_ECX_OSXSAVE) && (regs[2] & CPUID1_ECX_AVX) &&
+        (get_xcr0() & XCR0_XMM_YMM) == XCR0_XMM_YMM) {
+        get_cpuid(7, regs);
+        if (regs[1] & CPUID7_EBX_AVX2)
+            support |= JSIMD_AVX2;
+    }
+
+    /* Check for an environment variable JPEGSIMD; "none" disables all
+     * SIMD routines and "sse2" disables those that need AVX2, as
+     * jpeg_simd_mask does.  If your system doesn't support getenv(),
+     * define NO_GETENV to disable this feature; jpeg_simd_mask still works.
+     */
+#ifndef NO_GETENV
+    {
+        char* simdenv;
+
+        if ((simdenv = getenv("JPEGSIMD")) != NULL) {
+            if (strcmp(simdenv, "none") == 0)
+                support = 0;
+            else if (strcmp(simdenv, "sse2") == 0)
+                support &= JSIMD_SSE2;
+        }
+    }
+#endif
+
+    return support;
+}
+
+
+/*
+ * Report which instruction sets may be used, as a mask of JSIMD_ bits:
+ * those the CPU supports, less any the application has masked off.
+ * Detection runs once; racing first calls from several threads all store
+ * the same value.
+ */
+
+GLOBAL(int)
+jpeg_simd_support(void)
+{
+    static volatile int simd_support = -1;
+
+    if (simd_support < 0)
+        simd_support = detect_simd();
+    return simd_support & simd_mask;
+}
+
+#endif /* JSIMD_X86 */
@@ -0,0 +1,135 @@
+/*
+ * jsimd.h
+ *
+ * This file contains declarations for the SIMD (SSE2/AVX2) versions of
+ * the inner loops.  They are used only on x86 and x86-64, and only when
+ * the CPU in hand supports the instruction set; the module managers ask
+ * jpeg_simd_support which routines may be selected.  Every SIMD routine
+ * produces exactly the same output as the C routine it replaces.
+ * Define NO_SIMD to build without any of them.
+ */
+
+#ifndef NO_SIMD
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define JSIMD_X86			/* SIMD routines are compiled in */
+#endif
+#endif
+
+#ifdef JSIMD_X86
+
+/* Short forms of external names for systems with brain-damaged linkers. */
+
+#ifdef NEED_SHORT_EXTERNAL_NAMES
+#define jpeg_simd_support	jSimdSupport
+#define jpeg_idct_islow_sse2	jRDislowsse2
+#define jpeg_idct_islow_avx2	jRDislowavx2
+#define jpeg_fdct_islow_quantize_sse2	jFDislowqsse2
+#define jpeg_fdct_ifast_quantize_sse2	jFDifastqsse2
+#define jpeg_ycc_rgb_convert_sse2	jYCCrgbsse2
+#define jpeg_rgb_ycc_convert_sse2	jRGByccsse2
+#endif /* NEED_SHORT_EXTERNAL_NAMES */
+
+
+/* Instruction sets reported by jpeg_simd_support (same bits as the
+ * JPEG_SIMD_ mask in jpeglib.h)
+ */
+
+#define JSIMD_SSE2	JPEG_SIMD_SSE2
+#define JSIMD_AVX2	JPEG_SIMD_AVX2
+
+/* GCC and Clang compile intrinsics only inside functions marked with the
+ * instruction set they need; MSVC accepts them anywhere.
+ */
+
+#if defined(__GNUC__) || defined(__clang__)
+#define JSIMD_TARGET_SSE2  __attribute__((target("sse2")))
+#define JSIMD_TARGET_AVX2  __attribute__((target("avx2")))
+#else
+#define JSIMD_TARGET_SSE2
+#define JSIMD_TARGET_AVX2
+#endif
+
+/* Helpers must be inlined into their callers: they pass vectors through
+ * arrays, and an AVX2 routine must not call code without VEX encoding.
+ */
+
+#ifdef _MSC_VER
+#define JSIMD_INLINE  __forceinline
+#elif defined(__GNUC__) || defined(__clang__)
+#define JSIMD_INLINE  __inline__ __attribute__((always_inline))
+#else
+#define JSIMD_INLINE  INLINE
+#endif
+
+
+/* A pmaddwd constant: a multiplies the first input of each pair, b the
+ * second.
+ */
+#define PAIR(a,b)  ((int) (((unsigned int) (b) << 16) | ((a) & 0xFFFF)))
+
+/* Transpose eight rows of eight 16-bit values (__m128i r[8]) in place */
+
+#define TRANSPOSE_8X8_EPI16(r) { \
+    __m128i a0, a1, a2, a3, a4, a5, a6, a7; \
+    __m128i b0, b1, b2, b3, b4, b5, b6, b7; \
+    a0 = _mm_unpacklo_epi16(r[0], r[1]);  a1 = _mm_unpackhi_epi16(r[0], r[1]); \
+    a2 = _mm_unpacklo_epi16(r[2], r[3]);  a3 = _mm_unpackhi_epi16(r[2], r[3]); \
+    a4 = _mm_unpacklo_epi16(r[4], r[5]);  a5 = _mm_unpackhi_epi16(r[4], r[5]); \
+    a6 = _mm_unpacklo_epi16(r[6], r[7]);  a7 = _mm_unpackhi_epi16(r[6], r[7]); \
+    b0 = _mm_unpacklo_epi32(a0, a2);  b1 = _mm_unpackhi_epi32(a0, a2); \
+    b2 = _mm_unpacklo_epi32(a1, a3);  b3 = _mm_unpackhi_epi32(a1, a3); \
+    b4 = _mm_unpacklo_epi32(a4, a6);  b5 = _mm_unpackhi_epi32(a4, a6); \
+    b6 = _mm_unpacklo_epi32(a5, a7);  b7 = _mm_unpackhi_epi32(a5, a7); \
+    r[0] = _mm_unpacklo_epi64(b0, b4);  r[1] = _mm_unpackhi_epi64(b0, b4); \
+    r[2] = _mm_unpacklo_epi64(b1, b5);  r[3] = _mm_unpackhi_epi64(b1, b5); \
+    r[4] = _mm_unpacklo_epi64(b2, b6);  r[5] = _mm_unpackhi_epi64(b2, b6); \
+    r[6] = _mm_unpacklo_epi64(b3, b7);  r[7] = _mm_unpackhi_epi64(b3, b7); \
+  }
+
+
+EXTERN(int) jpeg_simd_support JPP((void));
+
+/* Inverse DCT routines (jidctsimd.c).  jddctmgr.c keeps a copy of the
+ * islow multipliers in 16 bits right after the islow multiplier table.
+ */
+#define ISLOW_SIMD_TABLE(compptr) \
+    ((INT16 *) ((ISLOW_MULT_TYPE *) (compptr)->dct_table + DCTSIZE2))
+
+
+EXTERN(void) jpeg_idct_islow_sse2
+    JPP((j_decompress_ptr cinfo, jpeg_component_info * compptr,
+	 JCOEFPTR coef_block, JSAMPARRAY output_buf, JDIMENSION output_col));
+EXTERN(void) jpeg_idct_islow_avx2
+    JPP((j_decompress_ptr cinfo, jpeg_component_info * compptr,
+	 JCOEFPTR coef_block, JSAMPARRAY output_buf, JDIMENSION output_col));
+
+/* Forward DCT routines (jfdctsimd.c).  Each does the work of forward_DCT
+ * in jcdctmgr.c for num_blocks blocks: it loads the samples, performs the
+ * DCT and quantizes with a reciprocal table (see jdct.h).  The table's
+ * divisors must lie in 3..65535.
+ */
+typedef JMETHOD(void, quantize_DCT_method_ptr,
+		(JSAMPARRAY sample_data, JDIMENSION start_col,
+		 JBLOCKROW coef_blocks, JDIMENSION num_blocks,
+		 UINT16 * reciprocals));
+
+EXTERN(void) jpeg_fdct_islow_quantize_sse2
+    JPP((JSAMPARRAY sample_data, JDIMENSION start_col,
+	 JBLOCKROW coef_blocks, JDIMENSION num_blocks, UINT16 * reciprocals));
+EXTERN(void) jpeg_fdct_ifast_quantize_sse2
+    JPP((JSAMPARRAY sample_data, JDIMENSION start_col,
+	 JBLOCKROW coef_blocks, JDIMENSION num_blocks, UINT16 * reciprocals));
+
+/* Color conversion (jccolsimd.c, jdcolsimd.c).  The RGB colorspace must
+ * be one of the JCS_EXT_ spaces; see jccolor.c and jdcolor.c for JCS_RGB.
+ */
+EXTERN(void) jpeg_rgb_ycc_convert_sse2
+    JPP((JSAMPARRAY input_buf, JSAMPIMAGE output_buf,
+	 JDIMENSION output_row, int num_rows, JDIMENSION num_cols,
+	 J_COLOR_SPACE in_color_space));
+EXTERN(void) jpeg_ycc_rgb_convert_sse2
+    JPP((JSAMPIMAGE input_buf, JDIMENSION input_row,
+	 JSAMPARRAY output_buf, int num_rows, JDIMENSION num_cols,
+	 J_COLOR_SPACE out_color_space));
+
+#endif /* JSIMD_X86 */
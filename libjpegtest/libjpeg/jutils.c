@@ -64,6 +64,34 @@ const int jpeg_natural_order[DCTSIZE2 + 16] = {
 };
 
 
+/*
+ * Pixel layouts of the RGB colorspaces, indexed by J_COLOR_SPACE
+ * (JCS_UNKNOWN, GRAYSCALE, RGB, YCbCr, CMYK, YCCK, then the JCS_EXT_ spaces
+ * EXT_RGB, EXT_BGR, EXT_RGBX, EXT_RGBA, EXT_BGRA, EXT_ARGB).
+ * JCS_RGB follows the compile-time layout in jmorecfg.h.
+ */
+
+const int jpeg_rgb_red[JPEG_NUMCS] = {
+  -1, -1, RGB_RED, -1, -1, -1,
+  0, 2, 0, 0, 2, 1
+};
+
+const int jpeg_rgb_green[JPEG_NUMCS] = {
+  -1, -1, RGB_GREEN, -1, -1, -1,
+  1, 1, 1, 1, 1, 2
+};
+
+const int jpeg_rgb_blue[JPEG_NUMCS] = {
+  -1, -1, RGB_BLUE, -1, -1, -1,
+  2, 0, 2, 2, 0, 3
+};
+
+const int jpeg_rgb_pixelsize[JPEG_NUMCS] = {
+  0, 0, RGB_PIXELSIZE, 0, 0, 0,
+  3, 3, 4, 4, 4, 4
+};
+
+
 /*
  * Arithmetic utilities
  */
@@ -0,0 +1,86 @@
+#include "mem_file_map.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+/**
+ * Map a whole file read-only, advising the OS that it will be read sequentially.
+ * The file itself need not stay open while mapped.
+ *
+ * @param path File path.
+ * @param psize Variable to store file size.
+ * @retval Address of mapping.
+ * @retval NULL Failed. (Including empty file, which can not be mapped)
+ */
+mem_addr_t mem_file_map(const char* path, size_t* psize)
+{
+    void* address = NULL;
+    *psize = 0;
+#if defined(_WIN32)
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        return NULL;
+    }
+    LARGE_INTEGER file_size;
+    if (GetFileSizeEx(file, &file_size) && (file_size.QuadPart > 0)
+        && ((uint64_t)(file_size.QuadPart) <= (uint64_t)(SIZE_MAX))) {
+        HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mapping != NULL) {
+            address = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            CloseHandle(mapping); // The view keeps the mapping alive.
+        }
+        if (address != NULL) {
+            *psize = (size_t)(file_size.QuadPart);
+        }
+    }
+    CloseHandle(file);
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat file_stat;
+    if ((fstat(fd, &file_stat) == 0) && (file_stat.st_size > 0)
+        && ((uint64_t)(file_stat.st_size) <= (uint64_t)(SIZE_MAX))) {
+        size_t size = (size_t)(file_stat.st_size);
+        address = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (address == MAP_FAILED) {
+            address = NULL;
+        }
+        else {
+#if defined(MADV_SEQUENTIAL)
+            madvise(address, size, MADV_SEQUENTIAL); // Advice only. Read ahead aggressively, drop pages behind.
+#endif
+            *psize = size;
+        }
+    }
+    close(fd); // The mapping keeps the file alive.
+#endif
+    return (mem_addr_t)(address);
+}
+
+/**
+ * Unmap a file mapped by mem_file_map().
+ *
+ * @param address Address of mapping.
+ * @param size Size of mapping. (Same as returned by mem_file_map())
+ */
+void mem_file_unmap(mem_addr_t address, size_t size)
+{
+    if (address == NULL) {
+        return;
+    }
+#if defined(_WIN32)
+    (void)(size);
+    UnmapViewOfFile(address);
+#else
+    munmap(address, size);
+#endif
+}
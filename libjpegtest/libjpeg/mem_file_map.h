@@ -0,0 +1,12 @@
+#ifndef MEM_FILE_MAP_H
+#define MEM_FILE_MAP_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "mem_region.h"
+
+mem_addr_t mem_file_map(const char *path, size_t *psize);
+void mem_file_unmap(mem_addr_t address, size_t size);
+
+#endif // MEM_FILE_MAP_H
@@ -2,6 +2,7 @@
 #define MEM_REGION_H
 
 #include <stdint.h>
+#include <stdbool.h>
 
 typedef uint8_t* mem_addr_t;
 typedef uint32_t mem_size_t;
@@ -9,8 +10,13 @@ typedef uint32_t mem_size_t;
 struct mem_region {
     mem_addr_t address; // Address.
     mem_size_t length; // Length.
-    struct mem_region *prev; // Previous entry.
-    struct mem_region *next; // Next entry.
+    bool is_free; // Region is free?
+    uint16_t spare_count; // Number of unused entries in the chunk. (Only for the entry describing a chunk)
+    struct mem_region *prev; // Previous entry. (Used list, free bin or unused entries)
+    struct mem_region *next; // Next entry. (Used list, free bin or unused entries)
+    struct mem_region *lower; // Adjacent region at lower address.
+    struct mem_region *upper; // Adjacent region at upper address.
+    struct mem_region *chunk; // Entry describing the chunk which holds this entry. (NULL for initial entries)
 };
 
 #endif /* MEM_REGION_H */
@@ -1,15 +1,32 @@
 #include <stddef.h>
 #include "mem_region_list.h"
 
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#if MEM_REGION_LIST_USE_LOCK && defined(_WIN32)
+#include <windows.h>
+#endif
+
 static struct mem_region* get_free_entry(mem_region_list_t* list);
-static struct mem_region* find_insert_entry(struct mem_region* head, mem_addr_t address);
+static void put_free_entry(mem_region_list_t* list, struct mem_region* pentry);
+static void push_spare_entry(mem_region_list_t* list, struct mem_region* pentry);
+static void remove_spare_entry(mem_region_list_t* list, struct mem_region* pentry);
+static bool grow_entries(mem_region_list_t* list, struct mem_region* blank_region_entry, mem_size_t keep_length);
+static bool is_unused_chunk(const struct mem_region* pentry);
+static void drop_chunk(mem_region_list_t* list, struct mem_region* chunk);
+static struct mem_region* return_chunks(mem_region_list_t* list, struct mem_region* pentry);
+static void return_reclaimed_chunks(mem_region_list_t* list);
 static void insert_entry(struct mem_region* prev_entry, struct mem_region* pentry);
-static void release_entry(struct mem_region* pentry);
 static void remove_entry(struct mem_region* pentry);
-static uint32_t get_entry_count(const struct mem_region* head);
-static struct mem_region* find_blank_region(struct mem_region* head, mem_size_t length);
-static struct mem_region* find_region(struct mem_region* head, mem_addr_t address);
-static void arrange_regions(struct mem_region* head);
+static void insert_bin(mem_region_list_t* list, struct mem_region* pentry);
+static void remove_bin(mem_region_list_t* list, struct mem_region* pentry);
+static struct mem_region* find_blank_region(mem_region_list_t* list, mem_size_t length);
+static struct mem_region* find_region(mem_region_list_t* list, mem_addr_t address);
+static struct mem_region* combine_region(mem_region_list_t* list, struct mem_region* lower, struct mem_region* upper);
+static uint32_t get_bin_index(mem_size_t length);
+static uint32_t get_lowest_bit_index(uint32_t bits);
+static int32_t get_cache_class(mem_size_t length);
 
 static void init_lock(mem_region_list_t* list);
 static void destroy_lock(mem_region_list_t* list);
@@ -17,7 +34,18 @@ static void lock(mem_region_list_t* list);
 static void unlock(mem_region_list_t* list);
 
 
-#define ALIGNMENT_SIZE (4u)
+#define ALIGNMENT_SIZE (8u)
+
+/**
+ * Size of boundary tag placed in front of each assigned region.
+ * The tag holds the region entry, so release can find it without searching.
+ */
+#define TAG_SIZE (((sizeof(struct mem_region*) + ALIGNMENT_SIZE - 1) / ALIGNMENT_SIZE) * ALIGNMENT_SIZE)
+
+/**
+ * Maximum length to assign. (Avoid overflow on rounding up)
+ */
+#define MAX_ASSIGN_LENGTH ((mem_size_t)(UINT32_MAX - ALIGNMENT_SIZE - TAG_SIZE))
 
 /**
  * Initialize memory region list.
@@ -25,15 +53,16 @@ static void unlock(mem_region_list_t* list);
  * @param list A list to initialize region.
  * @param address Start address to assign list.
  * @param length Length of memory area.
- * @param entries Entris to use at this list.
+ * @param entries Entris to use at this list. (Initial entries)
  * @param entry_count Count of entries.
+ * @param shared true if the list is shared between threads. Only a shared list takes the lock.
  * @retval true
  *           Succeed.
  * @retval false
  *           Failure. Invalid argument passed.
  */
 bool mem_region_list_init(mem_region_list_t* list, mem_addr_t address, mem_size_t length,
-    struct mem_region* entries, int32_t entry_count)
+    struct mem_region* entries, int32_t entry_count, bool shared)
 {
     if ((list == NULL) || (entries == NULL) || (entry_count < 2L))
     {
@@ -41,12 +70,19 @@ bool mem_region_list_init(mem_region_list_t* list, mem_addr_t address, mem_size_
     }
     list->entries = entries;
     list->entry_count = entry_count;
-    for (int32_t i = 0L; i < entry_count; i++)
+    list->initial_entry_count = entry_count;
+    list->spare = NULL;
+    for (int32_t i = entry_count - 1L; i >= 0L; i--)
     {
         entries[i].address = NULL;
         entries[i].length = 0u;
         entries[i].prev = NULL;
-        entries[i].next = NULL;
+        entries[i].lower = NULL;
+        entries[i].upper = NULL;
+        entries[i].is_free = false;
+        entries[i].chunk = NULL;
+        entries[i].spare_count = 0u;
+        put_free_entry(list, &(entries[i]));
     }
     list->used.address = NULL;
     list->used.length = 0u;
@@ -56,12 +92,27 @@ bool mem_region_list_init(mem_region_list_t* list, mem_addr_t address, mem_size_
     list->free.length = length;
     list->free.next = &(list->free);
     list->free.prev = &(list->free);
+    list->reclaim.next = &(list->reclaim);
+    list->reclaim.prev = &(list->reclaim);
+    for (uint32_t i = 0u; i < MEM_REGION_BIN_COUNT; i++) {
+        list->bins[i].address = NULL;
+        list->bins[i].length = 0u;
+        list->bins[i].next = &(list->bins[i]);
+        list->bins[i].prev = &(list->bins[i]);
+    }
+    list->bin_map = 0u;
+    list->used_count = 0u;
+
+    if (length > 0u) {
+        struct mem_region* pentry = get_free_entry(list);
+        pentry->address = address;
+        pentry->length = length;
+        pentry->lower = NULL;
+        pentry->upper = NULL;
+        insert_bin(list, pentry);
+    }
 
-    struct mem_region* pentry = get_free_entry(list);
-    pentry->address = address;
-    pentry->length = length;
-    insert_entry(find_insert_entry(&(list->free), address), pentry);
-
+    list->shared = shared;
     init_lock(list);
 
     return true;
@@ -79,8 +130,12 @@ void mem_region_list_destroy(mem_region_list_t* list)
     list->used.length = 0u;
     list->free.address = NULL;
     list->free.length = 0u;
+    list->bin_map = 0u;
+    list->spare = NULL;
+    list->used_count = 0u;
     list->entries = NULL;
     list->entry_count = 0u;
+    list->initial_entry_count = 0u;
 
     return;
 }
@@ -108,7 +163,7 @@ mem_size_t mem_region_list_get_free(const mem_region_list_t* list)
 
 /**
  * Getting entry count.
- * 
+ *
  * @param list A list to get entry count.
  * @param pfree Variable to store free count. (If not need, set NULL)
  * @param pused Variable to store used count. (If not need, set NULL)
@@ -117,59 +172,93 @@ void mem_region_list_get_entry_count(const mem_region_list_t* list, uint32_t* pf
     if (list == NULL) {
         return;
     }
-    uint32_t used_count = get_entry_count(&list->used);
+    uint32_t used_count = list->used_count;
     if (pused != NULL) {
         (*pused) = used_count;
     }
     if (pfree != NULL) {
         (*pfree) = list->entry_count - used_count;
     }
-    
+
     return;
 }
 
 
 /**
  * Assign region.
+ *
+ * Free region is searched from size-segregated bins,
+ * and the front part of it is assigned.
+ *
+ * @param list Region list.
+ * @param length Length to assign.
+ * @retval NULL
+ *           No space left on list.
+ * @retval Non-NULL
+ *           Assigned address.
  */
 mem_addr_t mem_region_list_assign(mem_region_list_t* list, mem_size_t length)
 {
-    if ((list == NULL) || (length <= 0u)) {
+    if ((list == NULL) || (length <= 0u) || (length > MAX_ASSIGN_LENGTH)) {
         return NULL;
     }
 
-    mem_size_t needs_length = ((length + ALIGNMENT_SIZE - 1) / ALIGNMENT_SIZE) * ALIGNMENT_SIZE;
+    mem_size_t needs_length = ((length + ALIGNMENT_SIZE - 1) / ALIGNMENT_SIZE) * ALIGNMENT_SIZE + TAG_SIZE;
 
     mem_addr_t ret = NULL;
 
     lock(list);
 
-    struct mem_region* pentry = get_free_entry(list);
-    if (pentry == NULL) { // No left region entry?
+    struct mem_region* blank_region_entry = find_blank_region(list, needs_length);
+    if (blank_region_entry == NULL) { // No left region?
         ret = NULL;
     }
     else {
-        struct mem_region* blank_region_entry = find_blank_region(&(list->free), needs_length);
-        if (blank_region_entry == NULL) { // No left region?
-            ret = NULL;
+        struct mem_region* pentry;
+        remove_bin(list, blank_region_entry);
+        if ((blank_region_entry->length != needs_length) && (list->spare == NULL)) { // No unused entry to split region?
+            // Add entries from the part of region which is left after assigning.
+            // If it is too short, add them from the largest other free region.
+            if (!grow_entries(list, blank_region_entry, needs_length) && (list->bin_map != 0u)) {
+                struct mem_region* largest_entry = list->bins[get_bin_index(list->bin_map)].next; // From highest bin.
+                remove_bin(list, largest_entry);
+                (void)(grow_entries(list, largest_entry, 0u));
+                insert_bin(list, largest_entry);
+            }
+        }
+        if (blank_region_entry->length == needs_length) { // Just fit?
+            pentry = blank_region_entry;
         }
         else {
-            // Assign memory.
-            pentry->address = blank_region_entry->address;
-            pentry->length = needs_length;
-            blank_region_entry->address += needs_length;
-            blank_region_entry->length -= needs_length;
-
-            if (blank_region_entry->length <= 0u) {
-                release_entry(blank_region_entry);
+            pentry = get_free_entry(list);
+            if (pentry != NULL) {
+                // Split front part of blank region.
+                pentry->address = blank_region_entry->address;
+                pentry->length = needs_length;
+                pentry->lower = blank_region_entry->lower;
+                pentry->upper = blank_region_entry;
+                if (pentry->lower != NULL) {
+                    pentry->lower->upper = pentry;
+                }
+                blank_region_entry->lower = pentry;
+                blank_region_entry->address += needs_length;
+                blank_region_entry->length -= needs_length;
             }
+            insert_bin(list, blank_region_entry);
+        }
+
+        if (pentry != NULL) {
+            // Assign memory.
+            pentry->is_free = false;
+            *((struct mem_region**)(pentry->address)) = pentry; // Write boundary tag.
 
             list->free.length -= needs_length;
             list->used.length += needs_length;
+            list->used_count++;
 
-            insert_entry(find_insert_entry(&(list->used), pentry->address), pentry);
+            insert_entry(&(list->used), pentry);
 
-            ret = pentry->address;
+            ret = pentry->address + TAG_SIZE;
         }
     }
 
@@ -181,6 +270,8 @@ mem_addr_t mem_region_list_assign(mem_region_list_t* list, mem_size_t length)
 /**
  * Release region.
  *
+ * Released region is combined with adjacent free regions.
+ *
  * @param list Region list.
  * @param address Release region address.
  */
@@ -192,24 +283,118 @@ void mem_region_list_release(mem_region_list_t* list, mem_addr_t address)
 
     lock(list);
 
-    struct mem_region* pentry = find_region(&(list->used), address);
+    struct mem_region* pentry = find_region(list, address);
     if (pentry == NULL) { // Target entry exists?
         // do nothing.
     }
     else {
         remove_entry(pentry);
 
-        insert_entry(find_insert_entry(&(list->free), pentry->address), pentry);
-
         list->free.length += pentry->length;
         list->used.length -= pentry->length;
+        list->used_count--;
 
-        arrange_regions(&(list->free));
+        pentry->is_free = true;
+        if ((pentry->lower != NULL) && pentry->lower->is_free) {
+            remove_bin(list, pentry->lower);
+            pentry = combine_region(list, pentry->lower, pentry);
+        }
+        if ((pentry->upper != NULL) && pentry->upper->is_free) {
+            remove_bin(list, pentry->upper);
+            pentry = combine_region(list, pentry, pentry->upper);
+        }
+        pentry = return_chunks(list, pentry);
+        insert_bin(list, pentry);
+        return_reclaimed_chunks(list);
     }
 
     unlock(list);
 }
 
+/**
+ * Initialize cache.
+ *
+ * @param cache A cache to initialize.
+ * @param list Shared list to assign/release blocks.
+ */
+void mem_region_cache_init(mem_region_cache_t* cache, mem_region_list_t* list)
+{
+    cache->list = list;
+    for (int32_t i = 0L; i < MEM_REGION_CACHE_CLASS_COUNT; i++) {
+        cache->blocks[i] = NULL;
+        cache->counts[i] = 0u;
+    }
+
+    return;
+}
+/**
+ * Release all cached blocks to shared list.
+ *
+ * @param cache Cache.
+ */
+void mem_region_cache_flush(mem_region_cache_t* cache)
+{
+    for (int32_t i = 0L; i < MEM_REGION_CACHE_CLASS_COUNT; i++) {
+        while (cache->blocks[i] != NULL) {
+            mem_addr_t block = cache->blocks[i];
+            cache->blocks[i] = *((mem_addr_t*)(block));
+            mem_region_list_release(cache->list, block);
+        }
+        cache->counts[i] = 0u;
+    }
+
+    return;
+}
+/**
+ * Assign block through cache.
+ *
+ * Small block is taken from cache without locking shared list.
+ *
+ * @param cache Cache.
+ * @param length Length to assign.
+ * @retval NULL
+ *           No space left on list.
+ * @retval Non-NULL
+ *           Assigned address.
+ */
+mem_addr_t mem_region_cache_assign(mem_region_cache_t* cache, mem_size_t length)
+{
+    int32_t index = get_cache_class(length);
+    if (index < 0L) { // Not cachable size?
+        return mem_region_list_assign(cache->list, length);
+    }
+
+    mem_addr_t block = cache->blocks[index];
+    if (block != NULL) {
+        cache->blocks[index] = *((mem_addr_t*)(block));
+        cache->counts[index]--;
+        return block;
+    }
+
+    return mem_region_list_assign(cache->list, MEM_REGION_CACHE_MIN_SIZE << index);
+}
+/**
+ * Release block through cache.
+ *
+ * @param cache Cache.
+ * @param address Release block address.
+ * @param length Length passed on assign.
+ */
+void mem_region_cache_release(mem_region_cache_t* cache, mem_addr_t address, mem_size_t length)
+{
+    int32_t index = get_cache_class(length);
+    if ((address == NULL) || (index < 0L) || (cache->counts[index] >= MEM_REGION_CACHE_DEPTH)) {
+        mem_region_list_release(cache->list, address);
+        return;
+    }
+
+    *((mem_addr_t*)(address)) = cache->blocks[index];
+    cache->blocks[index] = address;
+    cache->counts[index]++;
+
+    return;
+}
+
 /**
  * Get unused region_entry.
  *
@@ -221,66 +406,272 @@ void mem_region_list_release(mem_region_list_t* list, mem_addr_t address)
  */
 static struct mem_region* get_free_entry(mem_region_list_t* list)
 {
-    struct mem_region* region = list->entries;
-    for (int32_t i = 0L; i < list->entry_count; i++)
-    {
-        if (region->address == NULL)
-        {
-            return region;
+    struct mem_region* pentry = list->spare;
+    if (pentry != NULL) {
+        remove_spare_entry(list, pentry);
+        pentry->next = pentry;
+        pentry->prev = pentry;
+        if (pentry->chunk != NULL) {
+            pentry->chunk->spare_count--;
         }
-        region++;
     }
 
-    return NULL;
+    return pentry;
 }
 
 /**
- * Find insert position.
+ * Put back region entry object to unused entries.
+ *
+ * When all entries of a chunk become unused, the chunk is queued to be returned
+ * to free space. (See return_reclaimed_chunks)
  *
- * @param head A head object of region entry list
- * @param address Address
- * @retval A region entry object to insert to previous.
+ * @param list A list object which have entries.
+ * @param pentry Entry object to release.
  */
-static struct mem_region* find_insert_entry(struct mem_region* head, mem_addr_t address)
+static void put_free_entry(mem_region_list_t* list, struct mem_region* pentry)
 {
-    struct mem_region* pentry = head->next;
-    while (pentry != head) {
-        if (address < pentry->address) { // address is larger than pentry's address.
-            // Insert this position.
-            return pentry;
+    pentry->address = NULL;
+    pentry->length = 0u;
+    pentry->is_free = false;
+    push_spare_entry(list, pentry);
+
+    struct mem_region* chunk = pentry->chunk;
+    if (chunk != NULL) {
+        chunk->spare_count++;
+        if (is_unused_chunk(chunk)) {
+            remove_entry(chunk);
+            insert_entry(&(list->reclaim), chunk);
         }
-        pentry = pentry->next;
     }
-    // Insert to tail.
-    return head;
+
+    return;
 }
+/**
+ * Push entry object on unused entries.
+ *
+ * @param list A list object which have entries.
+ * @param pentry Entry object to push.
+ */
+static void push_spare_entry(mem_region_list_t* list, struct mem_region* pentry)
+{
+    pentry->prev = NULL;
+    pentry->next = list->spare;
+    if (list->spare != NULL) {
+        list->spare->prev = pentry;
+    }
+    list->spare = pentry;
 
+    return;
+}
 /**
- * Insert pentry to previous position of prev_entry.
+ * Remove entry object from unused entries.
  *
- * @param prev_entry Previous positioning entry object to insert.
- * @param pentry Entry object to insert.
+ * @param list A list object which have entries.
+ * @param pentry Entry object to remove. (Must be in unused entries)
  */
-static void insert_entry(struct mem_region* prev_entry, struct mem_region* pentry)
+static void remove_spare_entry(mem_region_list_t* list, struct mem_region* pentry)
 {
-    prev_entry->prev->next = pentry;
-    pentry->prev = prev_entry->prev;
-    pentry->next = prev_entry;
-    prev_entry->prev = pentry;
+    if (pentry->prev != NULL) {
+        pentry->prev->next = pentry->next;
+    }
+    else {
+        list->spare = pentry->next;
+    }
+    if (pentry->next != NULL) {
+        pentry->next->prev = pentry->prev;
+    }
 
     return;
 }
+
 /**
- * Release region entry object.
+ * Add MEM_REGION_GROW_COUNT entries.
  *
- * @param pentry Entry object to release.
+ * Entries are placed at the upper end of specified free region,
+ * and the first one of them describes the placed region (chunk) itself.
+ * The chunk is returned to free space when all other entries of it are unused
+ * and it is next to a free region. (See return_chunks)
+ *
+ * @param list A list object which have entries.
+ * @param blank_region_entry Free region to place entries. (Must be removed from bin)
+ * @param keep_length Length which must be left in blank_region_entry. (At least 1 byte is left)
+ * @retval true
+ *           Succeed.
+ * @retval false
+ *           Failure. Region is too short. (Nothing changed)
  */
-static void release_entry(struct mem_region* pentry)
+static bool grow_entries(mem_region_list_t* list, struct mem_region* blank_region_entry, mem_size_t keep_length)
 {
-    remove_entry(pentry);
+    mem_size_t chunk_length = (mem_size_t)(((sizeof(struct mem_region) * MEM_REGION_GROW_COUNT
+        + ALIGNMENT_SIZE - 1) / ALIGNMENT_SIZE) * ALIGNMENT_SIZE);
+    if ((blank_region_entry->length <= chunk_length)
+        || ((blank_region_entry->length - chunk_length) < keep_length)) {
+        return false;
+    }
 
-    pentry->address = NULL;
-    pentry->length = 0u;
+    blank_region_entry->length -= chunk_length;
+
+    struct mem_region* chunk = (struct mem_region*)(blank_region_entry->address + blank_region_entry->length);
+    chunk->address = (mem_addr_t)(chunk);
+    chunk->length = chunk_length;
+    chunk->next = chunk; // Linked to reclaim while queued.
+    chunk->prev = chunk;
+    chunk->is_free = false;
+    chunk->chunk = chunk;
+    chunk->spare_count = MEM_REGION_GROW_COUNT - 1u;
+    chunk->upper = blank_region_entry->upper;
+    if (chunk->upper != NULL) {
+        chunk->upper->lower = chunk;
+    }
+    chunk->lower = blank_region_entry;
+    blank_region_entry->upper = chunk;
+
+    list->free.length -= chunk_length;
+    list->used.length += chunk_length;
+
+    for (int32_t i = MEM_REGION_GROW_COUNT - 1L; i >= 1L; i--) {
+        chunk[i].address = NULL;
+        chunk[i].length = 0u;
+        chunk[i].is_free = false;
+        chunk[i].lower = NULL;
+        chunk[i].upper = NULL;
+        chunk[i].chunk = chunk;
+        push_spare_entry(list, &(chunk[i])); // Not counted again. (Already in spare_count)
+    }
+    list->entry_count += MEM_REGION_GROW_COUNT - 1L;
+
+    return true;
+}
+
+/**
+ * Check entry describes a chunk whose entries are all unused.
+ *
+ * @param pentry Entry object. (May be NULL)
+ * @retval true
+ *           Chunk can be returned to free space.
+ * @retval false
+ *           Not a chunk, or some entries of it are in use.
+ */
+static bool is_unused_chunk(const struct mem_region* pentry)
+{
+    return (pentry != NULL) && (pentry->chunk == pentry)
+        && (pentry->spare_count == (MEM_REGION_GROW_COUNT - 1u));
+}
+
+/**
+ * Remove entries of a chunk from the list.
+ *
+ * The chunk region itself is left for the caller to join to an adjacent free region.
+ *
+ * @param list A list object which have entries.
+ * @param chunk Entry describing the chunk. (All other entries of it must be unused)
+ */
+static void drop_chunk(mem_region_list_t* list, struct mem_region* chunk)
+{
+    for (int32_t i = 1L; i < MEM_REGION_GROW_COUNT; i++) {
+        remove_spare_entry(list, &(chunk[i]));
+    }
+    remove_entry(chunk); // From reclaim, if queued.
+    list->entry_count -= MEM_REGION_GROW_COUNT - 1L;
+    list->used.length -= chunk->length;
+    list->free.length += chunk->length;
+
+    return;
+}
+
+/**
+ * Return unused chunks adjacent to a free region to free space.
+ *
+ * The chunk cannot describe itself once it is free,
+ * so it is joined to the free region (and to the free region beyond it, if any).
+ *
+ * @param list Region list.
+ * @param pentry Free region entry object. (Must be removed from bin)
+ * @retval Free region entry object after joining. (Not inserted to bin)
+ */
+static struct mem_region* return_chunks(mem_region_list_t* list, struct mem_region* pentry)
+{
+    for (;;) {
+        struct mem_region* chunk = pentry->lower;
+        if (is_unused_chunk(chunk)) {
+            drop_chunk(list, chunk);
+            pentry->address = chunk->address;
+            pentry->length += chunk->length;
+            pentry->lower = chunk->lower;
+            if (pentry->lower != NULL) {
+                pentry->lower->upper = pentry;
+            }
+            if ((pentry->lower != NULL) && pentry->lower->is_free) {
+                remove_bin(list, pentry->lower);
+                pentry = combine_region(list, pentry->lower, pentry);
+            }
+            continue;
+        }
+        chunk = pentry->upper;
+        if (is_unused_chunk(chunk)) {
+            drop_chunk(list, chunk);
+            pentry->length += chunk->length;
+            pentry->upper = chunk->upper;
+            if (pentry->upper != NULL) {
+                pentry->upper->lower = pentry;
+            }
+            if ((pentry->upper != NULL) && pentry->upper->is_free) {
+                remove_bin(list, pentry->upper);
+                pentry = combine_region(list, pentry, pentry->upper);
+            }
+            continue;
+        }
+        break;
+    }
+
+    return pentry;
+}
+
+/**
+ * Return chunks which got all entries unused to free space.
+ *
+ * A chunk not next to any free region is left as it is,
+ * and it is returned later when a region next to it is released.
+ *
+ * @param list Region list.
+ */
+static void return_reclaimed_chunks(mem_region_list_t* list)
+{
+    while (list->reclaim.next != &(list->reclaim)) {
+        struct mem_region* chunk = list->reclaim.next;
+        remove_entry(chunk);
+        if (!is_unused_chunk(chunk)) {
+            continue;
+        }
+        struct mem_region* free_entry = NULL;
+        if ((chunk->lower != NULL) && chunk->lower->is_free) {
+            free_entry = chunk->lower;
+        }
+        else if ((chunk->upper != NULL) && chunk->upper->is_free) {
+            free_entry = chunk->upper;
+        }
+        if (free_entry != NULL) {
+            remove_bin(list, free_entry);
+            free_entry = return_chunks(list, free_entry);
+            insert_bin(list, free_entry);
+        }
+    }
+
+    return;
+}
+
+/**
+ * Insert pentry to previous position of prev_entry.
+ *
+ * @param prev_entry Previous positioning entry object to insert.
+ * @param pentry Entry object to insert.
+ */
+static void insert_entry(struct mem_region* prev_entry, struct mem_region* pentry)
+{
+    prev_entry->prev->next = pentry;
+    pentry->prev = prev_entry->prev;
+    pentry->next = prev_entry;
+    prev_entry->prev = pentry;
 
     return;
 }
@@ -301,81 +692,200 @@ static void remove_entry(struct mem_region* pentry)
 }
 
 /**
- * Getting entry count of list.
- * 
- * @param head Head entry of list.
- * @retval Number of entry count returned.
+ * Insert free region to the bin which matches its length.
+ *
+ * @param list Region list.
+ * @param pentry Free region entry object.
+ */
+static void insert_bin(mem_region_list_t* list, struct mem_region* pentry)
+{
+    uint32_t index = get_bin_index(pentry->length);
+    pentry->is_free = true;
+    insert_entry(list->bins[index].next, pentry);
+    list->bin_map |= (1u << index);
+
+    return;
+}
+/**
+ * Remove free region from its bin.
+ *
+ * @param list Region list.
+ * @param pentry Free region entry object.
  */
-static uint32_t get_entry_count(const struct mem_region* head) 
+static void remove_bin(mem_region_list_t* list, struct mem_region* pentry)
 {
-    uint32_t count = 0;
-    const struct mem_region* pentry = head->next;
-    while (pentry != head) {
-        count++;
-        pentry = pentry->next;
+    uint32_t index = get_bin_index(pentry->length);
+    remove_entry(pentry);
+    if (list->bins[index].next == &(list->bins[index])) { // Bin becomes empty?
+        list->bin_map &= ~(1u << index);
     }
-    return count;
+
+    return;
 }
 
 /**
  * Find blank region which has a enougth space to assign specified length.
  *
- * @param head Head entry of free list.
+ * The bin which matches length is searched first, because it may contain
+ * shorter regions. Otherwise any region in upper bins has enough space.
+ *
+ * @param list Region list.
  * @param length Length to need.
  * @retval NULL
  *           No space left on list.
  * @retval Non-NULL
  *           A entry object which has enough size.
  */
-static struct mem_region* find_blank_region(struct mem_region* head, mem_size_t length)
+static struct mem_region* find_blank_region(mem_region_list_t* list, mem_size_t length)
 {
-    struct mem_region* pentry = head->next;
-    while (pentry != head) {
-        if (pentry->length >= length) {
-            return pentry;
+    uint32_t index = get_bin_index(length);
+    if ((list->bin_map & (1u << index)) != 0u) {
+        struct mem_region* head = &(list->bins[index]);
+        struct mem_region* pentry = head->next;
+        while (pentry != head) {
+            if (pentry->length >= length) {
+                return pentry;
+            }
+            pentry = pentry->next;
         }
-        pentry = pentry->next;
     }
-    return NULL;
+
+    uint32_t upper_bins = list->bin_map & ~((2u << index) - 1u);
+    if (upper_bins == 0u) {
+        return NULL;
+    }
+    return list->bins[get_lowest_bit_index(upper_bins)].next;
 }
 /**
  * Find region which has indicate address.
  *
- * @param head Head of region entry array.
+ * The entry is read from boundary tag, and then validated.
+ *
+ * @param list Region list.
  * @param address Address.
  * @retval NULL
  *           Region entry not found.
  * @retval Non-NULL
  *           Region entry object which has specified address.
  */
-static struct mem_region* find_region(struct mem_region* head, mem_addr_t address)
+static struct mem_region* find_region(mem_region_list_t* list, mem_addr_t address)
 {
-    struct mem_region* pentry = head->next;
-    while (pentry != head) {
-        if (pentry->address == address) {
-            return pentry;
-        }
-        pentry = pentry->next;
+    mem_addr_t top = list->free.address;
+    mem_addr_t bottom = top + (list->used.length + list->free.length);
+    if ((address < (top + TAG_SIZE)) || (address >= bottom)) { // Out of range?
+        return NULL;
+    }
+
+    struct mem_region* pentry = *((struct mem_region**)(address - TAG_SIZE));
+    bool is_initial_entry = (pentry >= list->entries) && (pentry < (list->entries + list->initial_entry_count));
+    bool is_grown_entry = ((mem_addr_t)(pentry) >= top) && ((mem_addr_t)(pentry + 1) <= bottom);
+    if ((!is_initial_entry && !is_grown_entry)
+        || (pentry->address != (address - TAG_SIZE)) || pentry->is_free) {
+        return NULL;
     }
-    return NULL;
+    return pentry;
 }
 
 /**
- * Arrange region entry array. Combine continous two regions.
+ * Combine two adjacent free regions.
+ *
+ * The entry kept for the combined region is the one from the chunk with fewer unused entries
+ * (initial entries first), so that emptier chunks can become unused and be returned.
+ *
+ * @param list Region list.
+ * @param lower Region at lower address.
+ * @param upper Region at upper address.
+ * @retval Combined region entry object. (The other one is put back to unused entries)
  */
-static void arrange_regions(struct mem_region* head)
+static struct mem_region* combine_region(mem_region_list_t* list, struct mem_region* lower, struct mem_region* upper)
 {
-    struct mem_region* pentry = head->next;
-    while (pentry != head) {
-        struct mem_region* pnext_entry = pentry->next;
-        while ((pnext_entry != head) // Next entry is exists?
-            && ((pentry->address + pentry->length) == pnext_entry->address)) { // Next address is continuous?
-            pentry->length += pnext_entry->length;
-            release_entry(pnext_entry);
-            pnext_entry = pentry->next;
+    bool keep_upper = (lower->chunk != NULL)
+        && ((upper->chunk == NULL) || (upper->chunk->spare_count < lower->chunk->spare_count));
+    if (keep_upper) {
+        upper->address = lower->address;
+        upper->length += lower->length;
+        upper->lower = lower->lower;
+        if (upper->lower != NULL) {
+            upper->lower->upper = upper;
         }
-        pentry = pentry->next;
+        put_free_entry(list, lower);
+
+        return upper;
+    }
+    lower->length += upper->length;
+    lower->upper = upper->upper;
+    if (lower->upper != NULL) {
+        lower->upper->lower = lower;
+    }
+    put_free_entry(list, upper);
+
+    return lower;
+}
+
+/**
+ * Getting bin index for length.
+ *
+ * @param length Length. (Must be larger than 0)
+ * @retval Index of highest set bit returned.
+ */
+static uint32_t get_bin_index(mem_size_t length)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanReverse(&index, (unsigned long)(length));
+    return (uint32_t)(index);
+#elif defined(__GNUC__)
+    return 31u - (uint32_t)(__builtin_clz(length));
+#else
+    uint32_t index = 0u;
+    while ((length >>= 1) != 0u) {
+        index++;
+    }
+    return index;
+#endif
+}
+/**
+ * Getting index of lowest set bit.
+ *
+ * @param bits Bits. (Must not be 0)
+ * @retval Index of lowest set bit returned.
+ */
+static uint32_t get_lowest_bit_index(uint32_t bits)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, (unsigned long)(bits));
+    return (uint32_t)(index);
+#elif defined(__GNUC__)
+    return (uint32_t)(__builtin_ctz(bits));
+#else
+    uint32_t index = 0u;
+    while ((bits & 1u) == 0u) {
+        bits >>= 1;
+        index++;
+    }
+    return index;
+#endif
+}
+
+/**
+ * Getting cache class for length.
+ *
+ * @param length Length.
+ * @retval 0 or larger
+ *           Class index.
+ * @retval -1
+ *           Length is too large to cache.
+ */
+static int32_t get_cache_class(mem_size_t length)
+{
+    if (length > (MEM_REGION_CACHE_MIN_SIZE << (MEM_REGION_CACHE_CLASS_COUNT - 1))) {
+        return -1L;
     }
+    if (length <= MEM_REGION_CACHE_MIN_SIZE) {
+        return 0L;
+    }
+    return (int32_t)(get_bin_index((length - 1u) / MEM_REGION_CACHE_MIN_SIZE)) + 1L;
 }
 
 /**
@@ -385,7 +895,9 @@ static void arrange_regions(struct mem_region* head)
  */
 static void init_lock(mem_region_list_t* list)
 {
-    // Note : If lock function available, implements here.
+    if (list->shared) {
+        mem_region_lock_init(&(list->lock_object));
+    }
 }
 /**
  * Destroy lock object.
@@ -394,7 +906,9 @@ static void init_lock(mem_region_list_t* list)
  */
 static void destroy_lock(mem_region_list_t* list)
 {
-    // Note : If lock function available, implements here.
+    if (list->shared) {
+        mem_region_lock_destroy(&(list->lock_object));
+    }
 }
 /**
  * Lock list.
@@ -403,7 +917,9 @@ static void destroy_lock(mem_region_list_t* list)
  */
 static void lock(mem_region_list_t* list)
 {
-    // Note : If lock function available, implements here.
+    if (list->shared) {
+        mem_region_lock_acquire(&(list->lock_object));
+    }
 }
 /**
  * Unlock list.
@@ -412,5 +928,65 @@ static void lock(mem_region_list_t* list)
  */
 static void unlock(mem_region_list_t* list)
 {
-    // Note : If lock function available, implements here.
+    if (list->shared) {
+        mem_region_lock_release(&(list->lock_object));
+    }
+}
+
+/**
+ * Initialize lock object.
+ * (A lock object initialized with MEM_REGION_LOCK_INITIALIZER need not call this)
+ *
+ * @param lock_object Lock object.
+ */
+void mem_region_lock_init(mem_region_lock_t* lock_object)
+{
+#if MEM_REGION_LIST_USE_LOCK
+#if defined(_WIN32)
+    InitializeSRWLock((PSRWLOCK)(lock_object));
+#else
+    pthread_mutex_init(lock_object, NULL);
+#endif
+#endif
+}
+/**
+ * Destroy lock object.
+ *
+ * @param lock_object Lock object.
+ */
+void mem_region_lock_destroy(mem_region_lock_t* lock_object)
+{
+#if MEM_REGION_LIST_USE_LOCK && !defined(_WIN32)
+    pthread_mutex_destroy(lock_object); // SRWLOCK need not be destroyed.
+#endif
+}
+/**
+ * Acquire lock.
+ *
+ * @param lock_object Lock object.
+ */
+void mem_region_lock_acquire(mem_region_lock_t* lock_object)
+{
+#if MEM_REGION_LIST_USE_LOCK
+#if defined(_WIN32)
+    AcquireSRWLockExclusive((PSRWLOCK)(lock_object));
+#else
+    pthread_mutex_lock(lock_object);
+#endif
+#endif
+}
+/**
+ * Release lock.
+ *
+ * @param lock_object Lock object.
+ */
+void mem_region_lock_release(mem_region_lock_t* lock_object)
+{
+#if MEM_REGION_LIST_USE_LOCK
+#if defined(_WIN32)
+    ReleaseSRWLockExclusive((PSRWLOCK)(lock_object));
+#else
+    pthread_mutex_unlock(lock_object);
+#endif
+#endif
 }
@@ -5,17 +5,93 @@
 #include <stdbool.h>
 #include "mem_region.h"
 
+/**
+ * Number of free bins. Bin n holds free regions of length [2^n, 2^(n+1)).
+ */
+#define MEM_REGION_BIN_COUNT (32)
+
+/**
+ * Number of entries added at once when all entries are in use.
+ * Added entries are placed in the managed memory area as a chunk,
+ * which is returned to free space when all of its entries are unused again.
+ */
+#ifndef MEM_REGION_GROW_COUNT
+#define MEM_REGION_GROW_COUNT (64)
+#endif
+#if (MEM_REGION_GROW_COUNT < 2) || (MEM_REGION_GROW_COUNT > 65536)
+#error MEM_REGION_GROW_COUNT must be 2..65536. (spare_count of struct mem_region)
+#endif
+
+/**
+ * Use lock to share list between threads or not.
+ *
+ * 1: Lock list initialized as shared on assign/release. (Windows SRWLOCK or pthread mutex)
+ *    A list that is not shared is never locked.
+ * 0: No lock. (For single thread environment)
+ */
+#ifndef MEM_REGION_LIST_USE_LOCK
+#define MEM_REGION_LIST_USE_LOCK (1)
+#endif
+
+#if MEM_REGION_LIST_USE_LOCK
+#if defined(_WIN32)
+typedef void* mem_region_lock_t; // SRWLOCK. (It has only one pointer, so windows.h is not included here)
+#define MEM_REGION_LOCK_INITIALIZER NULL
+#else
+#include <pthread.h>
+typedef pthread_mutex_t mem_region_lock_t;
+#define MEM_REGION_LOCK_INITIALIZER PTHREAD_MUTEX_INITIALIZER
+#endif
+#else
+typedef int mem_region_lock_t; // Dummy.
+#define MEM_REGION_LOCK_INITIALIZER 0
+#endif
 
 struct mem_region_list {
-    struct mem_region used;
-    struct mem_region free;
-    struct mem_region *entries;
-    int32_t entry_count;
+    struct mem_region used; // Head of used regions. (length is total used size)
+    struct mem_region free; // Free region summary. (address is top of memory, length is total free size)
+    struct mem_region bins[MEM_REGION_BIN_COUNT]; // Heads of size-segregated free regions.
+    uint32_t bin_map; // Bit n is set when bins[n] has any region.
+    struct mem_region *spare; // Unused entries. (Linked by next and prev, NULL terminated)
+    struct mem_region reclaim; // Head of chunks which got all entries unused while releasing.
+    uint32_t used_count; // Number of used regions.
+    struct mem_region *entries; // Initial entries.
+    int32_t entry_count; // Number of entries. (Includes added entries)
+    int32_t initial_entry_count; // Number of initial entries.
+    bool shared; // Shared between threads. (Lock on assign/release)
+    mem_region_lock_t lock_object; // Lock object. (Used only when shared)
 };
 typedef struct mem_region_list mem_region_list_t;
 
+/**
+ * Number of size classes of cache. Class n holds blocks of (MEM_REGION_CACHE_MIN_SIZE << n) bytes.
+ */
+#define MEM_REGION_CACHE_CLASS_COUNT (8)
+/**
+ * Smallest block size of cache.
+ */
+#define MEM_REGION_CACHE_MIN_SIZE (64u)
+/**
+ * Maximum number of cached blocks per class.
+ */
+#ifndef MEM_REGION_CACHE_DEPTH
+#define MEM_REGION_CACHE_DEPTH (8)
+#endif
+
+/**
+ * Cache of small blocks in front of a shared list.
+ * A cache belongs to one user of the list (jmem_impliments.c keeps one per codec object),
+ * and the user calls it from one thread at a time, so it does not lock.
+ */
+struct mem_region_cache {
+    mem_region_list_t *list; // Shared list.
+    mem_addr_t blocks[MEM_REGION_CACHE_CLASS_COUNT]; // Cached blocks. (Linked by first pointer of block)
+    uint32_t counts[MEM_REGION_CACHE_CLASS_COUNT]; // Number of cached blocks.
+};
+typedef struct mem_region_cache mem_region_cache_t;
+
 bool mem_region_list_init(mem_region_list_t *list, mem_addr_t address, mem_size_t length,
-	struct mem_region *entries, int32_t entry_count);
+	struct mem_region *entries, int32_t entry_count, bool shared);
 void mem_region_list_destroy(mem_region_list_t *list);
 
 mem_size_t mem_region_list_get_used(const mem_region_list_t *list);
@@ -25,4 +101,14 @@ void mem_region_list_get_entry_count(const mem_region_list_t* list, uint32_t* pf
 mem_addr_t mem_region_list_assign(mem_region_list_t *list, mem_size_t length);
 void mem_region_list_release(mem_region_list_t *list, mem_addr_t address);
 
+void mem_region_cache_init(mem_region_cache_t *cache, mem_region_list_t *list);
+void mem_region_cache_flush(mem_region_cache_t *cache);
+mem_addr_t mem_region_cache_assign(mem_region_cache_t *cache, mem_size_t length);
+void mem_region_cache_release(mem_region_cache_t *cache, mem_addr_t address, mem_size_t length);
+
+void mem_region_lock_init(mem_region_lock_t *lock_object);
+void mem_region_lock_destroy(mem_region_lock_t *lock_object);
+void mem_region_lock_acquire(mem_region_lock_t *lock_object);
+void mem_region_lock_release(mem_region_lock_t *lock_object);
+
 #endif // MEM_REGION_LIST_H
@@ -0,0 +1,130 @@
+#include <stddef.h>
+#include "mem_slab.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#if defined(__linux__)
+#include <unistd.h>
+#include <sys/syscall.h>
+#endif
+#endif
+
+/**
+ * Size of explicit huge page. (Linux x86/ARM default)
+ */
+#define HUGE_PAGE_SIZE (2u * 1024u * 1024u)
+
+#if defined(_WIN32)
+static void* alloc_pages(mem_size_t length, DWORD type, int32_t numa_node);
+#else
+static void bind_node(void* address, mem_size_t length, int32_t numa_node);
+#endif
+
+/**
+ * Map a slab directly from OS pages.
+ *
+ * @param length Length of slab.
+ * @param numa_node Preferred NUMA node. (MEM_SLAB_NODE_ANY for no preference)
+ * @retval Address of slab.
+ * @retval NULL Failed.
+ */
+mem_addr_t mem_slab_map(mem_size_t length, int32_t numa_node)
+{
+#if defined(_WIN32)
+    void* address = NULL;
+    DWORD type = MEM_RESERVE | MEM_COMMIT;
+#if MEM_SLAB_USE_HUGE_PAGE
+    SIZE_T large_page_size = GetLargePageMinimum();
+    if ((large_page_size != 0) && ((length % large_page_size) == 0)) {
+        address = alloc_pages(length, type | MEM_LARGE_PAGES, numa_node); // Fails without SeLockMemoryPrivilege.
+    }
+#endif
+    if (address == NULL) {
+        address = alloc_pages(length, type, numa_node);
+    }
+    return (mem_addr_t)(address);
+#else
+    void* address = MAP_FAILED;
+#if MEM_SLAB_USE_HUGE_PAGE && defined(MAP_HUGETLB)
+    if ((length % HUGE_PAGE_SIZE) == 0) {
+        address = mmap(NULL, length, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0); // Fails when no huge pages are reserved.
+    }
+#endif
+    if (address == MAP_FAILED) {
+        address = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (address == MAP_FAILED) {
+            return NULL;
+        }
+#if MEM_SLAB_USE_HUGE_PAGE && defined(MADV_HUGEPAGE)
+        madvise(address, length, MADV_HUGEPAGE); // Advice only. Ignored when THP is disabled.
+#endif
+    }
+    bind_node(address, length, numa_node); // Pages are not touched yet, so they are placed on first touch.
+    return (mem_addr_t)(address);
+#endif
+}
+
+/**
+ * Unmap a slab mapped by mem_slab_map().
+ *
+ * @param address Address of slab.
+ * @param length Length of slab. (Same as mem_slab_map())
+ */
+void mem_slab_unmap(mem_addr_t address, mem_size_t length)
+{
+    if (address == NULL) {
+        return;
+    }
+#if defined(_WIN32)
+    (void)(length);
+    VirtualFree(address, 0, MEM_RELEASE);
+#else
+    munmap(address, length);
+#endif
+}
+
+#if defined(_WIN32)
+/**
+ * Allocate pages on NUMA node.
+ *
+ * @param length Length.
+ * @param type Allocation type.
+ * @param numa_node Preferred NUMA node.
+ * @retval Address of pages.
+ * @retval NULL Failed.
+ */
+static void* alloc_pages(mem_size_t length, DWORD type, int32_t numa_node)
+{
+    if (numa_node >= 0) {
+        return VirtualAllocExNuma(GetCurrentProcess(), NULL, length, type, PAGE_READWRITE, (DWORD)(numa_node));
+    }
+    return VirtualAlloc(NULL, length, type, PAGE_READWRITE);
+}
+#else
+/**
+ * Set preferred NUMA node of pages.
+ * Does nothing when NUMA policy is not supported.
+ *
+ * @param address Address of pages.
+ * @param length Length.
+ * @param numa_node Preferred NUMA node.
+ */
+static void bind_node(void* address, mem_size_t length, int32_t numa_node)
+{
+#if defined(__linux__) && defined(SYS_mbind)
+    if ((numa_node >= 0) && (numa_node < (int32_t)(sizeof(unsigned long) * 8))) {
+        unsigned long node_mask = 1ul << numa_node;
+        // MPOL_PREFERRED(1). Called through syscall() not to depend on libnuma.
+        syscall(SYS_mbind, address, (unsigned long)(length), 1, &node_mask,
+            (unsigned long)(sizeof(node_mask) * 8 + 1), 0u);
+    }
+#else
+    (void)(address);
+    (void)(length);
+    (void)(numa_node);
+#endif
+}
+#endif
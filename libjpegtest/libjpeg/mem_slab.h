@@ -0,0 +1,27 @@
+#ifndef MEM_SLAB_H
+#define MEM_SLAB_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "mem_region.h"
+
+/**
+ * Use huge pages for slab or not.
+ *
+ * 1: Try explicit huge pages (MAP_HUGETLB / MEM_LARGE_PAGES) first,
+ *    then fall back to normal pages with transparent huge page advice.
+ * 0: Use normal pages.
+ */
+#ifndef MEM_SLAB_USE_HUGE_PAGE
+#define MEM_SLAB_USE_HUGE_PAGE (1)
+#endif
+
+/**
+ * Node number which means "no NUMA node preference".
+ */
+#define MEM_SLAB_NODE_ANY (-1)
+
+mem_addr_t mem_slab_map(mem_size_t length, int32_t numa_node);
+void mem_slab_unmap(mem_addr_t address, mem_size_t length);
+
+#endif // MEM_SLAB_H
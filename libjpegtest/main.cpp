@@ -35,13 +35,14 @@ struct image {
 };
 
 static int create_empty_image(struct image* image);
-static int read_jpeg(const char* path, struct image* image);
-static uint8_t* read_file_all(const char* path, size_t* psize);
+static int read_jpeg(struct jpeg_decompress_struct* pcinfo, const char* path, bool calc_peak, struct image* image);
+static int check_mem_peak(struct jpeg_decompress_struct* pcinfo, const char* path, const struct image* image);
 static int write_to_jpeg(const char* path, const struct image* image);
 static int write_to_file(const char* path, const uint8_t* data, size_t length);
 
 int main(int ac, char **av)
 {
+    int status = 0;
 #if 0
     struct image image;
     image.raster = NULL;
@@ -56,14 +57,6 @@ int main(int ac, char **av)
             }
         }
     }
-#else
-    struct image image;
-    image.raster = NULL;
-
-    const char* src_path = (ac >= 2) ? av[1] : "test.jpg";
-
-    int s = read_jpeg(src_path, &image);
-#endif
     if (s == 0) {
         write_to_jpeg("output.jpg", &image);
     }
@@ -72,8 +65,42 @@ int main(int ac, char **av)
         free(image.raster);
         image.raster = NULL;
     }
+#else
+    // 展開オブジェクトは全ファイルで使い回す。
+    // (メモリ領域やテーブルを画像毎に作り直さないため)
+    struct jpeg_error_mgr jerr;
+    struct jpeg_decompress_struct cinfo;
+    cinfo.err = jpeg_std_error(&jerr);
+    jpeg_create_decompress(&cinfo);
 
-    return 0;
+    int file_count = (ac >= 2) ? (ac - 1) : 1;
+    for (int i = 0; i < file_count; i++) {
+        struct image image;
+        image.raster = NULL;
+
+        const char* src_path = (ac >= 2) ? av[i + 1] : "test.jpg";
+
+        int s = read_jpeg(&cinfo, src_path, false, &image);
+        if (s == 0) {
+            s = check_mem_peak(&cinfo, src_path, &image);
+            if (s != 0) {
+                status = 1;
+            }
+        }
+        if ((s == 0) && (i == 0)) { // 最初の画像だけ書き出す
+            write_to_jpeg("output.jpg", &image);
+        }
+
+        if (image.raster != NULL) {
+            free(image.raster);
+            image.raster = NULL;
+        }
+    }
+
+    jpeg_destroy_decompress(&cinfo);
+#endif
+
+    return status;
 }
 
 /**
@@ -101,30 +128,27 @@ static int create_empty_image(struct image* image) {
 /**
  * JPEGイメージを読み込む。
  *
+ * pcinfo は jpeg_create_decompress 済みのものを渡す。
+ * 終了時は次の画像に使える状態に戻す。
+ *
+ * @param pcinfo 展開オブジェクト
  * @param path ファイルパス
+ * @param calc_peak 展開を始める前に jpeg_calc_mem_peak で必要メモリを求めるか
  * @param image 読み込み先のimageオブジェクト
  * @retval 0 成功
  * @retval 0以外 エラー
  */
-static int read_jpeg(const char* path, struct image* image)
+static int read_jpeg(struct jpeg_decompress_struct* pcinfo, const char* path, bool calc_peak, struct image* image)
 {
-    size_t data_size;
-
-    // ファイル読み出し。
-    // pathで指定されたファイルを全部読み込む。
-    // ファイルサイズがうんGBとかだと
-    // おそらくメモリアロケーションに失敗するが、指定されない想定。
-    uint8_t* bufp = read_file_all(path, &data_size);
-    if (bufp == NULL) {
-        return errno;
-    }
-
     // 初期化
-    struct jpeg_error_mgr jerr;
-    struct jpeg_decompress_struct cinfo;
-    cinfo.err = jpeg_std_error(&jerr);
-    jpeg_create_decompress(&cinfo);
-    jpeg_mem_src(&cinfo, bufp, data_size);
+    // pathで指定されたファイルをメモリマップし、マップ領域から直接展開する。
+    // バッファへのコピーが無いので、ファイルサイズの上限も無い。
+    // マップは jpeg_finish_decompress か jpeg_abort_decompress で解除される。
+    struct jpeg_decompress_struct& cinfo = *pcinfo;
+    if (!jpeg_map_src(&cinfo, path)) {
+        fprintf(stderr, "Could not map %s.\n", path);
+        return EIO;
+    }
 
     // 読み出した画像を取得する形式の指定
     cinfo.out_color_space = JCS_RGB; // RGBに変換しつつ取得
@@ -132,10 +156,16 @@ static int read_jpeg(const char* path, struct image* image)
 
     if (jpeg_read_header(&cinfo, true) != 1) {
         fprintf(stderr, "Reading header failure.\n");
-        free(bufp);
+        jpeg_abort_decompress(&cinfo);
         return EIO;
     }
 
+    long mem_peak = 0;
+    if (calc_peak) {
+        // 展開に必要なメモリ量を求める。(モジュールの初期化だけを試しに行い、元に戻す)
+        mem_peak = jpeg_calc_mem_peak(&cinfo);
+    }
+
     jpeg_start_decompress(&cinfo);
 
     fprintf(stdout, "%s\n", path);
@@ -143,6 +173,9 @@ static int read_jpeg(const char* path, struct image* image)
     fprintf(stdout, "  height = %d\n", cinfo.image_height);
     fprintf(stdout, "  color_components = %d\n", cinfo.out_color_components);
     fprintf(stdout, "  color_space = %d\n", cinfo.out_color_space);
+    if (calc_peak) {
+        fprintf(stdout, "  mem_peak = %ld\n", mem_peak);
+    }
 
     // 読み出し用バッファを確保
     int width = cinfo.output_width;
@@ -155,7 +188,7 @@ static int read_jpeg(const char* path, struct image* image)
         char errmsg_buf[256];
         strerror_s(errmsg_buf, sizeof(errmsg_buf), errno);
         fprintf(stderr, "Could not allocate moery. (size=%d, %s)\n", raster_size, errmsg_buf);
-        free(bufp); // ファイルから読み出したバッファは解放
+        jpeg_abort_decompress(&cinfo);
         return ENOMEM;
     }
 
@@ -168,10 +201,7 @@ static int read_jpeg(const char* path, struct image* image)
         jpeg_read_scanlines(&cinfo, lines, 1);
     }
 
-    jpeg_finish_decompress(&cinfo);
-    jpeg_destroy_decompress(&cinfo);
-
-    free(bufp); // ファイルから読み出したバッファは解放
+    jpeg_finish_decompress(&cinfo); // オブジェクトは破棄せず、次の画像に使う。マップもここで解除される。
 
     image->width = width;
     image->height = height;
@@ -184,82 +214,37 @@ static int read_jpeg(const char* path, struct image* image)
 }
 
 /**
- * pathで指定されたファイルを読み出す。
+ * jpeg_calc_mem_peak の後に展開しても結果が変わらないことを確認する。
  *
+ * jpeg_calc_mem_peak は展開オブジェクトの状態を保存して初期化を試し、元に戻している。
+ * 戻し損ねた状態があると後の展開結果が変わるので、同じファイルを読み直して比べる。
+ *
+ * @param pcinfo 展開オブジェクト
  * @param path ファイルパス
- * @param psize 読み出したサイズを格納する変数
- * @retval 読み出したデータのポインタ。使用後はfree()で解放すること。
- * @retval NULL
+ * @param image jpeg_calc_mem_peak を使わずに読み込んだ画像
+ * @retval 0 一致した
+ * @retval 0以外 エラーまたは不一致
  */
-static uint8_t* read_file_all(const char* path, size_t* psize)
+static int check_mem_peak(struct jpeg_decompress_struct* pcinfo, const char* path, const struct image* image)
 {
-    errno_t err = _access_s(path, 0x04); // 読み出しアクセスの確認
-    if (err != 0) {
-        char errmsg_buf[256];
-        strerror_s(errmsg_buf, sizeof(errmsg_buf), err);
-        fprintf(stderr, "Could not access to %s. (%s)\n", path, errmsg_buf);
-        return NULL;
-    }
-
-    struct _stat file_stat;
-
-    if (_stat(path, &file_stat) != 0) {
-        char errmsg_buf[256];
-        strerror_s(errmsg_buf, sizeof(errmsg_buf), errno);
-        fprintf(stderr, "Could not get file status. (%s)\n", errmsg_buf);
-        return NULL;
-    }
-
-    if (file_stat.st_size >= (1 * 1024 * 1024)) { // 1MiB以上のファイル？
-        fprintf(stderr, "Too large file for this program. (%s)\n", path);
-        return NULL;
-    }
-
-    uint8_t* bufp = (uint8_t*)(malloc(file_stat.st_size));
-    if (bufp == NULL) {
-        char errmsg_buf[256];
-        strerror_s(errmsg_buf, sizeof(errmsg_buf), errno);
-        fprintf(stderr, "Could not allocate memory. (%s)\n", errmsg_buf);
-        return NULL;
-    }
-
-    int fd;
-    err = _sopen_s(&fd, path, _O_BINARY | _O_RDONLY, _SH_DENYRW, 0);
-    if (err != 0) {
-        char errmsg_buf[256];
-        strerror_s(errmsg_buf, sizeof(errmsg_buf), err);
-        fprintf(stderr, "Could not open %s. (%s)\n", path, errmsg_buf);
-        free(bufp);
-        return NULL;
+    struct image checked;
+    checked.raster = NULL;
+    int s = read_jpeg(pcinfo, path, true, &checked);
+    if (s != 0) {
+        return s;
     }
 
-    uint8_t* wp = bufp;
-    size_t read_size = 0u;
-    unsigned int left = (unsigned int)(file_stat.st_size);
-    while (left > 0) {
-        int s = _read(fd, wp, left);
-        if (s > 0) {
-            wp += s;
-            read_size += (size_t)(s);
-            left -= s;
-        }
-        else {
-            char errmsg_buf[256];
-            strerror_s(errmsg_buf, sizeof(errmsg_buf), errno);
-            fprintf(stderr, "Reading file error. (%s)\n", errmsg_buf);
-            free(bufp);
-            _close(fd);
-            return NULL;
-        }
+    size_t raster_size = (size_t)(image->width) * image->height * image->bytes_per_pixel;
+    if ((checked.width != image->width) || (checked.height != image->height)
+        || (checked.bytes_per_pixel != image->bytes_per_pixel)
+        || (memcmp(checked.raster, image->raster, raster_size) != 0)) {
+        fprintf(stderr, "%s: decoded image differs after jpeg_calc_mem_peak.\n", path);
+        s = EINVAL;
     }
 
-    printf("Read file done. %dbytes.\n", (int)(read_size));
-
-    (*psize) = read_size;
-
-    _close(fd);
+    free(checked.raster);
 
-    return bufp;
+    return s;
 }
 
 /**
@@ -274,22 +259,14 @@ static uint8_t* read_file_all(const char* path, size_t* psize)
  */
 static int write_to_jpeg(const char* path, const struct image* image)
 {
-    // 書き出し用バッファ確保
-    // Note : jpeg_mem_dest内で自動的にリサイズを許可するなら、
-    //        jpeg_mem_destのメモリ管理に則ったメモリ確保をする必要がある。
-    //        jpeg_mem_dest内でmalloc()/free()を使ってるなら、
-    //        イニシャルバッファにmalloc()した物を渡す
-    //        さもないと、バッファを伸張するとき、このアドレスに対してfree()が呼ばれて
-    //        予期せぬ不具合を起こす。
-    int raster_size = image->width * image->bytes_per_pixel * image->height;
-    uint8_t* wbuf = (uint8_t*)(malloc(raster_size));
-    if (wbuf == NULL) {
-        int errsv = errno;
-        char errmsg_buf[256];
-        strerror_s(errmsg_buf, sizeof(errmsg_buf), errsv);
-        fprintf(stderr, "Could not allocate memory. (%d %s)\n", raster_size, errmsg_buf);
-        return errsv;
-    }
+    // 書き出し用バッファ
+    // Note : バッファは jpeg_mem_dest に確保させる。(NULL/0を渡す)
+    //        jpeg_start_compress の時点で画像サイズと量子化テーブルから出力サイズを見積もって確保し、
+    //        足りなければ realloc() で伸張する。
+    //        ラスターサイズ分を先に確保しておく必要は無い。
+    //        確保されたバッファは malloc() 系なので、使用後は free() で解放する。
+    uint8_t* wbuf = NULL;
+    size_t wsize = 0;
 
     // 初期化
     struct jpeg_compress_struct cinfo;
@@ -297,7 +274,6 @@ static int write_to_jpeg(const char* path, const struct image* image)
 
     cinfo.err = jpeg_std_error(&jerr);
     jpeg_create_compress(&cinfo);
-    size_t wsize = raster_size;
     jpeg_mem_dest(&cinfo, &wbuf, &wsize, true);
 
     // 入力元のイメージ設定
@@ -0,0 +1,34 @@
+#ifndef LINEAR_REGION_LIST_H
+#define LINEAR_REGION_LIST_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "../libjpegtest/libjpeg/mem_region.h"
+
+struct linear_region {
+    mem_addr_t address; // Address.
+    mem_size_t length; // Length.
+    struct linear_region *prev; // Previous entry.
+    struct linear_region *next; // Next entry.
+};
+
+struct linear_region_list {
+    struct linear_region used;
+    struct linear_region free;
+    struct linear_region *entries;
+    int32_t entry_count;
+};
+typedef struct linear_region_list linear_region_list_t;
+
+bool linear_region_list_init(linear_region_list_t *list, mem_addr_t address, mem_size_t length,
+	struct linear_region *entries, int32_t entry_count);
+void linear_region_list_destroy(linear_region_list_t *list);
+
+mem_size_t linear_region_list_get_used(const linear_region_list_t *list);
+mem_size_t linear_region_list_get_free(const linear_region_list_t *list);
+void linear_region_list_get_entry_count(const linear_region_list_t* list, uint32_t* pfree, uint32_t* pused);
+
+mem_addr_t linear_region_list_assign(linear_region_list_t *list, mem_size_t length);
+void linear_region_list_release(linear_region_list_t *list, mem_addr_t address);
+
+#endif // LINEAR_REGION_LIST_H
@@ -0,0 +1,182 @@
+﻿/**
+ * mem_region_list のマイクロベンチマーク
+ *
+ *   libjpeg のメモリアロケーション(jmem_impliments.c)が使っている mem_region_list と、
+ *   サイズ別ビン/境界タグを入れる前の線形リスト(linear_region_list.c)で、
+ *   同じ乱数列の確保/解放を実行して時間を比べる。
+ *
+ *   使い方: mem_region_bench [回数] [同時に確保しておくブロック数]
+ *     既定値は 2000000 回、120 ブロック。(16MiB の領域から確保する)
+ *
+ *   使い方: mem_region_bench threads [最大スレッド数] [1 スレッドあたりの回数] [1 スレッドあたりのブロック数]
+ *     共有リストを 1..最大スレッド数 のスレッドで確保/解放する。(thread_stress.cpp)
+ *     既定値は 4 スレッド、300000 回、120 ブロック。
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+
+extern "C" {
+#include "../libjpegtest/libjpeg/mem_region_list.h"
+#include "linear_region_list.h"
+}
+#include "thread_stress.h"
+
+#define SLAB_SIZE (16u * 1024u * 1024u) // 管理する領域のサイズ
+#define LINEAR_ENTRY_COUNT (4096) // 線形リストのエントリ数 (足りなくならない数)
+#define INITIAL_ENTRY_COUNT (64) // mem_region_list の初期エントリ数 (不足分は領域内に追加される)
+
+struct operation {
+    uint32_t slot; // 対象スロット
+    uint32_t length; // 確保サイズ
+};
+
+static std::vector<operation> make_operations(uint32_t count, uint32_t slot_count);
+static uint32_t next_random(uint32_t* state);
+template <typename Assign, typename Release>
+static double run(const std::vector<operation>& operations, uint32_t slot_count,
+    Assign assign, Release release, uint32_t* failures);
+
+int main(int ac, char** av)
+{
+    if ((ac >= 2) && (strcmp(av[1], "threads") == 0)) {
+        uint32_t max_thread_count = (ac >= 3) ? (uint32_t)(strtoul(av[2], NULL, 0)) : 4u;
+        uint32_t count = (ac >= 4) ? (uint32_t)(strtoul(av[3], NULL, 0)) : 300000u;
+        uint32_t slot_count = (ac >= 5) ? (uint32_t)(strtoul(av[4], NULL, 0)) : 120u;
+        if ((max_thread_count == 0u) || (count == 0u) || (slot_count == 0u)) {
+            fprintf(stderr, "usage: %s threads [max-threads] [count] [live-blocks]\n", av[0]);
+            return 1;
+        }
+        return run_thread_stress(max_thread_count, count, slot_count);
+    }
+
+    uint32_t count = (ac >= 2) ? (uint32_t)(strtoul(av[1], NULL, 0)) : 2000000u;
+    uint32_t slot_count = (ac >= 3) ? (uint32_t)(strtoul(av[2], NULL, 0)) : 120u;
+    if ((count == 0u) || (slot_count == 0u)) {
+        fprintf(stderr, "usage: %s [count] [live-blocks]\n       %s threads [max-threads] [count] [live-blocks]\n", av[0], av[0]);
+        return 1;
+    }
+
+    std::vector<operation> operations = make_operations(count, slot_count);
+    uint8_t* slab = (uint8_t*)(malloc(SLAB_SIZE));
+    if (slab == NULL) {
+        fprintf(stderr, "Could not allocate slab.\n");
+        return 1;
+    }
+
+    printf("%u assign/release pairs, %u live blocks, %u bytes slab\n",
+        count, slot_count, SLAB_SIZE);
+
+    // 線形リスト (変更前)
+    {
+        static struct linear_region entries[LINEAR_ENTRY_COUNT];
+        linear_region_list_t list;
+        linear_region_list_init(&list, slab, SLAB_SIZE, entries, LINEAR_ENTRY_COUNT);
+        uint32_t failures = 0u;
+        double sec = run(operations, slot_count,
+            [&](mem_size_t length) { return linear_region_list_assign(&list, length); },
+            [&](mem_addr_t address) { linear_region_list_release(&list, address); },
+            &failures);
+        printf("  linear list      : %8.3f s (%6.1f ns/pair) failures=%u\n",
+            sec, sec * 1e9 / count, failures);
+        linear_region_list_destroy(&list);
+    }
+
+    // サイズ別ビン + 境界タグ (現在)
+    {
+        static struct mem_region entries[INITIAL_ENTRY_COUNT];
+        mem_region_list_t list;
+        mem_region_list_init(&list, slab, SLAB_SIZE, entries, INITIAL_ENTRY_COUNT, false);
+        uint32_t failures = 0u;
+        double sec = run(operations, slot_count,
+            [&](mem_size_t length) { return mem_region_list_assign(&list, length); },
+            [&](mem_addr_t address) { mem_region_list_release(&list, address); },
+            &failures);
+        printf("  mem_region_list  : %8.3f s (%6.1f ns/pair) failures=%u\n",
+            sec, sec * 1e9 / count, failures);
+        mem_region_list_destroy(&list);
+    }
+
+    free(slab);
+
+    return 0;
+}
+
+/**
+ * 確保/解放の列を作る。
+ * 各回で乱数で選んだスロットを解放して確保し直す。(最初の 1 回は確保のみ)
+ * サイズは libjpeg の小さな確保に合わせて大半を 4KiB 以下にし、たまに 64KiB までにする。
+ *
+ * @param count 回数
+ * @param slot_count スロット数
+ * @retval 操作の列
+ */
+static std::vector<operation> make_operations(uint32_t count, uint32_t slot_count)
+{
+    std::vector<operation> operations(count);
+    uint32_t state = 12345u;
+    for (uint32_t i = 0u; i < count; i++) {
+        operations[i].slot = next_random(&state) % slot_count;
+        uint32_t r = next_random(&state);
+        operations[i].length = ((r & 15u) == 0u) ? (1u + (r >> 8) % 65536u) : (1u + (r >> 8) % 4096u);
+    }
+    return operations;
+}
+
+/**
+ * 乱数を得る。(xorshift32, 実装間で同じ列にするため)
+ *
+ * @param state 乱数の状態
+ * @retval 乱数
+ */
+static uint32_t next_random(uint32_t* state)
+{
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+/**
+ * 操作の列を実行して経過時間を測る。
+ *
+ * @param operations 操作の列
+ * @param slot_count スロット数
+ * @param assign 確保関数
+ * @param release 解放関数
+ * @param failures 確保に失敗した回数を格納する変数
+ * @retval 経過時間[秒]
+ */
+template <typename Assign, typename Release>
+static double run(const std::vector<operation>& operations, uint32_t slot_count,
+    Assign assign, Release release, uint32_t* failures)
+{
+    std::vector<mem_addr_t> slots(slot_count, (mem_addr_t)(NULL));
+    uint32_t failure_count = 0u;
+
+    auto begin = std::chrono::steady_clock::now();
+    for (const operation& op : operations) {
+        if (slots[op.slot] != NULL) {
+            release(slots[op.slot]);
+        }
+        slots[op.slot] = assign(op.length);
+        if (slots[op.slot] == NULL) {
+            failure_count++;
+        }
+    }
+    for (mem_addr_t address : slots) {
+        if (address != NULL) {
+            release(address);
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    *failures = failure_count;
+    return std::chrono::duration<double>(end - begin).count();
+}
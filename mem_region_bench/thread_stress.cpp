@@ -0,0 +1,215 @@
+﻿/**
+ * mem_region_list の複数スレッド確保/解放ストレステスト
+ *
+ *   jmem_impliments.c の SHARE_MEMORY (JMEM_SHARE_MEMORY) を有効にしたときと同じく、
+ *   1 つの mem_region_list を全スレッドで共有して確保/解放を繰り返す。
+ *   スレッド数を 1..N で変えて、ロックだけの場合とスレッド毎の mem_region_cache を
+ *   通した場合の処理量を出す。
+ *   確保したブロックにはスレッドとスロットで決まる値を書き込み、解放前に確認する。
+ *   (他スレッドと重なって確保されていれば値が壊れる)
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+extern "C" {
+#include "../libjpegtest/libjpeg/mem_region_list.h"
+}
+#include "thread_stress.h"
+
+#define STRESS_SLAB_SIZE (64u * 1024u * 1024u) // 共有する領域のサイズ
+#define STRESS_ENTRY_COUNT (64) // mem_region_list の初期エントリ数
+
+struct stress_result {
+    uint32_t failures; // 確保に失敗した回数
+    uint32_t corruptions; // 内容が壊れていた回数
+};
+
+static void stress_thread(mem_region_list_t* list, bool use_cache, uint32_t thread_index,
+    uint32_t count, uint32_t slot_count, stress_result* result);
+static void fill_block(uint8_t* block, uint32_t length, uint8_t value);
+static bool check_block(const uint8_t* block, uint32_t length, uint8_t value);
+static uint32_t next_stress_random(uint32_t* state);
+
+/**
+ * スレッド数を 1..max_thread_count に変えてストレステストを実行する。
+ *
+ * @param max_thread_count 最大スレッド数
+ * @param count 1 スレッドあたりの確保/解放の回数
+ * @param slot_count 1 スレッドあたりの同時に確保しておくブロック数
+ * @retval 0 成功
+ * @retval 1 失敗 (確保失敗または内容の破壊があった)
+ */
+int run_thread_stress(uint32_t max_thread_count, uint32_t count, uint32_t slot_count)
+{
+    uint8_t* slab = (uint8_t*)(malloc(STRESS_SLAB_SIZE));
+    if (slab == NULL) {
+        fprintf(stderr, "Could not allocate slab.\n");
+        return 1;
+    }
+
+    printf("%u assign/release pairs per thread, %u live blocks per thread, %u bytes shared slab\n",
+        count, slot_count, STRESS_SLAB_SIZE);
+
+    int status = 0;
+    for (uint32_t thread_count = 1u; thread_count <= max_thread_count; thread_count++) {
+        for (int mode = 0; mode < 2; mode++) {
+            bool use_cache = (mode != 0);
+            static struct mem_region entries[STRESS_ENTRY_COUNT];
+            mem_region_list_t list;
+            mem_region_list_init(&list, slab, STRESS_SLAB_SIZE, entries, STRESS_ENTRY_COUNT, true);
+
+            std::vector<stress_result> results(thread_count);
+            std::vector<std::thread> threads;
+            auto begin = std::chrono::steady_clock::now();
+            for (uint32_t i = 0u; i < thread_count; i++) {
+                threads.emplace_back(stress_thread, &list, use_cache, i, count, slot_count, &results[i]);
+            }
+            for (std::thread& t : threads) {
+                t.join();
+            }
+            auto end = std::chrono::steady_clock::now();
+            double sec = std::chrono::duration<double>(end - begin).count();
+
+            uint32_t failures = 0u;
+            uint32_t corruptions = 0u;
+            for (const stress_result& r : results) {
+                failures += r.failures;
+                corruptions += r.corruptions;
+            }
+            uint32_t leaked = 0u; // 解放されずに残ったブロック数 (領域内に追加したエントリは数えない)
+            mem_region_list_get_entry_count(&list, NULL, &leaked);
+            double total = (double)(count) * thread_count;
+            printf("  %2u thread(s) %-12s: %8.3f s (%7.2f Mpairs/s, %6.1f ns/pair/thread) failures=%u corruptions=%u leaked=%u blocks\n",
+                thread_count, use_cache ? "with cache" : "lock only", sec,
+                total / sec / 1e6, sec * 1e9 / count, failures, corruptions, leaked);
+            if ((failures != 0u) || (corruptions != 0u) || (leaked != 0u)) {
+                status = 1;
+            }
+            mem_region_list_destroy(&list);
+        }
+    }
+
+    free(slab);
+
+    return status;
+}
+
+/**
+ * 1 スレッド分の確保/解放を行う。
+ * 乱数で選んだスロットの内容を確認して解放し、確保し直して書き込む。
+ * サイズは main.cpp の列と同じく大半を 4KiB 以下にし、たまに 64KiB までにする。
+ *
+ * @param list 共有するリスト
+ * @param use_cache スレッド毎のキャッシュを通すか
+ * @param thread_index スレッド番号 (乱数の種と書き込む値に使う)
+ * @param count 回数
+ * @param slot_count スロット数
+ * @param result 結果を格納する変数
+ */
+static void stress_thread(mem_region_list_t* list, bool use_cache, uint32_t thread_index,
+    uint32_t count, uint32_t slot_count, stress_result* result)
+{
+    std::vector<uint8_t*> blocks(slot_count, (uint8_t*)(NULL));
+    std::vector<uint32_t> lengths(slot_count, 0u);
+    mem_region_cache_t cache;
+    mem_region_cache_init(&cache, list);
+    uint32_t state = 12345u + thread_index * 7919u;
+    uint32_t failures = 0u;
+    uint32_t corruptions = 0u;
+
+    auto release = [&](uint32_t slot) {
+        uint8_t value = (uint8_t)(thread_index * 31u + slot);
+        if (!check_block(blocks[slot], lengths[slot], value)) {
+            corruptions++;
+        }
+        if (use_cache) {
+            mem_region_cache_release(&cache, blocks[slot], lengths[slot]);
+        } else {
+            mem_region_list_release(list, blocks[slot]);
+        }
+        blocks[slot] = NULL;
+    };
+
+    for (uint32_t i = 0u; i < count; i++) {
+        uint32_t slot = next_stress_random(&state) % slot_count;
+        uint32_t r = next_stress_random(&state);
+        uint32_t length = ((r & 15u) == 0u) ? (1u + (r >> 8) % 65536u) : (1u + (r >> 8) % 4096u);
+        if (blocks[slot] != NULL) {
+            release(slot);
+        }
+        blocks[slot] = (uint8_t*)(use_cache ? mem_region_cache_assign(&cache, length) : mem_region_list_assign(list, length));
+        if (blocks[slot] == NULL) {
+            failures++;
+            continue;
+        }
+        lengths[slot] = length;
+        fill_block(blocks[slot], length, (uint8_t)(thread_index * 31u + slot));
+    }
+    for (uint32_t slot = 0u; slot < slot_count; slot++) {
+        if (blocks[slot] != NULL) {
+            release(slot);
+        }
+    }
+    mem_region_cache_flush(&cache);
+
+    result->failures = failures;
+    result->corruptions = corruptions;
+    return;
+}
+
+/**
+ * ブロックに値を書き込む。
+ * 全体を書くと memset の時間が支配的になるので、先頭と末尾と 256 バイト毎に書く。
+ *
+ * @param block ブロック
+ * @param length ブロックのサイズ
+ * @param value 書き込む値
+ */
+static void fill_block(uint8_t* block, uint32_t length, uint8_t value)
+{
+    for (uint32_t i = 0u; i < length; i += 256u) {
+        block[i] = value;
+    }
+    block[length - 1u] = value;
+}
+
+/**
+ * ブロックの値を確認する。(fill_block で書いた位置のみ)
+ *
+ * @param block ブロック
+ * @param length ブロックのサイズ
+ * @param value 書き込んだ値
+ * @retval true 壊れていない
+ * @retval false 壊れている
+ */
+static bool check_block(const uint8_t* block, uint32_t length, uint8_t value)
+{
+    for (uint32_t i = 0u; i < length; i += 256u) {
+        if (block[i] != value) {
+            return false;
+        }
+    }
+    return (block[length - 1u] == value);
+}
+
+/**
+ * 乱数を得る。(xorshift32)
+ *
+ * @param state 乱数の状態
+ * @retval 乱数
+ */
+static uint32_t next_stress_random(uint32_t* state)
+{
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
@@ -0,0 +1,8 @@
+#ifndef THREAD_STRESS_H
+#define THREAD_STRESS_H
+
+#include <stdint.h>
+
+int run_thread_stress(uint32_t max_thread_count, uint32_t count, uint32_t slot_count);
+
+#endif /* THREAD_STRESS_H */